@@ -14,6 +14,22 @@
 #include "stb_image/stb_image.h"
 #include "tiny_obj_loader/tiny_obj_loader.h"
 
+#include "benchmark.hpp"
+#include "deletion_queue.hpp"
+#include "draw_sorter.hpp"
+#include "fragment_counter.hpp"
+#include "frame_pacer.hpp"
+#include "frame_statistics.hpp"
+#include "frustum_culler.hpp"
+#include "gpu_timer.hpp"
+#include "image_layout_tracker.hpp"
+#include "memory_budget.hpp"
+#include "resolution_controller.hpp"
+#include "scene.hpp"
+#include "settings.hpp"
+#include "thread_pool.hpp"
+#include "transform_hierarchy.hpp"
+
 #include <iostream>
 #include <exception>
 #include <stdexcept>
@@ -25,10 +41,17 @@
 #include <array>
 #include <chrono>
 #include <unordered_map>
+#include <memory>
+#include <thread>
+#include <cstdio>
+#include <random>
+#include <map>
 
 class Application
 {
 public:
+    explicit Application(const Settings &settings);
+
     void Run();
 
 private:
@@ -50,50 +73,82 @@ private:
         std::vector<vk::PresentModeKHR> presentModes;
     };
 
+    // GPU layout of the position stream, packed to 12 bytes per vertex. Depth-only passes bind nothing else
+    struct VertexPosition
+    {
+        float x;
+        float y;
+        float z;
+    };
+
+    // GPU layout of the second stream: everything else about a vertex, only read when shading
+    struct VertexAttributes
+    {
+        float color[3];
+        float textureCoordinates[2];
+        float normal[3];
+    };
+
+    // A vertex as loaded. The vertex buffer holds its position and the rest of it as two separate streams
     struct Vertex
     {
         glm::vec3 position;
         glm::vec3 color;
         glm::vec2 textureCoordinates;
+        glm::vec3 normal;
 
-        static vk::VertexInputBindingDescription getBindingDescription()
+        static std::array<vk::VertexInputBindingDescription, 2> getBindingDescriptions()
         {
-            vk::VertexInputBindingDescription bindingDescription = vk::VertexInputBindingDescription()
-                                                                       .setBinding(0)
-                                                                       .setStride(sizeof(Vertex))
-                                                                       .setInputRate(vk::VertexInputRate::eVertex);
+            std::array<vk::VertexInputBindingDescription, 2> bindingDescriptions{};
 
-            return bindingDescription;
+            bindingDescriptions[0]
+                .setBinding(0)
+                .setStride(sizeof(VertexPosition))
+                .setInputRate(vk::VertexInputRate::eVertex);
+
+            bindingDescriptions[1]
+                .setBinding(1)
+                .setStride(sizeof(VertexAttributes))
+                .setInputRate(vk::VertexInputRate::eVertex);
+
+            return bindingDescriptions;
         }
 
-        static std::array<vk::VertexInputAttributeDescription, 3> getAttributeDescriptions()
+        static std::array<vk::VertexInputAttributeDescription, 4> getAttributeDescriptions()
         {
-            std::array<vk::VertexInputAttributeDescription, 3> attributeDescriptions{};
+            std::array<vk::VertexInputAttributeDescription, 4> attributeDescriptions{};
 
             attributeDescriptions[0]
                 .setBinding(0)
                 .setLocation(0)
                 .setFormat(vk::Format::eR32G32B32Sfloat)
-                .setOffset(offsetof(Vertex, position));
+                .setOffset(0);
 
             attributeDescriptions[1]
-                .setBinding(0)
+                .setBinding(1)
                 .setLocation(1)
                 .setFormat(vk::Format::eR32G32B32Sfloat)
-                .setOffset(offsetof(Vertex, color));
+                .setOffset(offsetof(VertexAttributes, color));
 
             attributeDescriptions[2]
-            .setBinding(0)
-            .setLocation(2)
-            .setFormat(vk::Format::eR32G32Sfloat)
-            .setOffset(offsetof(Vertex, textureCoordinates));
+                .setBinding(1)
+                .setLocation(2)
+                .setFormat(vk::Format::eR32G32Sfloat)
+                .setOffset(offsetof(VertexAttributes, textureCoordinates));
+
+            attributeDescriptions[3]
+                .setBinding(1)
+                .setLocation(3)
+                .setFormat(vk::Format::eR32G32B32Sfloat)
+                .setOffset(offsetof(VertexAttributes, normal));
 
             return attributeDescriptions;
         }
 
         bool operator==(const Vertex& other) const
         {
-            return position == other.position && color == other.color && textureCoordinates == other.textureCoordinates;
+            return position == other.position && color == other.color && textureCoordinates == other.textureCoordinates &&
+                   normal == other.normal;
         }
 
         friend struct std::hash<Vertex>;
@@ -101,17 +156,155 @@ private:
 
     struct VertexHasher {
         size_t operator()(Vertex const& vertex) const {
-            return ((std::hash<glm::vec3>()(vertex.position) ^
-                     (std::hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-                   (std::hash<glm::vec2>()(vertex.textureCoordinates) << 1);
+            return ((((std::hash<glm::vec3>()(vertex.position) ^
+                       (std::hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
+                     (std::hash<glm::vec2>()(vertex.textureCoordinates) << 1)) >> 1) ^
+                   (std::hash<glm::vec3>()(vertex.normal) << 1);
         }
     };
 
+    // A mesh's range in the shared vertex and index buffers and its model-space bounding sphere (center in xyz,
+    // radius in w). Also the layout of the mesh table read by the culling and draw command compute shaders
+    struct DrawCommand
+    {
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t textureIndex;
+        glm::vec4 boundingSphere;
+    };
+
+    // One drawable object for the GPU-driven path: which mesh to draw with which instance transform
+    struct ObjectData
+    {
+        uint32_t meshIndex;
+        uint32_t transformIndex;
+    };
+
+    // One entry of an indirect buffer: the command followed by the draw's material. Also the layout the draw command
+    // and culling shaders write and the bindless vertex shader reads
+    struct IndirectDraw
+    {
+        vk::DrawIndexedIndirectCommand command;
+        uint32_t materialIndex;
+    };
+
+    // A run of consecutive visible instances of one mesh, drawn with a single instanced draw, and the key it was
+    // sorted by
+    struct VisibleDraw
+    {
+        uint32_t meshIndex;
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+        uint64_t sortKey;
+
+        bool operator==(const VisibleDraw &other) const = default;
+    };
+
+    // Push constants of the occlusion culling shader
+    struct OcclusionCullParameters
+    {
+        uint32_t objectCount;
+        uint32_t latePhase;
+        uint32_t occlusionTest;
+    };
+
+    // Head of a frame slot's occlusion buffer, copied back for statistics
+    struct OcclusionCounters
+    {
+        uint32_t retestCount;
+        uint32_t lateVisibleCount;
+    };
+
+    // Dynamic rendering in one pass, or split around the depth pyramid build for occlusion culling
+    enum class RenderingPass
+    {
+        Single,
+        Early,
+        Late
+    };
+
+    // A sampled texture. Under memory pressure its largest mips are dropped, so width, height and mipLevels describe
+    // what is currently resident
+    struct Texture
+    {
+        vk::Image image;
+        vk::DeviceMemory memory;
+        vk::ImageView view;
+
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipLevels;
+        uint32_t droppedMipLevels;
+
+        // Last frame a frustum-visible object was drawn with it
+        uint64_t lastUsedFrame;
+        // Has texels below the alpha cutoff, so its draws need the alpha test
+        bool alphaTested;
+    };
+
+    // Command pools owned by a single frame in flight. They are reset wholesale once the frame's submission has completed,
+    // which releases every command buffer allocated from them in one call
+    struct FrameCommandPools
+    {
+        vk::CommandPool primaryPool;
+        std::vector<vk::CommandPool> threadPools;
+        std::vector<vk::CommandBuffer> secondaryCommandBuffers;
+        // Each recording thread's share of the depth pre-pass, executed before any of the shading buffers
+        std::vector<vk::CommandBuffer> depthPrepassCommandBuffers;
+    };
+
+    // A replaced swapchain and its present semaphores. Unlike the rest of its resources, which go through the deletion
+    // queue, these are also in use by the present engine, so they stay alive until the new swapchain has presented
+    // enough frames for the old presents to have been consumed
+    struct RetiredSwapChain
+    {
+        vk::SwapchainKHR swapChain;
+        std::vector<vk::Semaphore> presentSemaphores;
+
+        uint64_t timelineValue;
+        uint32_t remainingPresents;
+    };
+
+    // Views a multiview pass renders at most, well within the maxMultiviewViewCount of 6 every device supports
+    static constexpr uint32_t MAX_VIEWS = 4;
+
+    // std140 layout of set 0, binding 0. The lighting fields are read by the fragment shaders and the light binning
+    // pass: the light count, the size of the rendered area and the near and far planes the clusters are sliced between.
+    // view and projection are the central camera's; the vertex shaders index viewProjections by gl_ViewIndex
     struct UniformBufferObject 
     {
-        alignas(16) glm::mat4 model;
         alignas(16) glm::mat4 view;
         alignas(16) glm::mat4 projection;
+        uint32_t lightCount;
+        alignas(8) glm::vec2 viewportSize;
+        alignas(8) glm::vec2 depthRange;
+        alignas(16) glm::mat4 viewProjections[MAX_VIEWS];
+    };
+
+    // Specialization constants of the scene shaders, by constant_id
+    struct PermutationConstants
+    {
+        VkBool32 vertexColors;
+        VkBool32 alphaTest;
+        uint32_t lightingMode;
+    };
+
+    // GPU layout of a world-space point light, read by the light binning and fragment shaders
+    struct PointLight
+    {
+        float position[3];
+        float radius;
+        float color[3];
+        float intensity;
+    };
+
+    // Push constants of every draw: the draw's first transform in the instance buffer and its material. Only this
+    // changes between draws, so the per-frame descriptor sets are bound once per command buffer
+    struct DrawParameters
+    {
+        uint32_t transformBase;
+        uint32_t materialIndex;
     };
 
     void init();
@@ -149,57 +342,146 @@ private:
     void createSurface();
 
     bool checkDeviceExtensionSupport(vk::PhysicalDevice device);
+    bool isDeviceExtensionAvailable(vk::PhysicalDevice device, const char *extensionName);
     SwapChainSupportDetails querySwapChainSupport(vk::PhysicalDevice device);
     vk::SurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR> &availableFormats);
     vk::PresentModeKHR chooseSwapPresentMode(const std::vector<vk::PresentModeKHR> &availablePresentModes);
     vk::Extent2D chooseSwapExtent(const vk::SurfaceCapabilitiesKHR &capabilities);
-    void createSwapChain();
+    void createSwapChain(vk::SwapchainKHR oldSwapChain = VK_NULL_HANDLE);
 
     void createImageViews();
 
     void createGraphicsPipeline();
+    vk::Pipeline buildScenePipeline(uint32_t permutation, bool depthOnly);
+    void prepareGraphicsPipelines();
+    void retireGraphicsPipelines();
+    uint32_t getFramePermutation() const;
+    uint32_t getDrawPermutation(uint32_t meshIndex) const;
+    uint32_t getScenePermutation() const;
     static std::vector<char> readFile(const std::string &fileName);
     vk::ShaderModule createShaderModule(const std::vector<char> &code);
 
     void createRenderPass();
     void createFramebuffers();
     void createCommandPool();
+    void createFrameCommandPools();
+    void resetFrameCommandPools(uint32_t frameIndex);
     void createCommandBuffers();
     void recordCommandBuffer(vk::CommandBuffer commandBuffer, uint32_t imageIndex);
+    void recordSecondaryCommandBuffers(vk::CommandBuffer primaryCommandBuffer, uint32_t imageIndex);
+    void beginDynamicRendering(vk::CommandBuffer commandBuffer, uint32_t imageIndex, vk::RenderingFlags flags,
+                               RenderingPass pass = RenderingPass::Single);
+    void endDynamicRendering(vk::CommandBuffer commandBuffer, uint32_t imageIndex);
+    void recordUpscale(vk::CommandBuffer commandBuffer, uint32_t imageIndex);
+    void recordSceneDraws(vk::CommandBuffer commandBuffer);
+    void recordDraws(vk::CommandBuffer commandBuffer, size_t firstDraw, size_t drawCount, bool depthOnly = false);
+
+    void createCachedCommandBuffers();
+    void invalidateCommandBuffers();
+    vk::CommandBuffer getFrameCommandBuffer(uint32_t imageIndex);
 
     void drawFrame();
+    void paceFrame();
 
     void createSyncObjects();
+    void createPresentSemaphores();
+
+    void createTimelineSemaphore();
+    uint64_t signalNextTimelineValue();
+    uint64_t getCompletedTimelineValue();
+    bool isTimelineValueComplete(uint64_t value);
+    void waitForTimelineValue(uint64_t value);
 
     void recreateSwapChain();
+    void retireSwapChain();
+    void destroyRetiredSwapChains(bool waitForCompletion);
     void cleanupSwapChain();
 
     static void framebufferResizeCallback(GLFWwindow *window, int width, int height);
+    static void keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods);
+    static void mouseButtonCallback(GLFWwindow *window, int button, int action, int mods);
+    static void cursorPositionCallback(GLFWwindow *window, double x, double y);
 
+    vk::DeviceSize getVertexAttributesOffset() const;
+    vk::DeviceSize getVertexBufferSize() const;
+    void writeVertexStreams(void *data) const;
     void createVertexBuffer();
     void createIndexBuffer();
     uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties);
+    bool hasMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties);
 
-    void createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Buffer &buffer, vk::DeviceMemory &bufferMemory);
-    void copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size);
+    void createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category, vk::Buffer &buffer, vk::DeviceMemory &bufferMemory);
+    vk::DeviceMemory allocateDeviceMemory(const vk::MemoryRequirements &memoryRequirements, vk::MemoryPropertyFlags properties, MemoryCategory category);
+    void freeDeviceMemory(vk::DeviceMemory memory);
+    void deferFreeDeviceMemory(uint64_t timelineValue, vk::DeviceMemory memory);
+    uint64_t copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size);
 
     void createDescriptorSetLayout();
     void createDescriptorPool();
     void createDescriptorSets();
+    void updateDescriptorSet(uint32_t frameIndex);
+    void updateBindlessTextures(uint32_t frameIndex);
+
+    void enforceMemoryBudget();
+    Texture *findEvictableTexture();
+    bool dropTextureMipLevel(Texture &texture);
+    void demoteGeometryToHostMemory();
 
     void createUniformBuffers();
     void updateUniformBuffer(uint32_t currentImages);
 
-    void createTextureImage(const char* texturePath);
+    void createDrawCommandPipeline();
+    void createMeshBuffer();
+    void createDrawCommandBuffers();
+    void ensureDrawCommandBufferCapacity(uint32_t frameIndex);
+    void recordDrawCommandGeneration(vk::CommandBuffer commandBuffer);
+
+    void createLightBinningPipeline();
+    void createLightBuffers();
+    void setLightCount(uint32_t count);
+    void recordLightBinning(vk::CommandBuffer commandBuffer);
+
+    void createFrameQueries();
+    void collectFrameQueries(uint32_t frameIndex);
+    void updateRenderScale(double gpuMilliseconds);
+    void updateRenderExtent();
+    vk::Extent2D getViewExtent() const;
+    uint32_t getViewMask() const;
+    void setSampleCount(vk::SampleCountFlagBits sampleCount);
+
+    void createOcclusionCullingPipelines();
+    void createDepthPyramid();
+    void retireDepthPyramid();
+    void createOcclusionBuffers();
+    void recordOcclusionCulledFrame(vk::CommandBuffer commandBuffer, uint32_t imageIndex);
+    void recordOcclusionCullPhase(vk::CommandBuffer commandBuffer, bool latePhase);
+    void recordDepthPyramid(vk::CommandBuffer commandBuffer);
+    void collectOcclusionStatistics(uint32_t frameIndex);
+    std::string buildOcclusionReport();
+
+    void createInstanceBuffers();
+    void ensureInstanceBufferCapacity(uint32_t frameIndex);
+    void updateInstanceBuffer(uint32_t frameIndex);
+    void setInstanceCount(uint32_t count);
+    void cullObjects(uint32_t frameIndex);
+    void applyBenchmarkStep();
+    void sortDraws(std::vector<VisibleDraw> &draws);
+    float getSceneExtent() const;
+    void buildInstanceHierarchy();
+    void buildInstanceGrid(uint32_t root);
+    void setInstanceRotations(float time);
+
+    void loadScene();
+    void createTextureImage(const SceneAssets::Image &image);
     void createTextureImageView();
-    void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, vk::SampleCountFlagBits numSamples, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, vk::Image &image, vk::DeviceMemory &imageMemory);
+    void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, vk::SampleCountFlagBits numSamples, vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage, vk::MemoryPropertyFlags properties, MemoryCategory category, vk::Image &image, vk::DeviceMemory &imageMemory, uint32_t arrayLayers = 1);
     vk::CommandBuffer beginSingleTimeCommands();
-    void endSingleTimeCommands(vk::CommandBuffer commandBuffer);
+    uint64_t endSingleTimeCommands(vk::CommandBuffer commandBuffer);
 
-    void transitionImageLayout(vk::Image image, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t mipLevels);
-    void copyBufferToImage(vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height);
+    void transitionImageLayout(vk::CommandBuffer commandBuffer, vk::Image image, vk::ImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount);
+    void copyBufferToImage(vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height);
 
-    vk::ImageView createImageView(vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels);
+    vk::ImageView createImageView(vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels, uint32_t layerCount = 1);
     void createTextureSampler();
 
     void createDepthResources();
@@ -207,16 +489,22 @@ private:
     vk::Format findDepthFormat();
     bool hasStencilComponent(vk::Format format);
 
-    void loadModel(const char* modelPath);
+    void loadModel(const SceneAssets::Model &model, uint32_t textureIndex);
 
-    void generateMipmaps(vk::Image image, vk::Format imageFormat, int32_t textureWidth, int32_t textureHeight, uint32_t mipLevels);
+    void generateMipmaps(vk::CommandBuffer commandBuffer, vk::Image image, vk::Format imageFormat, int32_t textureWidth, int32_t textureHeight, uint32_t mipLevels);
 
     vk::SampleCountFlagBits getMaxUsableSampleCount();
     void createColorResources();
+    void createSceneImage();
+    void retireAttachments();
+    std::string buildTransientAttachmentReport();
 
-    const int MAX_FRAMES_IN_FLIGHT = 2;
+    uint32_t maxFramesInFlight = 2;
     GLFWwindow *window = nullptr;
 
+    Settings settings;
+    std::unique_ptr<ThreadPool> threadPool;
+
     vk::Instance instance;
     vk::InstanceCreateFlags flags;
     vk::ApplicationInfo appInfo{};
@@ -246,6 +534,11 @@ private:
     std::vector<vk::PhysicalDevice> physicalDevices;
     vk::PhysicalDeviceProperties physicalDeviceProperties;
     vk::PhysicalDeviceFeatures physicalDeviceFeatures{};
+    vk::PhysicalDeviceVulkan11Features physicalDeviceVulkan11Features{};
+    vk::PhysicalDeviceVulkan12Features physicalDeviceVulkan12Features{};
+    vk::PhysicalDeviceVulkan13Features physicalDeviceVulkan13Features{};
+    vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+    vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
 
     vk::Device logicalDevice;
     vk::DeviceQueueCreateInfo deviceQueueCreateInfo{};
@@ -257,6 +550,8 @@ private:
 #else
     const std::vector<const char *> logicalDeviceExtensions = {"VK_KHR_swapchain"};
 #endif
+    // Required extensions plus whichever optional ones the selected device supports
+    std::vector<const char *> enabledDeviceExtensions;
 
     vk::SurfaceKHR surface;
     vk::Queue presentQueue;
@@ -265,31 +560,86 @@ private:
     std::vector<vk::Image> swapChainImages;
     vk::Format swapChainImageFormat;
     vk::Extent2D swapChainExtent;
+    // Size of the rendered area of each view: the view's share of the swapchain extent, or the scaled part of it that
+    // dynamic resolution renders
+    vk::Extent2D renderExtent;
 
     std::vector<vk::ImageView> swapChainImageViews;
 
+    // Only created when dynamic rendering is unavailable or disabled, as are the framebuffers
     vk::RenderPass renderPass;
+    bool dynamicRenderingEnabled = false;
 
     vk::DescriptorSetLayout descriptorSetLayout;
     vk::PipelineLayout pipelineLayout;
 
-    vk::Pipeline graphicsPipeline;
+    // Shader permutations: feature flags packed into a key and handed to the scene shaders as specialization
+    // constants, so a pipeline only carries the features its draws use. Vertex colors and the alpha test belong to a
+    // draw's mesh and material and go into its sort key; the lighting mode is the same for the whole frame. Pipelines
+    // are built on first use, before recording, and cached by key until the sample count changes
+    static constexpr uint32_t PERMUTATION_VERTEX_COLORS = 1 << 0;
+    static constexpr uint32_t PERMUTATION_ALPHA_TEST = 1 << 1;
+    static constexpr uint32_t PERMUTATION_LIGHTING_SHIFT = 2;
+    static constexpr uint32_t PERMUTATION_DRAW_MASK = PERMUTATION_VERTEX_COLORS | PERMUTATION_ALPHA_TEST;
+    // Lighting modes, matching the LIGHTING_* defines of clustered_lighting.glsl
+    static constexpr uint32_t LIGHTING_UNLIT = 0;
+    static constexpr uint32_t LIGHTING_ALL_LIGHTS = 1;
+    static constexpr uint32_t LIGHTING_CLUSTERED = 2;
+    std::unordered_map<uint32_t, vk::Pipeline> graphicsPipelines;
+
+    // Lays down depth from the position stream alone, after which the shading pass tests for EQUAL without writing
+    // depth, so every covered sample is shaded once. Not used with occlusion culling, whose early pass already fills
+    // depth for the pyramid
+    vk::Pipeline depthPrepassPipeline;
+    bool depthPrepassEnabled = false;
 
     std::vector<vk::Framebuffer> swapChainFrameBuffers;
 
+    std::vector<RetiredSwapChain> retiredSwapChains;
+    DeletionQueue deletionQueue;
+
     vk::CommandPool commandPool;
+    std::vector<FrameCommandPools> frameCommandPools;
     std::vector<vk::CommandBuffer> commandBuffers;
 
+    // Reusable command buffers indexed by [frame * swapchain image count + image]. A buffer is re-recorded when its
+    // generation falls behind commandBufferGeneration
+    vk::CommandPool cachedCommandPool;
+    std::vector<vk::CommandBuffer> cachedCommandBuffers;
+    std::vector<uint64_t> cachedCommandBufferGenerations;
+    uint64_t commandBufferGeneration = 1;
+
+    // Acquire semaphores belong to frames in flight; present semaphores belong to swapchain images, since an image's
+    // semaphore can only be reused once that image has been acquired again
     std::vector<vk::Semaphore> imageAvailableSemaphores;
     std::vector<vk::Semaphore> renderFinishedSemaphores;
-    std::vector<vk::Fence> inFlightFences;
+
+    // Every submission to the graphics queue signals the next value of this semaphore, so "has submission N
+    // finished" is a single counter comparison for any subsystem
+    vk::Semaphore timelineSemaphore;
+    uint64_t timelineValue = 0;
+    uint64_t completedTimelineValue = 0;
+    std::vector<uint64_t> frameTimelineValues;
 
     uint32_t currentFrame = 0;
 
     bool framebufferResized = false;
 
+    FrameStatistics frameStatistics;
+
+    FramePacer framePacer;
+    bool presentWaitEnabled = false;
+    PFN_vkWaitForPresentKHR waitForPresentKHR = nullptr;
+    // Present ids reuse the frame's timeline value, which is already unique and increasing
+    uint64_t lastPresentId = 0;
+    vk::SwapchainKHR lastPresentSwapChain;
+    FramePacer::Clock::time_point frameStartTime;
+
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    std::vector<DrawCommand> drawCommands;
+    // Vertex format permutation flags of each mesh. Kept apart from drawCommands, whose layout the GPU reads
+    std::vector<uint32_t> meshPermutations;
     vk::Buffer vertexBuffer;
     vk::DeviceMemory vertexBufferMemory;
     vk::Buffer indexBuffer;
@@ -299,15 +649,176 @@ private:
     std::vector<vk::DeviceMemory> uniformBuffersMemory;
     std::vector<void*> uniformBuffersMapped;
 
+    // One model matrix per instance, streamed from the transform hierarchy. Each frame slot owns a buffer that grows
+    // on demand and records the hierarchy version it was last brought up to, so it only receives what changed since
+    uint32_t instanceCount = 1;
+    std::vector<vk::Buffer> instanceBuffers;
+    std::vector<vk::DeviceMemory> instanceBuffersMemory;
+    std::vector<void*> instanceBuffersMapped;
+    std::vector<uint32_t> instanceBufferCapacities;
+    std::vector<uint64_t> instanceBufferVersions;
+
+    // The instances are the last level of the hierarchy, starting at firstInstanceNode
+    TransformHierarchy transformHierarchy;
+    uint32_t firstInstanceNode = 0;
+    uint64_t cullingSphereVersion = 0;
+
+    // Instances placed by a scene file, which keep their transforms. Without one the model is repeated over a grid
+    // of instanceCount instances that spin
+    std::vector<SceneDescription::Instance> sceneInstances;
+    // Width of the area the instances cover, which the camera and the lights are fitted to
+    float sceneExtent = 0.0f;
+
+    glm::mat4 cameraView{};
+    glm::mat4 cameraProjection{};
+    glm::vec3 cameraPosition{};
+    // Projection times view of each camera of a multiview pass, spread around cameraView
+    std::array<glm::mat4, MAX_VIEWS> cameraViewProjections{};
+    static constexpr float CAMERA_NEAR_PLANE = 0.1f;
+    // Distance between neighbouring multiview cameras, as a fraction of the camera's distance from the scene
+    static constexpr float VIEW_SPACING = 0.1f;
+    float cameraFarPlane = 100.0f;
+    bool cameraDirty = true;
+
+    // Every mesh of every instance is an object with a world-space bounding sphere in the culler's table, at the
+    // object's index. Objects are ordered by mesh and then instance, so visible runs of one mesh can be drawn
+    // instanced. The frustum comes from the camera of the last uniform buffer update
+    uint32_t objectCount = 0;
+    std::vector<ObjectData> objects;
+    FrustumCuller frustumCuller;
+    FrustumCuller::Frustum cameraFrustum{};
+    // What the command buffers are recorded from: instanced draw runs sorted by state, or for the GPU-driven path
+    // the length of the visible object list
+    std::vector<VisibleDraw> visibleDraws;
+    std::vector<DrawSorter::Entry> drawSortEntries;
+    DrawSorter drawSorter;
+    uint32_t visibleObjectCount = 0;
+
+    std::chrono::high_resolution_clock::time_point animationStartTime = std::chrono::high_resolution_clock::now();
+
+    // GPU-driven rendering: the mesh table and the frame slot's visible object list are read by a compute pass that
+    // appends one indexed indirect command per object to the slot's indirect buffer, preceded by the draw count
+    static constexpr vk::DeviceSize INDIRECT_COMMANDS_OFFSET = 16;
+    bool gpuDrivenEnabled = false;
+    vk::Buffer meshBuffer;
+    vk::DeviceMemory meshBufferMemory;
+    std::vector<vk::Buffer> objectBuffers;
+    std::vector<vk::DeviceMemory> objectBuffersMemory;
+    std::vector<void*> objectBuffersMapped;
+    std::vector<vk::Buffer> indirectBuffers;
+    std::vector<vk::DeviceMemory> indirectBuffersMemory;
+    std::vector<uint32_t> drawCommandBufferCapacities;
+
+    vk::DescriptorSetLayout drawCommandSetLayout;
+    vk::PipelineLayout drawCommandPipelineLayout;
+    vk::Pipeline drawCommandPipeline;
+    std::vector<vk::DescriptorSet> drawCommandDescriptorSets;
+
+    // Clustered lighting: a compute pass appends every light to each froxel it reaches in a view-space grid of screen
+    // tiles and exponential depth slices, in the frame slot's cluster buffer of a count per cluster followed by
+    // MAX_LIGHTS_PER_CLUSTER index slots each, and fragments only shade the lights of their cluster. The grid matches
+    // the lighting shaders
+    static constexpr uint32_t CLUSTER_GRID_X = 16;
+    static constexpr uint32_t CLUSTER_GRID_Y = 9;
+    static constexpr uint32_t CLUSTER_GRID_Z = 24;
+    static constexpr uint32_t CLUSTER_COUNT = CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z;
+    static constexpr uint32_t MAX_LIGHTS_PER_CLUSTER = 256;
+    uint32_t lightCount = 0;
+    vk::Buffer lightBuffer;
+    vk::DeviceMemory lightBufferMemory;
+    std::vector<vk::Buffer> clusterBuffers;
+    std::vector<vk::DeviceMemory> clusterBuffersMemory;
+    vk::DescriptorSetLayout lightBinningSetLayout;
+    vk::PipelineLayout lightBinningPipelineLayout;
+    vk::Pipeline lightBinningPipeline;
+    std::vector<vk::DescriptorSet> lightBinningDescriptorSets;
+
+    // Two-phase occlusion culling on the GPU-driven path: objects are tested against the previous frame's depth
+    // pyramid and the survivors drawn, the pyramid is rebuilt from that depth, and the early rejects are tested again
+    // against it and drawn in a second pass
+    static constexpr vk::DeviceSize OCCLUSION_RETEST_OFFSET = 16;
+    bool occlusionCullingEnabled = false;
+    // Cleared by the occlusion benchmark to run the same passes without the test
+    bool occlusionTestEnabled = true;
+    vk::DescriptorSetLayout occlusionCullSetLayout;
+    vk::PipelineLayout occlusionCullPipelineLayout;
+    vk::Pipeline occlusionCullPipeline;
+    std::vector<vk::DescriptorSet> occlusionCullDescriptorSets;
+    std::vector<vk::Buffer> occlusionBuffers;
+    std::vector<vk::DeviceMemory> occlusionBuffersMemory;
+    std::vector<vk::Buffer> occlusionStatisticsBuffers;
+    std::vector<vk::DeviceMemory> occlusionStatisticsBuffersMemory;
+    std::vector<void*> occlusionStatisticsBuffersMapped;
+    std::vector<uint32_t> occlusionSubmittedObjectCounts;
+    uint64_t occlusionTestedObjects = 0;
+    uint64_t occlusionRejectedEarly = 0;
+    uint64_t occlusionRecoveredLate = 0;
+
+    // Farthest depth per texel, halving per level from the largest power of two that fits the swapchain
+    vk::Image depthPyramid;
+    vk::DeviceMemory depthPyramidMemory;
+    vk::ImageView depthPyramidView;
+    std::vector<vk::ImageView> depthPyramidLevelViews;
+    vk::Extent2D depthPyramidExtent;
+    uint32_t depthPyramidLevels = 0;
+    vk::Sampler depthPyramidSampler;
+    vk::DescriptorSetLayout depthPyramidSetLayout;
+    vk::PipelineLayout depthPyramidPipelineLayout;
+    vk::Pipeline depthPyramidPipeline;
+    vk::Pipeline depthPyramidMultisamplePipeline;
+    vk::DescriptorPool depthPyramidDescriptorPool;
+    std::vector<vk::DescriptorSet> depthPyramidDescriptorSets;
+
+    // Occlusion culling times its passes; otherwise the timer splits the frame into depth pre-pass and shading
+    GpuTimer gpuTimer;
+    bool pipelineStatisticsEnabled = false;
+    FragmentCounter fragmentCounter;
+
+    std::unique_ptr<Benchmark> benchmark;
+    // CPU time of the last frame from the end of the frame slot wait to present
+    std::chrono::duration<double> frameCpuTime{};
+    // GPU time of the last frame whose timestamps have been read back, when measured
+    std::chrono::duration<double> frameGpuTime{};
+
     vk::DescriptorPool descriptorPool;
     std::vector<vk::DescriptorSet> descriptorSets;
 
-    uint32_t mipLevels;
-    vk::Image textureImage;
-    vk::DeviceMemory textureImageMemory;
-    vk::ImageView textureImageView;
+    // Bumped whenever a resource referenced by the descriptor sets is replaced; each frame slot rewrites its set when
+    // it falls behind, once the slot's previous submission has completed
+    std::vector<uint64_t> descriptorSetGenerations;
+    uint64_t descriptorGeneration = 1;
+
+    ImageLayoutTracker imageLayoutTracker;
+
+    std::vector<Texture> textures;
     vk::Sampler textureSampler;
 
+    // Bindless textures: every texture sits in one partially bound, update-after-bind array in descriptor set 1, and
+    // draws select theirs by material index (a push constant, or read from the indirect buffer on the GPU-driven
+    // path), so no draw rebinds a set. Without descriptor indexing set 0 binds textures[0] as before
+    static constexpr uint32_t BINDLESS_SAMPLER_COUNT = 1;
+    static constexpr uint32_t MAX_BINDLESS_TEXTURES = 4096;
+    static constexpr uint32_t MATERIAL_FROM_DRAW = 0xFFFFFFFF;
+    bool bindlessEnabled = false;
+    uint32_t bindlessTextureCapacity = 0;
+    vk::DescriptorSetLayout bindlessSetLayout;
+    vk::DescriptorPool bindlessDescriptorPool;
+    std::vector<vk::DescriptorSet> bindlessDescriptorSets;
+
+    // Bumped when a texture is replaced in bindless mode. The array is update-after-bind, so slots rewrite it without
+    // re-recording command buffers
+    std::vector<uint64_t> bindlessTextureGenerations;
+    uint64_t textureGeneration = 1;
+
+    MemoryBudget memoryBudget;
+    bool memoryBudgetExtensionEnabled = false;
+    // Evictions free memory only once the GPU has finished with it, so no further eviction starts before then
+    uint64_t lastEvictionTimelineValue = 0;
+    // Set while a texture is being reduced, whose own allocation must not try to evict again
+    bool evictionInProgress = false;
+    bool geometryInHostMemory = false;
+    uint64_t frameNumber = 0;
+
     vk::Image colorImage;
     vk::DeviceMemory colorImageMemory;
     vk::ImageView colorImageView;
@@ -316,6 +827,20 @@ private:
     vk::DeviceMemory depthImageMemory;
     vk::ImageView depthImageView;
 
+    // Dynamic resolution renders into the top-left renderExtent of the attachments, resolves into the scene image and
+    // blits that up to the swapchain image. Dynamic rendering path without occlusion culling only
+    bool dynamicResolutionEnabled = false;
+    ResolutionController resolutionController;
+    vk::Image sceneImage;
+    vk::DeviceMemory sceneImageMemory;
+    vk::ImageView sceneImageView;
+
+    // Multiview renders viewCount layers of the attachments in one pass, each from its own camera, resolves them into
+    // the layers of the scene image and blits those side by side into the swapchain image. Dynamic rendering path
+    // without occlusion culling only
+    bool multiviewEnabled = false;
+    uint32_t viewCount = 1;
+
     const std::string MODEL_PATH = "resources/models/viking_room/viking_room.obj";
     const std::string TEXTURE_PATH = "resources/models/viking_room/viking_room.png";
 
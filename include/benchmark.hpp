@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Steps a single workload parameter (instance count, draw count, ...) through a list of values, measuring each one
+// for a fixed time after a short warm-up, and reports the results as a table once every step has run.
+class Benchmark
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Benchmark(std::string parameterName, std::vector<uint64_t> steps,
+              std::chrono::duration<double> stepDuration = std::chrono::duration<double>(3.0),
+              std::chrono::duration<double> warmUpDuration = std::chrono::duration<double>(0.5));
+
+    bool isFinished() const;
+    uint64_t getCurrentStep() const;
+    // The value the caller could actually apply for the current step, reported in its place
+    void setAppliedValue(uint64_t value);
+
+    // Records a frame that ended at `now` and spent `cpuTime` on the CPU and `gpuTime` on the GPU (zero when the GPU
+    // time is not measured). Returns true when the benchmark moved on to the next step, whose value the caller should
+    // then apply
+    bool recordFrame(Clock::time_point now, std::chrono::duration<double> cpuTime,
+                     std::chrono::duration<double> gpuTime = std::chrono::duration<double>::zero());
+
+    std::string buildReport() const;
+
+private:
+    struct StepResult
+    {
+        uint64_t value;
+        uint32_t frameCount;
+        double totalSeconds;
+        double cpuSeconds;
+        double gpuSeconds;
+    };
+
+    std::string parameterName;
+    std::vector<uint64_t> steps;
+    std::chrono::duration<double> stepDuration;
+    std::chrono::duration<double> warmUpDuration;
+
+    size_t currentStep = 0;
+    bool started = false;
+    Clock::time_point stepStart;
+    Clock::time_point measureStart;
+    StepResult currentResult{};
+    std::optional<uint64_t> appliedValue;
+
+    std::vector<StepResult> results;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+// Defers the destruction of device objects until the GPU has finished every submission that may still use them.
+// Objects are tagged with a timeline semaphore value, normally the value of the latest submission, and destroyed by
+// the first flush that sees that value completed. Device memory has no overload: it is freed through
+// Application::deferFreeDeviceMemory, which keeps the memory budget's accounting in step.
+class DeletionQueue
+{
+public:
+    void push(uint64_t timelineValue, vk::Buffer buffer);
+    void push(uint64_t timelineValue, vk::Image image);
+    void push(uint64_t timelineValue, vk::ImageView imageView);
+    void push(uint64_t timelineValue, vk::Framebuffer framebuffer);
+    void push(uint64_t timelineValue, vk::Pipeline pipeline);
+    void push(uint64_t timelineValue, vk::Sampler sampler);
+    void push(uint64_t timelineValue, vk::CommandPool commandPool, vk::CommandBuffer commandBuffer);
+    // For anything the typed overloads do not cover
+    void push(uint64_t timelineValue, std::function<void(vk::Device)> destroy);
+
+    // Destroys every object whose timeline value has been reached
+    void flush(vk::Device device, uint64_t completedTimelineValue);
+    // Destroys everything; the caller must have made sure the device is idle
+    void flushAll(vk::Device device);
+
+    size_t size() const;
+
+private:
+    struct Entry
+    {
+        uint64_t timelineValue;
+        std::function<void(vk::Device)> destroy;
+    };
+
+    // Kept sorted by timeline value, so flushing stops at the first entry that is still in use
+    std::deque<Entry> entries;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+// Orders a frame's draws by a packed 64-bit key so draws sharing state end up next to each other. From the most
+// significant bits down, a key holds the pass, pipeline, material, mesh and a depth bucket, so sorting groups by
+// everything that costs a state change first and draws front to back within a group. Keys are sorted with a
+// parallel least significant digit radix sort, 8 bits per pass.
+class DrawSorter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // A key and the index of the draw it was built for
+    struct Entry
+    {
+        uint64_t key;
+        uint32_t draw;
+    };
+
+    static constexpr uint32_t PASS_BITS = 4;
+    static constexpr uint32_t PIPELINE_BITS = 8;
+    static constexpr uint32_t MATERIAL_BITS = 20;
+    static constexpr uint32_t MESH_BITS = 16;
+    static constexpr uint32_t DEPTH_BITS = 16;
+
+    // Fields are truncated to their widths; the depth bucket is 0 nearest the camera
+    static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh, uint32_t depthBucket);
+    static uint32_t getPass(uint64_t key);
+    static uint32_t getPipeline(uint64_t key);
+    static uint32_t getMaterial(uint64_t key);
+    // Pass, pipeline and material: consecutive draws with equal states need no state change between them
+    static uint64_t getState(uint64_t key);
+
+    // Stable sort by key. Also counts the state changes the entries need in their given order and once sorted
+    void sort(std::vector<Entry> &entries, ThreadPool &threadPool);
+
+    // Draw count of the last sort, state changes per frame before and after sorting, and the sort time, averaged
+    // over the reporting window
+    std::string buildReport();
+
+private:
+    static uint64_t countStateChanges(const std::vector<Entry> &entries);
+
+    std::vector<Entry> scratch;
+    // Per range digit counts, turned into the range's scatter offsets
+    std::vector<std::array<uint32_t, 256>> rangeOffsets;
+
+    uint32_t lastDrawCount = 0;
+    uint64_t windowSortCount = 0;
+    uint64_t windowUnsortedStateChanges = 0;
+    uint64_t windowSortedStateChanges = 0;
+    double windowSortSeconds = 0.0;
+    double windowMaxSortSeconds = 0.0;
+};
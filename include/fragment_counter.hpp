@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Counts the fragment shader invocations of a frame with a pipeline statistics query. Every frame in flight owns a
+// query pool, read back once the frame slot's previous submission has completed. Frames drawn with and without the
+// depth pre-pass are counted apart, so a run that switches between the two reports the shading the pre-pass saves.
+class FragmentCounter
+{
+public:
+    // Does nothing unless the device was created with the pipelineStatisticsQuery feature
+    void initialize(vk::Device device, bool pipelineStatisticsEnabled, uint32_t frameCount);
+    void destroy(vk::Device device);
+
+    bool isSupported() const;
+
+    // Both have to be recorded outside a render pass instance, around the whole of it
+    void begin(vk::CommandBuffer commandBuffer, uint32_t frameIndex, bool depthPrepass);
+    void end(vk::CommandBuffer commandBuffer, uint32_t frameIndex);
+
+    // Reads the frame slot's last count into the reporting window. Returns false when the slot has no result
+    bool collect(vk::Device device, uint32_t frameIndex);
+
+    // Average invocations per frame with and without the pre-pass; a mode not drawn during the window keeps its last
+    // average
+    std::string buildReport();
+
+private:
+    std::vector<vk::QueryPool> queryPools;
+    std::vector<bool> queryPoolsRecorded;
+    std::vector<bool> queryPoolsDepthPrepass;
+
+    // Indexed by whether the pre-pass was on
+    uint64_t windowInvocations[2] = {};
+    uint64_t windowFrameCounts[2] = {};
+    double averageInvocations[2] = {};
+    bool measured[2] = {};
+};
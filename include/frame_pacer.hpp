@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Decides when the CPU should start a frame so that it completes just before the next vertical blank, given the
+// times at which previous frames were actually presented. Also records the achieved present intervals and their
+// jitter.
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FramePacer(std::chrono::duration<double> refreshInterval = std::chrono::duration<double>(1.0 / 60.0));
+
+    // Seeds the refresh interval estimate, e.g. from the monitor's reported refresh rate
+    void setRefreshInterval(std::chrono::duration<double> refreshInterval);
+
+    // CPU time from frame start to submission, used to predict how long before a vblank a frame must start
+    void recordFrameWork(Clock::duration work);
+    void recordPresent(Clock::time_point presentTime);
+
+    Clock::time_point getNextFrameStart() const;
+
+    // Summarises intervals, jitter and missed vblanks since the previous report
+    std::string buildReport();
+
+private:
+    std::chrono::duration<double> refreshInterval;
+    std::chrono::duration<double> predictedWork{0.0};
+    // Grows when a present misses its vblank and decays back towards the minimum while frames land on time
+    std::chrono::duration<double> safetyMargin;
+
+    bool hasPresented = false;
+    Clock::time_point lastPresentTime;
+
+    std::vector<double> presentIntervals;
+    uint32_t missedIntervals = 0;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Collects per-frame timings over a reporting window: throughput, CPU frame time, and latency from frame start and
+// from input to the frame's completion. Completion is whatever the caller can observe, named in the report: the
+// frame reaching the display, or only the GPU finishing it. Frames are identified by a monotonically increasing id
+// (the frame's timeline value), so completion of frame N implies completion of every earlier frame.
+class FrameStatistics
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FrameStatistics(std::chrono::duration<double> reportInterval = std::chrono::seconds(5));
+
+    // Label printed with every report. Changing it starts a new window so results never mix configurations
+    void setConfiguration(const std::string &label);
+    // Name of the event completeFrames is called for, such as "present" or "gpu-done"
+    void setCompletionEvent(const std::string &name);
+
+    // Records an input event. The earliest event not yet consumed is latched by the next frame that begins
+    void recordInput(Clock::time_point time);
+
+    void beginFrame(Clock::time_point time);
+    void submitFrame(uint64_t frameId);
+    // Marks every submitted frame with an id up to and including frameId as completed at the given time
+    void completeFrames(uint64_t frameId, Clock::time_point time);
+
+    bool isReportDue(Clock::time_point time) const;
+    // Summarises the current window and starts a new one
+    std::string buildReport(Clock::time_point time);
+
+private:
+    struct FrameRecord
+    {
+        uint64_t frameId = 0;
+        Clock::time_point startTime;
+        std::optional<Clock::time_point> inputTime;
+    };
+
+    void resetWindow(Clock::time_point time);
+
+    std::chrono::duration<double> reportInterval;
+    std::string configuration;
+    std::string completionEvent = "gpu-done";
+
+    std::optional<Clock::time_point> pendingInputTime;
+    std::optional<FrameRecord> currentFrame;
+    std::deque<FrameRecord> submittedFrames;
+    std::optional<Clock::time_point> lastFrameStart;
+
+    Clock::time_point windowStart;
+    uint64_t windowFrameCount = 0;
+    std::vector<double> frameTimes;
+    std::vector<double> completionLatencies;
+    std::vector<double> inputLatencies;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+// Tests an object table of world-space bounding spheres against the camera frustum. The table is stored as a
+// structure of arrays, one float array per component, so the kernels load 8 (AVX2) or 4 (NEON) spheres per
+// instruction. The result is a compact list of visible object indices in ascending order.
+class FrustumCuller
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Plane (a, b, c, d) with a unit normal pointing into the frustum: a point is inside when ax + by + cz + d >= 0
+    struct Plane
+    {
+        float a;
+        float b;
+        float c;
+        float d;
+    };
+
+    using Frustum = std::array<Plane, 6>;
+
+    // Extracts the six planes of a column-major view-projection matrix with a [0, 1] depth range
+    static Frustum extractFrustum(const float *viewProjection);
+
+    // Name of the kernel selected for this CPU, for reports
+    static const char *getKernelName();
+
+    void resize(uint32_t objectCount);
+    uint32_t getObjectCount() const;
+
+    void setSphere(uint32_t objectIndex, float x, float y, float z, float radius);
+
+    // Rebuilds the visible list, splitting large tables across the thread pool
+    void cull(const Frustum &frustum, ThreadPool &threadPool);
+    // Marks every object visible, for when culling is disabled
+    void cullNone();
+
+    const std::vector<uint32_t> &getVisibleObjects() const;
+
+    // Visible and culled counts of the last cull, and its average and worst time over the reporting window
+    std::string buildReport();
+
+private:
+    void recordCullTime(std::chrono::duration<double> time);
+
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radii;
+
+    // Each range writes its own list, which are then concatenated in range order
+    std::vector<std::vector<uint32_t>> rangeVisibleObjects;
+    std::vector<uint32_t> visibleObjects;
+
+    uint64_t windowCullCount = 0;
+    double windowCullSeconds = 0.0;
+    double windowMaxCullSeconds = 0.0;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Measures consecutive sections of a frame's GPU work with timestamp queries. Every frame in flight owns a query
+// pool, read back once the frame slot's previous submission has completed, so reading never stalls. Section i runs
+// from timestamp i to timestamp i + 1.
+class GpuTimer
+{
+public:
+    void initialize(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+                    uint32_t frameCount, std::vector<std::string> sectionNames);
+    void destroy(vk::Device device);
+
+    // False when the queue does not support timestamps, in which case recording and collecting do nothing
+    bool isSupported() const;
+
+    // Resets the frame slot's queries; has to be recorded before its first timestamp
+    void reset(vk::CommandBuffer commandBuffer, uint32_t frameIndex);
+    void writeTimestamp(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t timestampIndex,
+                        vk::PipelineStageFlags2 stage);
+
+    // Reads the frame slot's last results into the reporting window. Returns false when the slot has no results
+    bool collect(vk::Device device, uint32_t frameIndex);
+
+    // Total of every section in the last collected frame
+    double getLastFrameMilliseconds() const;
+    // Average time per section over the reporting window, which it then resets
+    std::string buildReport();
+
+private:
+    std::vector<vk::QueryPool> queryPools;
+    std::vector<bool> queryPoolsRecorded;
+    std::vector<std::string> sectionNames;
+    double timestampPeriod = 0.0;
+    uint64_t timestampMask = 0;
+
+    std::vector<uint64_t> timestamps;
+    double lastFrameMilliseconds = 0.0;
+    std::vector<double> windowSectionMilliseconds;
+    uint64_t windowFrameCount = 0;
+};
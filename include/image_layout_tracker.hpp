@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+// Tracks the layout and last declared access of every subresource of registered images and turns requested
+// transitions into batched synchronization2 barriers. A transition only waits on the stages and accesses that were
+// declared for the subresource before it, and read-after-read uses in an unchanged layout emit no barrier at all.
+class ImageLayoutTracker
+{
+public:
+    struct SubresourceState
+    {
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+        vk::PipelineStageFlags2 stageMask = vk::PipelineStageFlagBits2::eNone;
+        vk::AccessFlags2 accessMask = vk::AccessFlagBits2::eNone;
+    };
+
+    void registerImage(vk::Image image, vk::ImageAspectFlags aspectMask, uint32_t mipLevels, uint32_t arrayLayers,
+                       vk::ImageLayout initialLayout = vk::ImageLayout::eUndefined);
+    void unregisterImage(vk::Image image);
+
+    // Queues the barriers needed before the range is used in newLayout by the given stages and accesses. A range
+    // that already has a queued barrier is flushed into the command buffer first, as barriers within one batch are
+    // unordered.
+    void transition(vk::CommandBuffer commandBuffer, vk::Image image, const vk::ImageSubresourceRange &range,
+                    vk::ImageLayout newLayout, vk::PipelineStageFlags2 stageMask, vk::AccessFlags2 accessMask);
+    // Same as above, using the stages and accesses a layout is normally used with
+    void transition(vk::CommandBuffer commandBuffer, vk::Image image, const vk::ImageSubresourceRange &range,
+                    vk::ImageLayout newLayout);
+
+    // Records a state change made outside the tracker, e.g. by a render pass's final layout
+    void setState(vk::Image image, const vk::ImageSubresourceRange &range, const SubresourceState &state);
+    SubresourceState getState(vk::Image image, uint32_t mipLevel, uint32_t arrayLayer) const;
+
+    // Emits every queued barrier with a single vkCmdPipelineBarrier2
+    void flush(vk::CommandBuffer commandBuffer);
+
+    uint32_t getFlushedBarrierCount() const;
+    uint32_t getSkippedTransitionCount() const;
+
+    static SubresourceState getDefaultState(vk::ImageLayout layout);
+
+private:
+    struct TrackedImage
+    {
+        vk::ImageAspectFlags aspectMask;
+        uint32_t mipLevels;
+        uint32_t arrayLayers;
+        // Indexed by [arrayLayer * mipLevels + mipLevel]
+        std::vector<SubresourceState> subresources;
+        std::vector<bool> pending;
+    };
+
+    TrackedImage &getTrackedImage(vk::Image image);
+
+    std::unordered_map<VkImage, TrackedImage> images;
+    std::vector<vk::ImageMemoryBarrier2> pendingBarriers;
+    std::vector<std::pair<VkImage, size_t>> pendingSubresources;
+
+    uint32_t flushedBarrierCount = 0;
+    uint32_t skippedTransitionCount = 0;
+};
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+enum class MemoryCategory : uint32_t
+{
+    Geometry,
+    Textures,
+    RenderTargets,
+    Staging,
+    Uniforms,
+    Instances,
+    Lights,
+    Count
+};
+
+// Keeps track of every device memory allocation by category and heap, and of the per-heap budgets reported by
+// VK_EXT_memory_budget. Without the extension the budget is a fixed share of the heap size and usage is whatever the
+// application itself has allocated.
+class MemoryBudget
+{
+public:
+    // A non-zero deviceLocalBudgetLimit caps the budget of every device-local heap, in bytes
+    void initialize(vk::PhysicalDevice physicalDevice, bool budgetExtensionEnabled,
+                    vk::DeviceSize deviceLocalBudgetLimit);
+
+    // Re-queries heap budgets and usage; cheap enough to call once per frame
+    void update();
+
+    void trackAllocation(vk::DeviceMemory memory, MemoryCategory category, uint32_t memoryTypeIndex,
+                         vk::DeviceSize size);
+    void trackFree(vk::DeviceMemory memory);
+
+    uint32_t getHeapCount() const;
+    uint32_t getHeapIndex(uint32_t memoryTypeIndex) const;
+    bool isDeviceLocalHeap(uint32_t heapIndex) const;
+    vk::DeviceSize getHeapBudget(uint32_t heapIndex) const;
+    vk::DeviceSize getHeapUsage(uint32_t heapIndex) const;
+    vk::DeviceSize getCategoryUsage(MemoryCategory category) const;
+
+    // Bytes by which the device-local heaps together exceed their budgets
+    vk::DeviceSize getDeviceLocalOverBudget() const;
+
+    std::string buildReport() const;
+
+    static const char *getCategoryName(MemoryCategory category);
+
+private:
+    struct Allocation
+    {
+        MemoryCategory category;
+        uint32_t heapIndex;
+        vk::DeviceSize size;
+    };
+
+    vk::PhysicalDevice physicalDevice;
+    bool budgetExtensionEnabled = false;
+    vk::DeviceSize deviceLocalBudgetLimit = 0;
+    vk::PhysicalDeviceMemoryProperties memoryProperties;
+
+    std::vector<vk::DeviceSize> heapBudgets;
+    // Usage as reported by the driver, or the tracked usage when the extension is unavailable
+    std::vector<vk::DeviceSize> heapUsages;
+    std::vector<vk::DeviceSize> trackedHeapUsages;
+    std::array<vk::DeviceSize, static_cast<size_t>(MemoryCategory::Count)> categoryUsages{};
+
+    std::unordered_map<VkDeviceMemory, Allocation> allocations;
+};
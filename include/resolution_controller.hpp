@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Picks the fraction of the window resolution to render at from measured GPU frame times, keeping the GPU within a
+// frame-time target. GPU time is taken to follow the rendered pixel count, the square of the scale. The scale drops
+// as soon as the smoothed time is over the target but only rises after a run of frames well under it, and moves in
+// fixed steps, so it settles instead of changing every frame. Over target at the minimum scale it asks for fewer
+// MSAA samples, and at full scale with headroom for more.
+class ResolutionController
+{
+public:
+    enum class SampleRequest
+    {
+        None,
+        Fewer,
+        More
+    };
+
+    void configure(double targetMilliseconds, float minimumScale);
+
+    // Feeds the GPU time of a completed frame. Returns true when the scale changed
+    bool recordFrame(double gpuMilliseconds);
+    float getScale() const;
+
+    // Returns and clears the pending sample count request
+    SampleRequest takeSampleRequest();
+    // Drops the smoothed time after a change whose effect on GPU time can't be predicted, like a new sample count
+    void restartMeasurement();
+
+    // Scale range, scale changes and frames over the target in the reporting window, which it then resets
+    std::string buildReport(uint32_t sampleCount);
+
+private:
+    bool applyScale(float newScale);
+
+    double targetMilliseconds = 16.0;
+    float minimumScale = 0.5f;
+    float scale = 1.0f;
+
+    double smoothedMilliseconds = 0.0;
+    bool hasMeasurement = false;
+    uint32_t framesSinceChange = 0;
+    uint32_t pressureFrames = 0;
+    uint32_t headroomFrames = 0;
+    SampleRequest sampleRequest = SampleRequest::None;
+
+    uint64_t windowFrameCount = 0;
+    uint64_t windowOverTargetFrames = 0;
+    uint64_t windowScaleChanges = 0;
+    float windowMinimumScale = 1.0f;
+    float windowMaximumScale = 0.0f;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tiny_obj_loader/tiny_obj_loader.h"
+
+#include "thread_pool.hpp"
+
+// What a scene is made of: the meshes and textures it loads by path, materials that pair a texture with the
+// shading, and instances that place a mesh with a material. Scenes are authored as text, one directive per line,
+// and can be saved as binary, which loads without parsing:
+//
+//     mesh     <name> <path>
+//     texture  <name> <path>
+//     material <name> <texture>
+//     instance <mesh> <material> <x> <y> <z> [<angle> [<scale>]]
+//     grid     <mesh> <material> <columns> <rows> <spacing>
+//
+// Paths are relative to the scene file, angles are degrees about Z and a grid is a block of instances centered on
+// the origin. Everything after a '#' is a comment.
+struct SceneDescription
+{
+    struct Material
+    {
+        uint32_t texture;
+    };
+
+    // Rotation is a quaternion, x, y, z, w
+    struct Instance
+    {
+        uint32_t mesh;
+        uint32_t material;
+        float translation[3];
+        float rotation[4];
+        float scale;
+    };
+
+    std::vector<std::string> meshPaths;
+    std::vector<std::string> texturePaths;
+    std::vector<Material> materials;
+    std::vector<Instance> instances;
+
+    // Reads a text or binary scene, told apart by the binary header
+    static SceneDescription load(const std::string &path);
+    void saveBinary(const std::string &path) const;
+
+private:
+    static SceneDescription parseText(const std::string &path, const std::string &text);
+    static SceneDescription parseBinary(const std::string &path, const std::string &data);
+    void validate(const std::string &path) const;
+};
+
+// The decoded meshes and textures of a scene. Files are read and decoded on the thread pool, and each distinct
+// file only once: paths naming the same file, and files with identical contents, share one model or image
+struct SceneAssets
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Model
+    {
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+    };
+
+    // RGBA, 8 bits per channel
+    struct Image
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::unique_ptr<unsigned char, void (*)(void *)> pixels{nullptr, nullptr};
+    };
+
+    std::vector<Model> models;
+    std::vector<Image> images;
+    // Model of each of the description's meshes and image of each of its textures
+    std::vector<uint32_t> meshModels;
+    std::vector<uint32_t> textureImages;
+
+    static SceneAssets fetch(const SceneDescription &scene, ThreadPool &threadPool);
+
+    // Referenced and unique assets, bytes read and the time the fetch took
+    std::string buildReport() const;
+
+private:
+    uint64_t bytesRead = 0;
+    double fetchSeconds = 0.0;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Runtime configuration, filled from `--option=value` command line arguments
+struct Settings
+{
+    // Record draws into secondary command buffers spread across the worker threads
+    bool parallelRecording = false;
+    // Frames the CPU may record ahead of the GPU. More frames raise throughput at the cost of latency
+    uint32_t framesInFlight = 2;
+    // Requested swapchain image count, clamped to what the surface supports (0 requests one above the minimum)
+    uint32_t swapchainImageCount = 0;
+    // Present mode policy: auto (mailbox, else FIFO), fifo, fifo-relaxed, mailbox or immediate. Unsupported modes
+    // fall back to FIFO
+    std::string presentMode = "auto";
+    // Start each frame just early enough to finish before the next vblank, using VK_KHR_present_wait when available
+    bool framePacing = false;
+    // Periodically print throughput and input latency for the active configuration, to presentation when frame pacing
+    // can wait for presents and to GPU completion otherwise
+    bool frameStatistics = false;
+    // Record command buffers once per frame slot and swapchain image and replay them until the scene, pipeline or
+    // swapchain changes
+    bool cachedCommandBuffers = false;
+    // Render with dynamic rendering instead of a render pass and framebuffers. The render pass path is kept to compare
+    // against; every supported device has dynamic rendering, as it is core in Vulkan 1.3
+    bool dynamicRendering = true;
+    // Caps the budget of device-local memory heaps in MiB, to exercise eviction (0 uses the driver's budget)
+    uint32_t memoryBudgetMiB = 0;
+    // Build the frame's draw list in a compute pass and draw it with a single indirect draw, when the device
+    // supports multi-draw indirect with a GPU-side count
+    bool gpuDriven = true;
+    // Skip objects whose bounding sphere lies outside the camera frustum
+    bool frustumCulling = true;
+    // Two-phase GPU occlusion culling against a hierarchical depth pyramid. Needs the GPU-driven and dynamic
+    // rendering paths, and keeps the multisampled attachments in memory between the two passes
+    bool occlusionCulling = false;
+    // Lay down depth from the position stream first, then shade with an EQUAL depth test and no depth writes, so
+    // overdraw costs only depth testing. Not used with occlusion culling
+    bool depthPrepass = false;
+    // Render at a fraction of the window resolution picked from measured GPU frame times and upscale to the swapchain
+    // image. Needs dynamic rendering and GPU timestamps; not used with occlusion culling
+    bool dynamicResolution = false;
+    // GPU frame time dynamic resolution aims to stay within, in microseconds
+    uint32_t gpuFrameTargetMicroseconds = 14000;
+    // Lowest render scale dynamic resolution may pick, in percent of the window resolution
+    uint32_t minimumResolutionScale = 50;
+    // Let dynamic resolution halve the MSAA sample count when even the minimum scale is over the target, and raise it
+    // again at full scale with headroom
+    bool dynamicMsaa = false;
+    // Index every texture from one update-after-bind descriptor array instead of binding one per set, when the
+    // device supports descriptor indexing
+    bool bindlessTextures = true;
+    // Point lights scattered over the scene. 0 leaves it unlit
+    uint32_t lightCount = 0;
+    // Shade only the lights binned into the fragment's view-space cluster. Off, every fragment loops over every light
+    bool clusteredLighting = true;
+    // Views rendered in one multiview pass, from cameras spaced along the camera's right axis and shown side by side.
+    // Needs dynamic rendering; not used with occlusion culling
+    uint32_t viewCount = 1;
+    // Scene file to render instead of the instance grid, text or binary. Empty draws the built-in model
+    std::string scene;
+    // Writes the loaded scene to this path in the binary format, which loads without parsing
+    std::string saveBinaryScene;
+    // Copies of the model drawn with a single instanced draw per mesh. Not used with a scene file
+    uint32_t instanceCount = 1;
+    // Spin the instances. Off, they keep their first pose and no transform is recomputed after the first frame
+    bool animate = true;
+    // Merge consecutive visible instances of a mesh into one draw. Off, every object is its own draw with its
+    // transform index in a push constant (CPU-recorded path only)
+    bool instancing = true;
+    // Runs a benchmark instead of the normal scene and exits when it completes: "instances" scales the instance
+    // count from 1 to 1M, "draws" issues 1 to 100k separate draws, "occlusion" runs with the occlusion test off and
+    // then on, "prepass" with the depth pre-pass off and then on, "lights" scales the light count from 10 to 10k.
+    // Empty runs no benchmark
+    std::string benchmark;
+    // Threads available for CPU-side work, including the main thread (0 picks the hardware concurrency)
+    uint32_t workerThreads = 0;
+
+    static Settings fromCommandLine(int argc, char **argv);
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that execute indexed task batches. The calling thread takes part in every batch,
+// so a pool created with a thread count of N runs at most N tasks concurrently.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(uint32_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    uint32_t getThreadCount() const;
+
+    // Runs task(0) ... task(count - 1) and blocks until every task has finished. The first exception thrown by a
+    // task is rethrown on the calling thread.
+    void parallelFor(uint32_t count, const std::function<void(uint32_t)> &task);
+
+private:
+    void workerLoop();
+    void executeTasks(uint64_t generation);
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+
+    // Batch state, guarded by the mutex. Tasks are expected to be coarse, so handing out indices under the lock is
+    // cheap compared to the work they do
+    const std::function<void(uint32_t)> *currentTask = nullptr;
+    uint32_t taskCount = 0;
+    uint32_t nextTask = 0;
+    uint32_t remainingTasks = 0;
+
+    uint64_t batchGeneration = 0;
+    bool stopping = false;
+    std::exception_ptr firstError;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "thread_pool.hpp"
+
+// Parent/child transforms stored breadth-first as a structure of arrays: every node comes after its parent and the
+// nodes of one depth are contiguous, so each depth level is a flat range that can be split across threads once the
+// level above it is done. Local transforms are translation, rotation quaternion and uniform scale; world matrices are
+// column-major 4x4 floats, laid out so they can be copied straight into a mat4 buffer.
+class TransformHierarchy
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    void clear();
+    // Appends a node with an identity local transform. Nodes have to be added in breadth-first order: a node's depth
+    // can't be less than the depth of the node added before it
+    uint32_t addNode(uint32_t parent);
+    uint32_t getNodeCount() const;
+
+    // Setters mark the node dirty; it and its subtree are recomputed by the next update. Distinct nodes may be set
+    // from different threads
+    void setLocalTranslation(uint32_t node, float x, float y, float z);
+    void setLocalRotation(uint32_t node, float x, float y, float z, float w);
+    void setLocalScale(uint32_t node, float scale);
+
+    // Mapped buffer that receives the world matrices of nodes [firstNode, firstNode + count), 16 floats per node
+    // starting with firstNode. Nodes that changed after sinceVersion are written; passing 0 writes all of them
+    struct WorldOutput
+    {
+        float *destination;
+        uint32_t firstNode;
+        uint32_t count;
+        uint64_t sinceVersion;
+    };
+
+    // Recomputes the world matrices of dirty nodes and their descendants, level by level. Every update starts a new
+    // version, which the recomputed nodes are stamped with. With an output, its nodes are written in the same pass
+    // while they are still in cache, instead of in a second pass over every matrix
+    void update(ThreadPool &threadPool, const WorldOutput *output = nullptr);
+
+    uint64_t getVersion() const;
+    uint64_t getWorldVersion(uint32_t node) const;
+    const float *getWorldMatrix(uint32_t node) const;
+
+    // Node and level counts, and the average recomputed nodes and update time over the reporting window
+    std::string buildReport();
+
+private:
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> depths;
+    // Index of the first node of every depth, followed by the node count
+    std::vector<uint32_t> levelStarts;
+
+    std::vector<float> translationX;
+    std::vector<float> translationY;
+    std::vector<float> translationZ;
+    std::vector<float> rotationX;
+    std::vector<float> rotationY;
+    std::vector<float> rotationZ;
+    std::vector<float> rotationW;
+    std::vector<float> scales;
+    std::vector<uint8_t> localDirty;
+
+    std::vector<float> worldMatrices;
+    std::vector<uint64_t> worldVersions;
+    uint64_t version = 0;
+
+    std::vector<uint32_t> rangeUpdatedCounts;
+
+    uint64_t windowUpdateCount = 0;
+    uint64_t windowUpdatedNodes = 0;
+    double windowUpdateSeconds = 0.0;
+    double windowMaxUpdateSeconds = 0.0;
+};
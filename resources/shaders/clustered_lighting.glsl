@@ -0,0 +1,114 @@
+// Clustered point lighting shared by the fragment shaders, included rather than compiled on its own. The view
+// frustum is split into CLUSTER_X x CLUSTER_Y screen tiles and CLUSTER_Z slices spaced exponentially in view depth;
+// light_binning.glsl lists the lights reaching each cluster, so a fragment only visits the lights of its own cluster
+// instead of every light in the scene
+
+// Match Application::CLUSTER_GRID_X/Y/Z and Application::MAX_LIGHTS_PER_CLUSTER
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+#define MAX_LIGHTS_PER_CLUSTER 256
+
+#define AMBIENT_LIGHT 0.05
+
+// Match Application::LIGHTING_*
+#define LIGHTING_UNLIT 0
+#define LIGHTING_ALL_LIGHTS 1
+#define LIGHTING_CLUSTERED 2
+
+// Fixed per pipeline, so each permutation only compiles the loop it runs
+layout(constant_id = 2) const uint LIGHTING_MODE = LIGHTING_CLUSTERED;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject
+{
+    mat4 view;
+    mat4 projection;
+    uint lightCount;
+    vec2 viewportSize;
+    vec2 depthRange;
+}ubo;
+
+// Matches Application::PointLight, in world space
+struct PointLight
+{
+    vec3 position;
+    float radius;
+    vec3 color;
+    float intensity;
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer LightBuffer
+{
+    PointLight lights[];
+};
+
+// Each cluster owns MAX_LIGHTS_PER_CLUSTER index slots. clusterLightCounts[cluster] counts every light that reached
+// the cluster, including those dropped once its slots were full
+layout(std430, set = 0, binding = 4) readonly buffer ClusterBuffer
+{
+    uint clusterLightCounts[CLUSTER_COUNT];
+    uint clusterLightIndices[];
+};
+
+uint getClusterIndex(vec2 fragmentCoordinates, float viewDepth)
+{
+    uvec2 tile = min(uvec2(fragmentCoordinates / ubo.viewportSize * vec2(CLUSTER_X, CLUSTER_Y)),
+                     uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+
+    float near = ubo.depthRange.x;
+    float far = ubo.depthRange.y;
+    uint slice = uint(clamp(log(viewDepth / near) / log(far / near) * CLUSTER_Z, 0.0, CLUSTER_Z - 1.0));
+
+    return (slice * CLUSTER_Y + tile.y) * CLUSTER_X + tile.x;
+}
+
+vec3 shadePointLight(PointLight light, vec3 position, vec3 normal)
+{
+    vec3 toLight = light.position - position;
+    float distanceSquared = dot(toLight, toLight);
+    float radiusSquared = light.radius * light.radius;
+    if (distanceSquared >= radiusSquared)
+    {
+        return vec3(0.0);
+    }
+
+    // Falls to zero at the radius, so the cluster bounds cut nothing visible off
+    float falloff = 1.0 - distanceSquared / radiusSquared;
+    float diffuse = max(dot(normal, toLight * inversesqrt(max(distanceSquared, 1e-8))), 0.0);
+
+    return light.color * (light.intensity * diffuse * falloff * falloff);
+}
+
+// Light reaching a surface point in world space; without lights the scene stays unlit
+vec3 computeLighting(vec3 position, vec3 normal, vec2 fragmentCoordinates)
+{
+    if (LIGHTING_MODE == LIGHTING_UNLIT)
+    {
+        return vec3(1.0);
+    }
+
+    vec3 lighting = vec3(AMBIENT_LIGHT);
+
+    // Every light for every fragment, kept to compare against
+    if (LIGHTING_MODE == LIGHTING_ALL_LIGHTS)
+    {
+        for (uint i = 0; i < ubo.lightCount; i++)
+        {
+            lighting += shadePointLight(lights[i], position, normal);
+        }
+        return lighting;
+    }
+
+    float viewDepth = -(ubo.view * vec4(position, 1.0)).z;
+    uint cluster = getClusterIndex(fragmentCoordinates, viewDepth);
+    uint firstIndex = cluster * MAX_LIGHTS_PER_CLUSTER;
+
+    uint clusterLightCount = min(clusterLightCounts[cluster], MAX_LIGHTS_PER_CLUSTER);
+    for (uint i = 0; i < clusterLightCount; i++)
+    {
+        lighting += shadePointLight(lights[clusterLightIndices[firstIndex + i]], position, normal);
+    }
+
+    return lighting;
+}
@@ -1,5 +1,13 @@
 # if unable to run, use `chmod +x compile.sh`
+# CMake compiles these on every build; this is for iterating on the shaders without it
+mkdir -p compiled
 glslc -fshader-stage=vertex vert.glsl -o compiled/vert.spv
 glslc -fshader-stage=fragment frag.glsl -o compiled/frag.spv
-
-# TODO: Make a compile.bat equivalent
\ No newline at end of file
+glslc -fshader-stage=compute draw_commands.glsl -o compiled/draw_commands.spv
+glslc -fshader-stage=compute occlusion_cull.glsl -o compiled/occlusion_cull.spv
+glslc -fshader-stage=compute depth_pyramid.glsl -o compiled/depth_pyramid.spv
+glslc -fshader-stage=compute depth_pyramid_multisample.glsl -o compiled/depth_pyramid_multisample.spv
+glslc -fshader-stage=vertex vert_bindless.glsl -o compiled/vert_bindless.spv
+glslc -fshader-stage=fragment frag_bindless.glsl -o compiled/frag_bindless.spv
+glslc -fshader-stage=vertex depth_prepass.glsl -o compiled/depth_prepass.spv
+glslc -fshader-stage=compute light_binning.glsl -o compiled/light_binning.spv
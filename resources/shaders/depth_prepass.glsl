@@ -0,0 +1,41 @@
+#version 460
+#extension GL_EXT_multiview : require
+
+// Matches Application::MAX_VIEWS
+#define MAX_VIEWS 4
+
+layout(binding = 0) uniform UniformBufferObject
+{
+    mat4 view;
+    mat4 projection;
+    uint lightCount;
+    vec2 viewportSize;
+    vec2 depthRange;
+    // One camera per view of a multiview pass; without multiview gl_ViewIndex is 0
+    mat4 viewProjections[MAX_VIEWS];
+}ubo;
+
+// Streamed every frame, one transform per instance
+layout(std430, binding = 2) readonly buffer InstanceBuffer
+{
+    mat4 models[];
+}instances;
+
+// Matches Application::DrawParameters; the material is not needed for depth
+layout(push_constant) uniform DrawParameters
+{
+    uint transformBase;
+    uint materialIndex;
+}draw;
+
+// Only the position stream is bound, 12 bytes per vertex
+layout(location = 0) in vec3 inPosition;
+
+// Computed exactly as in the shading vertex shaders, so the shading pass's EQUAL depth test matches this depth
+invariant gl_Position;
+
+void main()
+{
+    vec4 position = instances.models[draw.transformBase + gl_InstanceIndex] * vec4(inPosition, 1.0);
+    gl_Position = ubo.viewProjections[gl_ViewIndex] * position;
+}
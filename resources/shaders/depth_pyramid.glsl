@@ -0,0 +1,34 @@
+#version 460
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// The previous pyramid level, or the depth attachment itself when it is single-sampled
+layout(binding = 0) uniform sampler2D inputDepth;
+layout(binding = 1, r32f) uniform writeonly image2D outputLevel;
+
+void main()
+{
+    ivec2 outputSize = imageSize(outputLevel);
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(texel, outputSize)))
+    {
+        return;
+    }
+
+    // Every input texel the output texel overlaps, rounded outwards so the reduction stays conservative for sizes
+    // that do not halve evenly
+    ivec2 inputSize = textureSize(inputDepth, 0);
+    ivec2 first = texel * inputSize / outputSize;
+    ivec2 last = min(((texel + 1) * inputSize + outputSize - 1) / outputSize, inputSize) - 1;
+
+    float depth = 0.0;
+    for (int y = first.y; y <= last.y; y++)
+    {
+        for (int x = first.x; x <= last.x; x++)
+        {
+            depth = max(depth, texelFetch(inputDepth, ivec2(x, y), 0).r);
+        }
+    }
+
+    imageStore(outputLevel, texel, vec4(depth));
+}
@@ -0,0 +1,36 @@
+#version 460
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+// First pyramid level from the multisampled depth attachment, keeping the farthest sample
+layout(binding = 0) uniform sampler2DMS inputDepth;
+layout(binding = 1, r32f) uniform writeonly image2D outputLevel;
+
+void main()
+{
+    ivec2 outputSize = imageSize(outputLevel);
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(texel, outputSize)))
+    {
+        return;
+    }
+
+    ivec2 inputSize = textureSize(inputDepth);
+    ivec2 first = texel * inputSize / outputSize;
+    ivec2 last = min(((texel + 1) * inputSize + outputSize - 1) / outputSize, inputSize) - 1;
+    int sampleCount = textureSamples(inputDepth);
+
+    float depth = 0.0;
+    for (int y = first.y; y <= last.y; y++)
+    {
+        for (int x = first.x; x <= last.x; x++)
+        {
+            for (int s = 0; s < sampleCount; s++)
+            {
+                depth = max(depth, texelFetch(inputDepth, ivec2(x, y), s).r);
+            }
+        }
+    }
+
+    imageStore(outputLevel, texel, vec4(depth));
+}
@@ -0,0 +1,77 @@
+#version 460
+
+layout(local_size_x = 64) in;
+
+// Matches Application::DrawCommand
+struct Mesh
+{
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint textureIndex;
+    vec4 boundingSphere;
+};
+
+// Matches Application::ObjectData
+struct Object
+{
+    uint meshIndex;
+    uint transformIndex;
+};
+
+// Matches Application::IndirectDraw: a VkDrawIndexedIndirectCommand followed by the draw's material, which the
+// bindless vertex shader looks up through gl_DrawID
+struct IndirectDraw
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+    uint materialIndex;
+};
+
+layout(std430, binding = 0) readonly buffer MeshBuffer
+{
+    Mesh meshes[];
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer
+{
+    Object objects[];
+};
+
+// The draw count sits in front of the commands and is cleared before every dispatch
+layout(std430, binding = 2) buffer IndirectBuffer
+{
+    uint drawCount;
+    uint padding[3];
+    IndirectDraw commands[];
+};
+
+layout(push_constant) uniform Parameters
+{
+    uint objectCount;
+};
+
+void main()
+{
+    uint objectIndex = gl_GlobalInvocationID.x;
+    if (objectIndex >= objectCount)
+    {
+        return;
+    }
+
+    Object object = objects[objectIndex];
+    Mesh mesh = meshes[object.meshIndex];
+
+    uint drawIndex = atomicAdd(drawCount, 1);
+
+    // The first instance selects the object's transform through gl_InstanceIndex in the vertex shader
+    commands[drawIndex].indexCount = mesh.indexCount;
+    commands[drawIndex].instanceCount = 1;
+    commands[drawIndex].firstIndex = mesh.firstIndex;
+    commands[drawIndex].vertexOffset = mesh.vertexOffset;
+    commands[drawIndex].firstInstance = object.transformIndex;
+    commands[drawIndex].materialIndex = mesh.textureIndex;
+}
@@ -1,13 +1,31 @@
 #version 460
+#extension GL_GOOGLE_include_directive : require
+
+#include "clustered_lighting.glsl"
 
 layout(binding = 1) uniform sampler2D textureSampler;
 
+// Matches the texel test in Application::createTextureImage
+#define ALPHA_CUTOFF 0.5
+
+// Only on for materials with cut-out texels, as a discard keeps many GPUs from testing depth before shading
+layout(constant_id = 1) const bool ALPHA_TEST = false;
+
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoords;
+layout(location = 3) in vec3 fragPosition;
+layout(location = 4) in vec3 fragNormal;
 
 layout(location = 0) out vec4 outColor;
 
 void main() 
 {
-    outColor = vec4(fragColor * texture(textureSampler, fragTexCoords).rgb, 1.0);
+    vec4 albedo = texture(textureSampler, fragTexCoords);
+    if (ALPHA_TEST && albedo.a < ALPHA_CUTOFF)
+    {
+        discard;
+    }
+
+    vec3 lighting = computeLighting(fragPosition, normalize(fragNormal), gl_FragCoord.xy);
+    outColor = vec4(fragColor * albedo.rgb * lighting, 1.0);
 }
\ No newline at end of file
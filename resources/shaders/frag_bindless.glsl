@@ -0,0 +1,37 @@
+#version 460
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_GOOGLE_include_directive : require
+
+#include "clustered_lighting.glsl"
+
+// Matches Application::BINDLESS_SAMPLER_COUNT
+layout(set = 1, binding = 0) uniform sampler samplers[1];
+// Partially bound: only the first textures.size() entries are written
+layout(set = 1, binding = 1) uniform texture2D textures[];
+
+// Matches the texel test in Application::createTextureImage
+#define ALPHA_CUTOFF 0.5
+
+// Only on for materials with cut-out texels, as a discard keeps many GPUs from testing depth before shading
+layout(constant_id = 1) const bool ALPHA_TEST = false;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoords;
+layout(location = 2) flat in uint fragMaterialIndex;
+layout(location = 3) in vec3 fragPosition;
+layout(location = 4) in vec3 fragNormal;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    // Draws of one multi-draw indirect call can share a subgroup, so the index may differ between invocations
+    vec4 albedo = texture(sampler2D(textures[nonuniformEXT(fragMaterialIndex)], samplers[0]), fragTexCoords);
+    if (ALPHA_TEST && albedo.a < ALPHA_CUTOFF)
+    {
+        discard;
+    }
+
+    vec3 lighting = computeLighting(fragPosition, normalize(fragNormal), gl_FragCoord.xy);
+    outColor = vec4(fragColor * albedo.rgb * lighting, 1.0);
+}
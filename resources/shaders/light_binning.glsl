@@ -0,0 +1,131 @@
+#version 460
+
+// One invocation per light. A light finds the tiles and slices its sphere can reach, tests the sphere against the
+// view-space bounds of each of those clusters and appends itself to the ones it touches, so the work follows the
+// clusters the lights cover instead of every cluster visiting every light
+
+layout(local_size_x = 64) in;
+
+// Match Application::CLUSTER_GRID_X/Y/Z and Application::MAX_LIGHTS_PER_CLUSTER
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define CLUSTER_COUNT (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+#define MAX_LIGHTS_PER_CLUSTER 256
+
+layout(binding = 0) uniform UniformBufferObject
+{
+    mat4 view;
+    mat4 projection;
+    uint lightCount;
+    vec2 viewportSize;
+    vec2 depthRange;
+}ubo;
+
+// Matches Application::PointLight, in world space
+struct PointLight
+{
+    vec3 position;
+    float radius;
+    vec3 color;
+    float intensity;
+};
+
+layout(std430, binding = 1) readonly buffer LightBuffer
+{
+    PointLight lights[];
+};
+
+layout(std430, binding = 2) buffer ClusterBuffer
+{
+    uint clusterLightCounts[CLUSTER_COUNT];
+    uint clusterLightIndices[];
+};
+
+// A view-space point at depth d on the ray through an NDC position p lies at p * d / (P00, P11). The cluster's box
+// encloses its four corner rays between the two slice depths
+void getClusterBounds(uvec2 tile, float sliceNear, float sliceFar, out vec3 boundsMin, out vec3 boundsMax)
+{
+    vec2 projectionScale = vec2(ubo.projection[0][0], ubo.projection[1][1]);
+    vec2 tileStart = vec2(tile) / vec2(CLUSTER_X, CLUSTER_Y) * 2.0 - 1.0;
+    vec2 tileEnd = vec2(tile + 1) / vec2(CLUSTER_X, CLUSTER_Y) * 2.0 - 1.0;
+    vec2 rayMin = min(tileStart / projectionScale, tileEnd / projectionScale);
+    vec2 rayMax = max(tileStart / projectionScale, tileEnd / projectionScale);
+
+    boundsMin = vec3(min(rayMin * sliceNear, rayMin * sliceFar), -sliceFar);
+    boundsMax = vec3(max(rayMax * sliceNear, rayMax * sliceFar), -sliceNear);
+}
+
+void main()
+{
+    uint lightIndex = gl_GlobalInvocationID.x;
+    if (lightIndex >= ubo.lightCount)
+    {
+        return;
+    }
+
+    PointLight light = lights[lightIndex];
+    vec3 center = (ubo.view * vec4(light.position, 1.0)).xyz;
+    float radiusSquared = light.radius * light.radius;
+
+    float near = ubo.depthRange.x;
+    float far = ubo.depthRange.y;
+    float depthNear = -center.z - light.radius;
+    float depthFar = -center.z + light.radius;
+    if (depthFar < near || depthNear > far)
+    {
+        return;
+    }
+
+    // Slice depths grow exponentially from the near to the far plane, as in getClusterIndex
+    float sliceScale = CLUSTER_Z / log(far / near);
+    uint firstSlice = uint(clamp(log(max(depthNear, near) / near) * sliceScale, 0.0, CLUSTER_Z - 1.0));
+    uint lastSlice = uint(clamp(log(min(depthFar, far) / near) * sliceScale, 0.0, CLUSTER_Z - 1.0));
+
+    // The sphere's bounding box projects inside the NDC range of its sides at its nearest and farthest depth. A
+    // sphere reaching the camera plane may cover any tile
+    uvec2 firstTile = uvec2(0);
+    uvec2 lastTile = uvec2(CLUSTER_X - 1, CLUSTER_Y - 1);
+    if (depthNear > 0.0)
+    {
+        vec2 projectionScale = vec2(ubo.projection[0][0], ubo.projection[1][1]);
+        vec2 low = (center.xy - light.radius) * projectionScale;
+        vec2 high = (center.xy + light.radius) * projectionScale;
+        vec2 ndcMin = min(min(low / depthNear, low / depthFar), min(high / depthNear, high / depthFar));
+        vec2 ndcMax = max(max(low / depthNear, low / depthFar), max(high / depthNear, high / depthFar));
+
+        vec2 grid = vec2(CLUSTER_X, CLUSTER_Y);
+        firstTile = uvec2(clamp((ndcMin * 0.5 + 0.5) * grid, vec2(0.0), grid - 1.0));
+        lastTile = uvec2(clamp((ndcMax * 0.5 + 0.5) * grid, vec2(0.0), grid - 1.0));
+    }
+
+    for (uint slice = firstSlice; slice <= lastSlice; slice++)
+    {
+        float sliceNear = near * pow(far / near, float(slice) / CLUSTER_Z);
+        float sliceFar = near * pow(far / near, float(slice + 1) / CLUSTER_Z);
+
+        for (uint y = firstTile.y; y <= lastTile.y; y++)
+        {
+            for (uint x = firstTile.x; x <= lastTile.x; x++)
+            {
+                vec3 boundsMin;
+                vec3 boundsMax;
+                getClusterBounds(uvec2(x, y), sliceNear, sliceFar, boundsMin, boundsMax);
+
+                vec3 offset = center - clamp(center, boundsMin, boundsMax);
+                if (dot(offset, offset) > radiusSquared)
+                {
+                    continue;
+                }
+
+                // Lights past the cluster's slots are dropped; the lighting shaders clamp the count
+                uint cluster = (slice * CLUSTER_Y + y) * CLUSTER_X + x;
+                uint slot = atomicAdd(clusterLightCounts[cluster], 1);
+                if (slot < MAX_LIGHTS_PER_CLUSTER)
+                {
+                    clusterLightIndices[cluster * MAX_LIGHTS_PER_CLUSTER + slot] = lightIndex;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,193 @@
+#version 460
+
+layout(local_size_x = 64) in;
+
+// Matches Application::DrawCommand
+struct Mesh
+{
+    uint indexCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint textureIndex;
+    vec4 boundingSphere;
+};
+
+// Matches Application::ObjectData
+struct Object
+{
+    uint meshIndex;
+    uint transformIndex;
+};
+
+// Matches Application::IndirectDraw: a VkDrawIndexedIndirectCommand followed by the draw's material, which the
+// bindless vertex shader looks up through gl_DrawID
+struct IndirectDraw
+{
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+    uint materialIndex;
+};
+
+layout(std430, binding = 0) readonly buffer MeshBuffer
+{
+    Mesh meshes[];
+};
+
+// The frame's frustum-visible objects
+layout(std430, binding = 1) readonly buffer ObjectBuffer
+{
+    Object objects[];
+};
+
+// The draw count sits in front of the commands and is cleared before each phase
+layout(std430, binding = 2) buffer IndirectBuffer
+{
+    uint drawCount;
+    uint indirectPadding[3];
+    IndirectDraw commands[];
+};
+
+layout(binding = 3) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+};
+
+layout(std430, binding = 4) readonly buffer InstanceBuffer
+{
+    mat4 models[];
+};
+
+// Farthest depth of the previous frame in the early phase and of the early pass in the late phase
+layout(binding = 5) uniform sampler2D depthPyramid;
+
+// Objects rejected by the early phase, tested again by the late phase
+layout(std430, binding = 6) buffer OcclusionBuffer
+{
+    uint retestCount;
+    uint lateVisibleCount;
+    uint occlusionPadding[2];
+    uint retestObjects[];
+};
+
+layout(push_constant) uniform Parameters
+{
+    uint objectCount;
+    uint latePhase;
+    uint occlusionTest;
+};
+
+// Conservative test of a sphere against the pyramid: the sphere's world-space box is projected, and the sphere is
+// occluded when the nearest depth of the box lies behind the farthest depth stored for every texel it covers
+bool isOccluded(vec3 center, float radius)
+{
+    mat4 viewProjection = projection * view;
+
+    vec2 uvMin = vec2(1.0);
+    vec2 uvMax = vec2(0.0);
+    float nearestDepth = 1.0;
+
+    for (int corner = 0; corner < 8; corner++)
+    {
+        vec3 offset = vec3((corner & 1) != 0 ? radius : -radius,
+                           (corner & 2) != 0 ? radius : -radius,
+                           (corner & 4) != 0 ? radius : -radius);
+        vec4 clip = viewProjection * vec4(center + offset, 1.0);
+
+        // Crossing the near plane projects badly; such objects are close enough to draw anyway
+        if (clip.w <= 0.0 || clip.z < 0.0)
+        {
+            return false;
+        }
+
+        vec3 ndc = clip.xyz / clip.w;
+        vec2 uv = ndc.xy * 0.5 + 0.5;
+        uvMin = min(uvMin, uv);
+        uvMax = max(uvMax, uv);
+        nearestDepth = min(nearestDepth, ndc.z);
+    }
+
+    uvMin = clamp(uvMin, vec2(0.0), vec2(1.0));
+    uvMax = clamp(uvMax, vec2(0.0), vec2(1.0));
+
+    // The level at which the box spans at most one texel, so at most 2x2 texels cover it
+    vec2 pyramidSize = vec2(textureSize(depthPyramid, 0));
+    vec2 extent = (uvMax - uvMin) * pyramidSize;
+    int levelCount = textureQueryLevels(depthPyramid);
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, levelCount - 1);
+
+    ivec2 levelSize = textureSize(depthPyramid, level);
+    ivec2 texelMin = clamp(ivec2(uvMin * vec2(levelSize)), ivec2(0), levelSize - 1);
+    ivec2 texelMax = clamp(ivec2(uvMax * vec2(levelSize)), ivec2(0), levelSize - 1);
+
+    float farthestDepth = 0.0;
+    for (int y = texelMin.y; y <= texelMax.y; y++)
+    {
+        for (int x = texelMin.x; x <= texelMax.x; x++)
+        {
+            farthestDepth = max(farthestDepth, texelFetch(depthPyramid, ivec2(x, y), level).r);
+        }
+    }
+
+    return nearestDepth > farthestDepth;
+}
+
+void emitDraw(Object object, Mesh mesh)
+{
+    uint drawIndex = atomicAdd(drawCount, 1);
+
+    commands[drawIndex].indexCount = mesh.indexCount;
+    commands[drawIndex].instanceCount = 1;
+    commands[drawIndex].firstIndex = mesh.firstIndex;
+    commands[drawIndex].vertexOffset = mesh.vertexOffset;
+    commands[drawIndex].firstInstance = object.transformIndex;
+    commands[drawIndex].materialIndex = mesh.textureIndex;
+}
+
+void main()
+{
+    uint index = gl_GlobalInvocationID.x;
+
+    uint objectIndex;
+    if (latePhase != 0)
+    {
+        if (index >= retestCount)
+        {
+            return;
+        }
+        objectIndex = retestObjects[index];
+    }
+    else
+    {
+        if (index >= objectCount)
+        {
+            return;
+        }
+        objectIndex = index;
+    }
+
+    Object object = objects[objectIndex];
+    Mesh mesh = meshes[object.meshIndex];
+
+    // Instance scales are uniform, so the radius scales with the length of any axis
+    mat4 model = models[object.transformIndex];
+    vec3 center = (model * vec4(mesh.boundingSphere.xyz, 1.0)).xyz;
+    bool occluded = occlusionTest != 0 && isOccluded(center, mesh.boundingSphere.w * length(model[0].xyz));
+
+    if (!occluded)
+    {
+        emitDraw(object, mesh);
+
+        if (latePhase != 0)
+        {
+            atomicAdd(lateVisibleCount, 1);
+        }
+    }
+    else if (latePhase == 0)
+    {
+        retestObjects[atomicAdd(retestCount, 1)] = objectIndex;
+    }
+}
@@ -1,22 +1,60 @@
 #version 460
+#extension GL_EXT_multiview : require
+
+// Matches Application::MAX_VIEWS
+#define MAX_VIEWS 4
 
 layout(binding = 0) uniform UniformBufferObject
 {
-    mat4 model;
     mat4 view;
     mat4 projection;
+    uint lightCount;
+    vec2 viewportSize;
+    vec2 depthRange;
+    // One camera per view of a multiview pass; without multiview gl_ViewIndex is 0
+    mat4 viewProjections[MAX_VIEWS];
 }ubo;
 
+// Streamed every frame, one transform per instance
+layout(std430, binding = 2) readonly buffer InstanceBuffer
+{
+    mat4 models[];
+}instances;
+
+// Matches Application::DrawParameters. Instanced draws start at transformBase; GPU-driven draws push 0 and select
+// their transform through firstInstance
+layout(push_constant) uniform DrawParameters
+{
+    uint transformBase;
+    uint materialIndex;
+}draw;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoords;
+layout(location = 3) in vec3 inNormal;
+
+// Off for meshes whose vertex colors are all white
+layout(constant_id = 0) const bool VERTEX_COLORS = true;
+
+// Must match the depth pre-pass bit for bit, as the shading pass then tests depth for equality
+invariant gl_Position;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoords;
+// World space, for lighting
+layout(location = 3) out vec3 fragPosition;
+layout(location = 4) out vec3 fragNormal;
 
 void main() 
 {
-    gl_Position = ubo.projection * ubo.view * ubo.model * vec4(inPosition, 1.0);
-    fragColor = inColor;
+    mat4 model = instances.models[draw.transformBase + gl_InstanceIndex];
+    vec4 position = model * vec4(inPosition, 1.0);
+
+    gl_Position = ubo.viewProjections[gl_ViewIndex] * position;
+    fragPosition = position.xyz;
+    // Instance scales are uniform, so the model matrix transforms normals too
+    fragNormal = mat3(model) * inNormal;
+    fragColor = VERTEX_COLORS ? inColor : vec3(1.0);
     fragTexCoords = inTexCoords;
 }
\ No newline at end of file
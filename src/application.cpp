@@ -1,5 +1,7 @@
 #include "application.hpp"
 
+Application::Application(const Settings &settings) : maxFramesInFlight(settings.framesInFlight), settings(settings) {}
+
 void Application::Run() {
     init();
     update();
@@ -7,6 +9,8 @@ void Application::Run() {
 }
 
 void Application::init() {
+    threadPool = std::make_unique<ThreadPool>(settings.workerThreads);
+
     initWindow();
     initVulkan();
 }
@@ -18,6 +22,12 @@ void Application::initWindow() {
     window = glfwCreateWindow(800, 600, "GLFW Vulkan Example", nullptr, nullptr);
     glfwSetWindowUserPointer(window, this);
     glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+
+    if (settings.frameStatistics) {
+        glfwSetKeyCallback(window, keyCallback);
+        glfwSetMouseButtonCallback(window, mouseButtonCallback);
+        glfwSetCursorPosCallback(window, cursorPositionCallback);
+    }
 }
 
 void Application::initVulkan() {
@@ -26,32 +36,129 @@ void Application::initVulkan() {
     createSurface();
     pickPhysicalDevice();
     createLogicalDevice();
+    createTimelineSemaphore();
     createSwapChain();
     createImageViews();
-    createRenderPass();
+    createPresentSemaphores();
+    if (!dynamicRenderingEnabled) {
+        createRenderPass();
+    }
     createDescriptorSetLayout();
     createGraphicsPipeline();
+    createLightBinningPipeline();
+    if (gpuDrivenEnabled) {
+        createDrawCommandPipeline();
+    }
+    if (occlusionCullingEnabled) {
+        createOcclusionCullingPipelines();
+    } else {
+        createFrameQueries();
+    }
     createCommandPool();
+    createFrameCommandPools();
     createColorResources();
     createDepthResources();
-    createFramebuffers();
-    createTextureImage(TEXTURE_PATH.c_str());
+    if (dynamicResolutionEnabled || multiviewEnabled) {
+        createSceneImage();
+    }
+    if (occlusionCullingEnabled) {
+        createDepthPyramid();
+    }
+    if (!dynamicRenderingEnabled) {
+        createFramebuffers();
+    }
+    loadScene();
     createTextureImageView();
     createTextureSampler();
-    loadModel(MODEL_PATH.c_str());
     createVertexBuffer();
     createIndexBuffer();
     createUniformBuffers();
+    createInstanceBuffers();
+    createLightBuffers();
+    if (gpuDrivenEnabled) {
+        createMeshBuffer();
+        createDrawCommandBuffers();
+    }
+    if (occlusionCullingEnabled) {
+        createOcclusionBuffers();
+    }
     createDescriptorPool();
     createDescriptorSets();
     createCommandBuffers();
+    createCachedCommandBuffers();
     createSyncObjects();
 }
 
 void Application::update() {
+    if (settings.benchmark == "instances") {
+        benchmark = std::make_unique<Benchmark>(
+                "instances", std::vector<uint64_t>{1, 10, 100, 1000, 10000, 100000, 1000000});
+    } else if (settings.benchmark == "draws") {
+        benchmark = std::make_unique<Benchmark>(
+                "draws", std::vector<uint64_t>{1, 10, 100, 1000, 10000, 100000});
+    } else if (settings.benchmark == "occlusion") {
+        // Occlusion test off, then on: the difference in GPU time is the time the test saves. Without the culling
+        // passes the test is never recorded and both steps would measure the same frame
+        if (occlusionCullingEnabled) {
+            benchmark = std::make_unique<Benchmark>("occlusion", std::vector<uint64_t>{0, 1});
+        } else {
+            std::cerr << "Occlusion benchmark unavailable: occlusion culling needs the GPU-driven path with draw "
+                         "indirect count support and dynamic rendering" << std::endl;
+        }
+    } else if (settings.benchmark == "prepass") {
+        // Depth pre-pass off, then on: the pre-pass pays for itself when the shading it saves outweighs its cost
+        benchmark = std::make_unique<Benchmark>("prepass", std::vector<uint64_t>{0, 1});
+    } else if (settings.benchmark == "lights") {
+        benchmark = std::make_unique<Benchmark>("lights", std::vector<uint64_t>{10, 100, 1000, 10000});
+    }
+
+    if (benchmark) {
+        applyBenchmarkStep();
+    }
+
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
         drawFrame();
+
+        if (benchmark) {
+            if (benchmark->recordFrame(Benchmark::Clock::now(), frameCpuTime, frameGpuTime)) {
+                applyBenchmarkStep();
+            }
+
+            if (benchmark->isFinished()) {
+                std::cout << benchmark->buildReport();
+                glfwSetWindowShouldClose(window, GLFW_TRUE);
+            }
+        }
+
+        if (settings.frameStatistics && frameStatistics.isReportDue(FrameStatistics::Clock::now())) {
+            std::cout << frameStatistics.buildReport(FrameStatistics::Clock::now()) << std::endl;
+
+            if (settings.framePacing) {
+                std::cout << framePacer.buildReport() << std::endl;
+            }
+
+            std::cout << memoryBudget.buildReport() << std::endl;
+            std::cout << buildTransientAttachmentReport() << std::endl;
+            std::cout << frustumCuller.buildReport() << std::endl;
+            std::cout << transformHierarchy.buildReport() << std::endl;
+
+            if (!gpuDrivenEnabled) {
+                std::cout << drawSorter.buildReport() << std::endl;
+            }
+
+            if (occlusionCullingEnabled) {
+                std::cout << buildOcclusionReport() << std::endl;
+                std::cout << gpuTimer.buildReport() << std::endl;
+            } else {
+                std::cout << gpuTimer.buildReport() << std::endl;
+                std::cout << fragmentCounter.buildReport() << std::endl;
+            }
+
+            if (dynamicResolutionEnabled) {
+                std::cout << resolutionController.buildReport(static_cast<uint32_t>(msaaSamples)) << std::endl;
+            }
+        }
     }
 
     logicalDevice.waitIdle();
@@ -61,34 +168,111 @@ void Application::shutdown() {
     cleanupSwapChain();
 
     logicalDevice.destroySampler(textureSampler);
-    logicalDevice.destroyImageView(textureImageView);
 
-    logicalDevice.destroyImage(textureImage);
-    logicalDevice.freeMemory(textureImageMemory);
+    for (const auto &texture: textures) {
+        logicalDevice.destroyImageView(texture.view);
+
+        imageLayoutTracker.unregisterImage(texture.image);
+        logicalDevice.destroyImage(texture.image);
+        freeDeviceMemory(texture.memory);
+    }
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < maxFramesInFlight; i++) {
         logicalDevice.destroyBuffer(uniformBuffers[i]);
-        logicalDevice.freeMemory(uniformBuffersMemory[i]);
+        freeDeviceMemory(uniformBuffersMemory[i]);
+
+        logicalDevice.destroyBuffer(instanceBuffers[i]);
+        freeDeviceMemory(instanceBuffersMemory[i]);
+    }
+
+    if (gpuDrivenEnabled) {
+        for (size_t i = 0; i < maxFramesInFlight; i++) {
+            logicalDevice.destroyBuffer(objectBuffers[i]);
+            freeDeviceMemory(objectBuffersMemory[i]);
+            logicalDevice.destroyBuffer(indirectBuffers[i]);
+            freeDeviceMemory(indirectBuffersMemory[i]);
+        }
+
+        logicalDevice.destroyBuffer(meshBuffer);
+        freeDeviceMemory(meshBufferMemory);
+
+        if (occlusionCullingEnabled) {
+            for (size_t i = 0; i < maxFramesInFlight; i++) {
+                logicalDevice.destroyBuffer(occlusionBuffers[i]);
+                freeDeviceMemory(occlusionBuffersMemory[i]);
+                logicalDevice.destroyBuffer(occlusionStatisticsBuffers[i]);
+                freeDeviceMemory(occlusionStatisticsBuffersMemory[i]);
+            }
+
+            logicalDevice.destroySampler(depthPyramidSampler);
+            logicalDevice.destroyPipeline(depthPyramidMultisamplePipeline);
+            logicalDevice.destroyPipeline(depthPyramidPipeline);
+            logicalDevice.destroyPipelineLayout(depthPyramidPipelineLayout);
+            logicalDevice.destroyDescriptorSetLayout(depthPyramidSetLayout);
+
+            logicalDevice.destroyPipeline(occlusionCullPipeline);
+            logicalDevice.destroyPipelineLayout(occlusionCullPipelineLayout);
+            logicalDevice.destroyDescriptorSetLayout(occlusionCullSetLayout);
+        }
+
+        logicalDevice.destroyPipeline(drawCommandPipeline);
+        logicalDevice.destroyPipelineLayout(drawCommandPipelineLayout);
+        logicalDevice.destroyDescriptorSetLayout(drawCommandSetLayout);
+    }
+
+    for (size_t i = 0; i < maxFramesInFlight; i++) {
+        logicalDevice.destroyBuffer(clusterBuffers[i]);
+        freeDeviceMemory(clusterBuffersMemory[i]);
     }
 
+    logicalDevice.destroyBuffer(lightBuffer);
+    freeDeviceMemory(lightBufferMemory);
+
+    logicalDevice.destroyPipeline(lightBinningPipeline);
+    logicalDevice.destroyPipelineLayout(lightBinningPipelineLayout);
+    logicalDevice.destroyDescriptorSetLayout(lightBinningSetLayout);
+
     logicalDevice.destroyDescriptorPool(descriptorPool);
     logicalDevice.destroyDescriptorSetLayout(descriptorSetLayout);
 
+    if (bindlessEnabled) {
+        logicalDevice.destroyDescriptorPool(bindlessDescriptorPool);
+        logicalDevice.destroyDescriptorSetLayout(bindlessSetLayout);
+    }
+
     logicalDevice.destroyBuffer(indexBuffer);
-    logicalDevice.freeMemory(indexBufferMemory);
+    freeDeviceMemory(indexBufferMemory);
 
     logicalDevice.destroyBuffer(vertexBuffer);
-    logicalDevice.freeMemory(vertexBufferMemory);
+    freeDeviceMemory(vertexBufferMemory);
+
+    gpuTimer.destroy(logicalDevice);
+    fragmentCounter.destroy(logicalDevice);
 
-    logicalDevice.destroyPipeline(graphicsPipeline);
+    logicalDevice.destroyPipeline(depthPrepassPipeline);
+    for (auto &[permutation, pipeline]: graphicsPipelines) {
+        logicalDevice.destroyPipeline(pipeline);
+    }
     logicalDevice.destroyPipelineLayout(pipelineLayout);
 
     logicalDevice.destroyRenderPass(renderPass);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < maxFramesInFlight; i++) {
         logicalDevice.destroySemaphore(imageAvailableSemaphores[i]);
-        logicalDevice.destroySemaphore(renderFinishedSemaphores[i]);
-        logicalDevice.destroyFence(inFlightFences[i]);
+    }
+
+    logicalDevice.destroySemaphore(timelineSemaphore);
+
+    for (const auto &pools: frameCommandPools) {
+        logicalDevice.destroyCommandPool(pools.primaryPool);
+
+        for (auto pool: pools.threadPools) {
+            logicalDevice.destroyCommandPool(pool);
+        }
+    }
+
+    if (cachedCommandPool) {
+        logicalDevice.destroyCommandPool(cachedCommandPool);
     }
 
     logicalDevice.destroyCommandPool(commandPool);
@@ -355,6 +539,29 @@ bool Application::checkDeviceExtensionSupport(vk::PhysicalDevice device) {
     return requiredDeviceExtensions.empty();
 }
 
+bool Application::isDeviceExtensionAvailable(vk::PhysicalDevice device, const char *extensionName) {
+    uint32_t deviceExtensionCount;
+    vk::Result result = device.enumerateDeviceExtensionProperties(nullptr, &deviceExtensionCount, nullptr);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to enumerate device extensions! Error Code: " + vk::to_string(result));
+    }
+
+    std::vector<vk::ExtensionProperties> availableDeviceExtensions(deviceExtensionCount);
+    result = device.enumerateDeviceExtensionProperties(nullptr, &deviceExtensionCount,
+                                                       availableDeviceExtensions.data());
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to enumerate device extensions! Error Code: " + vk::to_string(result));
+    }
+
+    for (const auto &deviceExtension: availableDeviceExtensions) {
+        if (strcmp(deviceExtension.extensionName, extensionName) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 Application::SwapChainSupportDetails Application::querySwapChainSupport(vk::PhysicalDevice device) {
     SwapChainSupportDetails details;
     vk::Result result = device.getSurfaceCapabilitiesKHR(surface, &details.capabilities);
@@ -411,7 +618,24 @@ bool Application::isDeviceSuitable(vk::PhysicalDevice device) {
 
     vk::PhysicalDeviceFeatures supportedFeatures = device.getFeatures();
 
-    return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+    // Vulkan 1.3 is required: frame and upload synchronisation is built on timeline semaphores and image barriers on
+    // synchronization2, and rendering defaults to dynamic rendering. All three are mandatory features of 1.3
+    bool synchronizationSupported = false;
+    if (device.getProperties().apiVersion >= VK_API_VERSION_1_3) {
+        vk::PhysicalDeviceVulkan13Features supportedVulkan13Features;
+        vk::PhysicalDeviceVulkan12Features supportedVulkan12Features = vk::PhysicalDeviceVulkan12Features()
+                .setPNext(&supportedVulkan13Features);
+        vk::PhysicalDeviceFeatures2 supportedFeatures2 = vk::PhysicalDeviceFeatures2()
+                .setPNext(&supportedVulkan12Features);
+        device.getFeatures2(&supportedFeatures2);
+
+        synchronizationSupported = supportedVulkan12Features.timelineSemaphore &&
+                                   supportedVulkan13Features.synchronization2 &&
+                                   supportedVulkan13Features.dynamicRendering;
+    }
+
+    return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy &&
+           synchronizationSupported;
 }
 
 Application::QueueFamilyIndices Application::findQueueFamilies(vk::PhysicalDevice device) {
@@ -470,12 +694,120 @@ void Application::createLogicalDevice() {
     physicalDeviceFeatures.samplerAnisotropy = vk::True;
     physicalDeviceFeatures.sampleRateShading = vk::True;
 
+    // The GPU-driven path draws one indirect command per object, each selecting its transform through firstInstance,
+    // with the count written by the GPU
+    if (settings.gpuDriven) {
+        vk::PhysicalDeviceVulkan12Features supportedVulkan12Features;
+        vk::PhysicalDeviceFeatures2 supportedFeatures2 = vk::PhysicalDeviceFeatures2()
+                .setPNext(&supportedVulkan12Features);
+        physicalDevice.getFeatures2(&supportedFeatures2);
+
+        if (supportedFeatures2.features.multiDrawIndirect && supportedFeatures2.features.drawIndirectFirstInstance &&
+            supportedVulkan12Features.drawIndirectCount) {
+            physicalDeviceFeatures.multiDrawIndirect = vk::True;
+            physicalDeviceFeatures.drawIndirectFirstInstance = vk::True;
+            physicalDeviceVulkan12Features.drawIndirectCount = vk::True;
+            gpuDrivenEnabled = true;
+        }
+    }
+
+    physicalDeviceVulkan12Features.timelineSemaphore = vk::True;
+    physicalDeviceVulkan13Features.synchronization2 = vk::True;
+    // Required since Vulkan 1.1. The scene vertex shaders select their camera through gl_ViewIndex, which is 0 when
+    // a pass renders without a view mask
+    physicalDeviceVulkan11Features.multiview = vk::True;
+
+    // Fragment shader invocations are counted for the frame statistics
+    if (settings.frameStatistics && physicalDevice.getFeatures().pipelineStatisticsQuery) {
+        physicalDeviceFeatures.pipelineStatisticsQuery = vk::True;
+        pipelineStatisticsEnabled = true;
+    }
+
+    // Every selected device supports dynamic rendering; the render pass path is only kept to compare against
+    if (settings.dynamicRendering) {
+        physicalDeviceVulkan13Features.dynamicRendering = vk::True;
+        dynamicRenderingEnabled = true;
+    }
+
+    // Bindless textures index a runtime-sized, partially bound array that is updated while command buffers that bind
+    // it are recorded. The GPU-driven path also reads each draw's material through gl_DrawID
+    if (settings.bindlessTextures) {
+        vk::PhysicalDeviceVulkan12Features supportedVulkan12Features;
+        vk::PhysicalDeviceVulkan11Features supportedVulkan11Features = vk::PhysicalDeviceVulkan11Features()
+                .setPNext(&supportedVulkan12Features);
+        vk::PhysicalDeviceFeatures2 supportedFeatures2 = vk::PhysicalDeviceFeatures2()
+                .setPNext(&supportedVulkan11Features);
+        physicalDevice.getFeatures2(&supportedFeatures2);
+
+        if (supportedVulkan12Features.runtimeDescriptorArray &&
+            supportedVulkan12Features.descriptorBindingPartiallyBound &&
+            supportedVulkan12Features.descriptorBindingSampledImageUpdateAfterBind &&
+            supportedVulkan12Features.shaderSampledImageArrayNonUniformIndexing &&
+            supportedVulkan11Features.shaderDrawParameters) {
+            physicalDeviceVulkan12Features.runtimeDescriptorArray = vk::True;
+            physicalDeviceVulkan12Features.descriptorBindingPartiallyBound = vk::True;
+            physicalDeviceVulkan12Features.descriptorBindingSampledImageUpdateAfterBind = vk::True;
+            physicalDeviceVulkan12Features.shaderSampledImageArrayNonUniformIndexing = vk::True;
+            physicalDeviceVulkan11Features.shaderDrawParameters = vk::True;
+
+            vk::PhysicalDeviceVulkan12Properties vulkan12Properties;
+            vk::PhysicalDeviceProperties2 properties2 = vk::PhysicalDeviceProperties2()
+                    .setPNext(&vulkan12Properties);
+            physicalDevice.getProperties2(&properties2);
+
+            bindlessTextureCapacity = std::min({MAX_BINDLESS_TEXTURES,
+                                                vulkan12Properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                                vulkan12Properties.maxDescriptorSetUpdateAfterBindSampledImages});
+            bindlessEnabled = true;
+        } else {
+            std::cerr << "Descriptor indexing unavailable: textures are bound through the per-frame descriptor sets"
+                      << std::endl;
+        }
+    }
+
+    enabledDeviceExtensions = logicalDeviceExtensions;
+
+    // Optional feature structures are prepended to this chain as they are enabled
+    void *featureChain = nullptr;
+
+    if (settings.framePacing &&
+        isDeviceExtensionAvailable(physicalDevice, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+        isDeviceExtensionAvailable(physicalDevice, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+        vk::PhysicalDevicePresentWaitFeaturesKHR supportedPresentWait;
+        vk::PhysicalDevicePresentIdFeaturesKHR supportedPresentId = vk::PhysicalDevicePresentIdFeaturesKHR()
+                .setPNext(&supportedPresentWait);
+        vk::PhysicalDeviceFeatures2 supportedFeatures2 = vk::PhysicalDeviceFeatures2()
+                .setPNext(&supportedPresentId);
+        physicalDevice.getFeatures2(&supportedFeatures2);
+
+        if (supportedPresentId.presentId && supportedPresentWait.presentWait) {
+            presentIdFeatures.setPresentId(vk::True).setPNext(featureChain);
+            presentWaitFeatures.setPresentWait(vk::True).setPNext(&presentIdFeatures);
+            featureChain = &presentWaitFeatures;
+
+            enabledDeviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+            enabledDeviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+            presentWaitEnabled = true;
+        }
+    }
+
+    // Real heap budgets and usage for the memory budget; without it both are estimated
+    if (isDeviceExtensionAvailable(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)) {
+        enabledDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        memoryBudgetExtensionEnabled = true;
+    }
+
+    physicalDeviceVulkan13Features.setPNext(featureChain);
+    physicalDeviceVulkan12Features.setPNext(&physicalDeviceVulkan13Features);
+    physicalDeviceVulkan11Features.setPNext(&physicalDeviceVulkan12Features);
+
     logicalDeviceCreateInfo = vk::DeviceCreateInfo()
+            .setPNext(&physicalDeviceVulkan11Features)
             .setPQueueCreateInfos(queueFamilyCreateInfos.data())
             .setQueueCreateInfoCount(queueFamilyCreateInfos.size())
             .setPEnabledFeatures(&physicalDeviceFeatures)
-            .setEnabledExtensionCount(logicalDeviceExtensions.size())
-            .setPpEnabledExtensionNames(logicalDeviceExtensions.data());
+            .setEnabledExtensionCount(enabledDeviceExtensions.size())
+            .setPpEnabledExtensionNames(enabledDeviceExtensions.data());
 
     if (enableValidationLayers) {
         logicalDeviceCreateInfo.setEnabledLayerCount(validationLayers.size());
@@ -491,6 +823,49 @@ void Application::createLogicalDevice() {
 
     logicalDevice.getQueue(indices.graphicsFamily.value(), 0, &graphicsQueue);
     logicalDevice.getQueue(indices.presentFamily.value(), 0, &presentQueue);
+
+    // The culling passes are compute dispatches between two dynamic rendering passes of the GPU-driven draw list
+    occlusionCullingEnabled = settings.occlusionCulling && gpuDrivenEnabled && dynamicRenderingEnabled;
+    depthPrepassEnabled = settings.depthPrepass && !occlusionCullingEnabled;
+    // The scaled area is resolved and blitted after the single rendering pass, which the two passes of occlusion
+    // culling and the render pass path don't have
+    dynamicResolutionEnabled = settings.dynamicResolution && dynamicRenderingEnabled && !occlusionCullingEnabled;
+    // The views are resolved into the layers of the scene image, which the same blit then lays out side by side
+    multiviewEnabled = settings.viewCount > 1 && dynamicRenderingEnabled && !occlusionCullingEnabled;
+    viewCount = multiviewEnabled ? settings.viewCount : 1;
+    if (settings.viewCount > 1 && !multiviewEnabled) {
+        std::cerr << "Multiview unavailable: it needs dynamic rendering without occlusion culling, rendering one view"
+                  << std::endl;
+    } else if (multiviewEnabled && settings.clusteredLighting && settings.lightCount > 0) {
+        std::cerr << "Clustered lighting unavailable with multiview: the clusters are binned for the central camera "
+                     "only, so every fragment loops over every light" << std::endl;
+    }
+    resolutionController.configure(settings.gpuFrameTargetMicroseconds / 1000.0,
+                                   static_cast<float>(settings.minimumResolutionScale) / 100.0f);
+
+    memoryBudget.initialize(physicalDevice, memoryBudgetExtensionEnabled,
+                            static_cast<vk::DeviceSize>(settings.memoryBudgetMiB) * 1024 * 1024);
+
+    if (presentWaitEnabled) {
+        waitForPresentKHR = (PFN_vkWaitForPresentKHR) vkGetDeviceProcAddr(logicalDevice, "vkWaitForPresentKHR");
+        presentWaitEnabled = waitForPresentKHR != nullptr;
+    }
+
+    if (settings.framePacing) {
+        GLFWmonitor *monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode *videoMode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+        if (videoMode && videoMode->refreshRate > 0) {
+            framePacer.setRefreshInterval(std::chrono::duration<double>(1.0 / videoMode->refreshRate));
+        }
+
+        if (!presentWaitEnabled) {
+            std::cerr << "VK_KHR_present_wait unavailable: frame pacing only reports CPU frame intervals" << std::endl;
+        }
+    }
+
+    // Only the paced loop waits for presents to reach the display. Otherwise frames are timed to the GPU finishing
+    // them, which is earlier than they are shown by up to the presentation queue's length
+    frameStatistics.setCompletionEvent(settings.framePacing && presentWaitEnabled ? "present" : "gpu-done");
 }
 
 void Application::createSurface() {
@@ -512,12 +887,34 @@ vk::SurfaceFormatKHR Application::chooseSwapSurfaceFormat(const std::vector<vk::
 }
 
 vk::PresentModeKHR Application::chooseSwapPresentMode(const std::vector<vk::PresentModeKHR> &availablePresentModes) {
-    for (const auto &availablePresentMode: availablePresentModes) {
-        if (availablePresentMode == vk::PresentModeKHR::eMailbox) {
-            return availablePresentMode;
+    if (settings.presentMode == "auto") {
+        for (const auto &availablePresentMode: availablePresentModes) {
+            if (availablePresentMode == vk::PresentModeKHR::eMailbox) {
+                return availablePresentMode;
+            }
         }
+
+        return vk::PresentModeKHR::eFifo;
+    }
+
+    vk::PresentModeKHR requestedPresentMode = vk::PresentModeKHR::eFifo;
+    if (settings.presentMode == "fifo-relaxed") {
+        requestedPresentMode = vk::PresentModeKHR::eFifoRelaxed;
+    } else if (settings.presentMode == "mailbox") {
+        requestedPresentMode = vk::PresentModeKHR::eMailbox;
+    } else if (settings.presentMode == "immediate") {
+        requestedPresentMode = vk::PresentModeKHR::eImmediate;
+    }
+
+    if (std::find(availablePresentModes.begin(), availablePresentModes.end(), requestedPresentMode) !=
+        availablePresentModes.end()) {
+        return requestedPresentMode;
     }
 
+    // FIFO is the only mode every surface is required to support
+    std::cerr << "Present mode " << vk::to_string(requestedPresentMode) << " unsupported, falling back to FIFO"
+              << std::endl;
+
     return vk::PresentModeKHR::eFifo;
 }
 
@@ -540,18 +937,40 @@ vk::Extent2D Application::chooseSwapExtent(const vk::SurfaceCapabilitiesKHR &cap
     }
 }
 
-void Application::createSwapChain() {
+void Application::createSwapChain(vk::SwapchainKHR oldSwapChain) {
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
     vk::SurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
     vk::PresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
     vk::Extent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-    uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+    uint32_t imageCount = settings.swapchainImageCount != 0 ? settings.swapchainImageCount
+                                                            : swapChainSupport.capabilities.minImageCount + 1;
+    imageCount = std::max(imageCount, swapChainSupport.capabilities.minImageCount);
     if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
         imageCount = swapChainSupport.capabilities.maxImageCount;
     }
 
+    // Dynamic resolution upscales into the swapchain images with a linear blit, and multiview blits its views into
+    // them side by side. Surface formats don't change with the window size, so this decides once at startup
+    vk::ImageUsageFlags imageUsage = vk::ImageUsageFlagBits::eColorAttachment;
+    if (dynamicResolutionEnabled || multiviewEnabled) {
+        vk::FormatFeatureFlags blitFeatures = vk::FormatFeatureFlagBits::eBlitSrc |
+                                              vk::FormatFeatureFlagBits::eBlitDst |
+                                              vk::FormatFeatureFlagBits::eSampledImageFilterLinear;
+        vk::FormatProperties formatProperties = physicalDevice.getFormatProperties(surfaceFormat.format);
+
+        if ((swapChainSupport.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst) &&
+            (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures) {
+            imageUsage |= vk::ImageUsageFlagBits::eTransferDst;
+        } else {
+            std::cerr << "Swapchain images can't be blitted to: rendering one view at full resolution" << std::endl;
+            dynamicResolutionEnabled = false;
+            multiviewEnabled = false;
+            viewCount = 1;
+        }
+    }
+
     vk::SwapchainCreateInfoKHR swapChainCreateInfo = vk::SwapchainCreateInfoKHR()
             .setSurface(surface)
             .setMinImageCount(imageCount)
@@ -559,12 +978,12 @@ void Application::createSwapChain() {
             .setImageColorSpace(surfaceFormat.colorSpace)
             .setImageExtent(extent)
             .setImageArrayLayers(1)
-            .setImageUsage(vk::ImageUsageFlagBits::eColorAttachment)
+            .setImageUsage(imageUsage)
             .setPreTransform(swapChainSupport.capabilities.currentTransform)
             .setCompositeAlpha(vk::CompositeAlphaFlagBitsKHR::eOpaque)
             .setPresentMode(presentMode)
             .setClipped(VK_TRUE)
-            .setOldSwapchain(VK_NULL_HANDLE);
+            .setOldSwapchain(oldSwapChain);
 
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
     uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(), indices.presentFamily.value()};
@@ -580,6 +999,9 @@ void Application::createSwapChain() {
     }
 
     vk::Result result = logicalDevice.createSwapchainKHR(&swapChainCreateInfo, nullptr, &swapChain);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create swap chain! Error Code: " + vk::to_string(result));
+    }
 
     result = logicalDevice.getSwapchainImagesKHR(swapChain, &imageCount, nullptr);
     if (result != vk::Result::eSuccess) {
@@ -595,6 +1017,11 @@ void Application::createSwapChain() {
 
     swapChainImageFormat = surfaceFormat.format;
     swapChainExtent = extent;
+    updateRenderExtent();
+
+    frameStatistics.setConfiguration("frames-in-flight=" + std::to_string(maxFramesInFlight) +
+                                     " swapchain-images=" + std::to_string(swapChainImages.size()) +
+                                     " present-mode=" + vk::to_string(presentMode));
 }
 
 void Application::createImageViews() {
@@ -606,29 +1033,92 @@ void Application::createImageViews() {
 }
 
 void Application::createGraphicsPipeline() {
-    auto vertexShaderCode = readFile("resources/shaders/compiled/vert.spv");
-    auto fragmentShaderCode = readFile("resources/shaders/compiled/frag.spv");
+    // Per-draw data travels in push constants, so the per-frame sets are bound once for any number of draws
+    vk::PushConstantRange drawPushConstantRange = vk::PushConstantRange()
+            .setStageFlags(vk::ShaderStageFlagBits::eVertex)
+            .setOffset(0)
+            .setSize(sizeof(DrawParameters));
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = vk::PipelineLayoutCreateInfo()
+            .setSetLayoutCount(1)
+            .setPSetLayouts(&descriptorSetLayout)
+            .setPushConstantRangeCount(1)
+            .setPPushConstantRanges(&drawPushConstantRange);
+
+    // Bindless draws add the texture set
+    std::array<vk::DescriptorSetLayout, 2> bindlessSetLayouts = {descriptorSetLayout, bindlessSetLayout};
+    if (bindlessEnabled) {
+        pipelineLayoutCreateInfo.setSetLayoutCount(static_cast<uint32_t>(bindlessSetLayouts.size()))
+                .setPSetLayouts(bindlessSetLayouts.data());
+    }
 
-    vk::ShaderModule vertexShaderModule = createShaderModule(vertexShaderCode);
-    vk::ShaderModule fragmentShaderModule = createShaderModule(fragmentShaderCode);
+    // A new sample count recreates the pipelines, which keep their layout
+    if (!pipelineLayout) {
+        vk::Result result = logicalDevice.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to create pipeline layout! Error Code: " + vk::to_string(result));
+        }
+    }
+
+    // The shading permutations are built by prepareGraphicsPipelines, once it is known which ones the draws need
+    depthPrepassPipeline = buildScenePipeline(0, true);
+
+    invalidateCommandBuffers();
+}
+
+vk::Pipeline Application::buildScenePipeline(uint32_t permutation, bool depthOnly) {
+    // The depth pre-pass shares the rest of the state, but reads only the position stream, has no fragment shader,
+    // writes no color and keeps the default LESS test with depth writes
+    std::vector<vk::ShaderModule> shaderModules;
+    if (depthOnly) {
+        shaderModules.push_back(createShaderModule(readFile("resources/shaders/compiled/depth_prepass.spv")));
+    } else {
+        shaderModules.push_back(createShaderModule(readFile(bindlessEnabled
+                                                            ? "resources/shaders/compiled/vert_bindless.spv"
+                                                            : "resources/shaders/compiled/vert.spv")));
+        shaderModules.push_back(createShaderModule(readFile(bindlessEnabled
+                                                            ? "resources/shaders/compiled/frag_bindless.spv"
+                                                            : "resources/shaders/compiled/frag.spv")));
+    }
 
-    vk::PipelineShaderStageCreateInfo vertexShaderStageCreateInfo = vk::PipelineShaderStageCreateInfo()
+    // Both stages get every constant; a stage ignores the ones it doesn't declare
+    PermutationConstants constants{};
+    constants.vertexColors = (permutation & PERMUTATION_VERTEX_COLORS) ? vk::True : vk::False;
+    constants.alphaTest = (permutation & PERMUTATION_ALPHA_TEST) ? vk::True : vk::False;
+    constants.lightingMode = permutation >> PERMUTATION_LIGHTING_SHIFT;
+
+    std::array<vk::SpecializationMapEntry, 3> specializationMapEntries = {
+            vk::SpecializationMapEntry(0, offsetof(PermutationConstants, vertexColors), sizeof(VkBool32)),
+            vk::SpecializationMapEntry(1, offsetof(PermutationConstants, alphaTest), sizeof(VkBool32)),
+            vk::SpecializationMapEntry(2, offsetof(PermutationConstants, lightingMode), sizeof(uint32_t))};
+
+    vk::SpecializationInfo specializationInfo = vk::SpecializationInfo()
+            .setMapEntryCount(static_cast<uint32_t>(specializationMapEntries.size()))
+            .setPMapEntries(specializationMapEntries.data())
+            .setDataSize(sizeof(constants))
+            .setPData(&constants);
+
+    std::array<vk::PipelineShaderStageCreateInfo, 2> shaderStages{};
+    shaderStages[0] = vk::PipelineShaderStageCreateInfo()
             .setStage(vk::ShaderStageFlagBits::eVertex)
-            .setModule(vertexShaderModule)
-            .setPName("main");
-    vk::PipelineShaderStageCreateInfo fragmentShaderStageCreateInfo = vk::PipelineShaderStageCreateInfo()
-            .setStage(vk::ShaderStageFlagBits::eFragment)
-            .setModule(fragmentShaderModule)
-            .setPName("main");
-    vk::PipelineShaderStageCreateInfo shaderStages[] = {vertexShaderStageCreateInfo, fragmentShaderStageCreateInfo};
-
-    auto bindingDescription = Vertex::getBindingDescription();
+            .setModule(shaderModules[0])
+            .setPName("main")
+            .setPSpecializationInfo(&specializationInfo);
+    if (!depthOnly) {
+        shaderStages[1] = vk::PipelineShaderStageCreateInfo()
+                .setStage(vk::ShaderStageFlagBits::eFragment)
+                .setModule(shaderModules[1])
+                .setPName("main")
+                .setPSpecializationInfo(&specializationInfo);
+    }
+
+    auto bindingDescriptions = Vertex::getBindingDescriptions();
     auto attributeDescriptions = Vertex::getAttributeDescriptions();
 
     vk::PipelineVertexInputStateCreateInfo vertexInputCreateInfo = vk::PipelineVertexInputStateCreateInfo()
-            .setVertexBindingDescriptionCount(1)
-            .setPVertexBindingDescriptions(&bindingDescription)
-            .setVertexAttributeDescriptionCount(static_cast<uint32_t>(attributeDescriptions.size()))
+            .setVertexBindingDescriptionCount(depthOnly ? 1 : static_cast<uint32_t>(bindingDescriptions.size()))
+            .setPVertexBindingDescriptions(bindingDescriptions.data())
+            .setVertexAttributeDescriptionCount(depthOnly ? 1 : static_cast<uint32_t>(attributeDescriptions.size()))
             .setPVertexAttributeDescriptions(attributeDescriptions.data());
 
     vk::PipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = vk::PipelineInputAssemblyStateCreateInfo()
@@ -677,6 +1167,9 @@ void Application::createGraphicsPipeline() {
             .setSrcAlphaBlendFactor(vk::BlendFactor::eOne)
             .setDstAlphaBlendFactor(vk::BlendFactor::eZero)
             .setAlphaBlendOp(vk::BlendOp::eAdd);
+    if (depthOnly) {
+        colorBlendAttachmentState.setColorWriteMask({});
+    }
 
     vk::PipelineColorBlendStateCreateInfo colorBlendingCreateInfo = vk::PipelineColorBlendStateCreateInfo()
             .setLogicOpEnable(VK_FALSE)
@@ -685,28 +1178,23 @@ void Application::createGraphicsPipeline() {
             .setPAttachments(&colorBlendAttachmentState)
             .setBlendConstants({0.0f, 0.0f, 0.0f, 0.0f});
 
+    // Depth compare and writes depend on whether a depth pre-pass ran, which the pre-pass benchmark switches at
+    // runtime, and on whether the draw is alpha tested
     std::vector<vk::DynamicState> dynamicStates = {
             vk::DynamicState::eViewport,
             vk::DynamicState::eScissor};
+    if (!depthOnly) {
+        dynamicStates.push_back(vk::DynamicState::eDepthCompareOp);
+        dynamicStates.push_back(vk::DynamicState::eDepthWriteEnable);
+    }
 
     vk::PipelineDynamicStateCreateInfo dynamicStateCreateInfo = vk::PipelineDynamicStateCreateInfo()
             .setDynamicStateCount(static_cast<uint32_t>(dynamicStates.size()))
             .setPDynamicStates(dynamicStates.data());
 
-    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = vk::PipelineLayoutCreateInfo()
-            .setSetLayoutCount(1)
-            .setPSetLayouts(&descriptorSetLayout)
-            .setPushConstantRangeCount(0)
-            .setPPushConstantRanges(nullptr);
-
-    vk::Result result = logicalDevice.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
-    if (result != vk::Result::eSuccess) {
-        throw std::runtime_error("Failed to create pipeline layout! Error Code: " + vk::to_string(result));
-    }
-
     vk::GraphicsPipelineCreateInfo pipelineCreateInfo = vk::GraphicsPipelineCreateInfo()
-            .setStageCount(2)
-            .setPStages(shaderStages)
+            .setStageCount(static_cast<uint32_t>(shaderModules.size()))
+            .setPStages(shaderStages.data())
             .setPVertexInputState(&vertexInputCreateInfo)
             .setPInputAssemblyState(&inputAssemblyCreateInfo)
             .setPViewportState(&viewportStateCreateInfo)
@@ -721,13 +1209,90 @@ void Application::createGraphicsPipeline() {
             .setBasePipelineHandle(VK_NULL_HANDLE)
             .setBasePipelineIndex(-1);
 
-    result = logicalDevice.createGraphicsPipelines(VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &graphicsPipeline);
+    // Without a render pass the pipeline is described by the formats of the attachments it renders to and the views
+    // it renders
+    vk::Format depthFormat = findDepthFormat();
+    vk::PipelineRenderingCreateInfo renderingCreateInfo = vk::PipelineRenderingCreateInfo()
+            .setViewMask(getViewMask())
+            .setColorAttachmentCount(1)
+            .setPColorAttachmentFormats(&swapChainImageFormat)
+            .setDepthAttachmentFormat(depthFormat);
+
+    if (dynamicRenderingEnabled) {
+        pipelineCreateInfo.setPNext(&renderingCreateInfo);
+        pipelineCreateInfo.setRenderPass(VK_NULL_HANDLE);
+    }
+
+    vk::Pipeline pipeline;
+    vk::Result result = logicalDevice.createGraphicsPipelines(VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr,
+                                                              &pipeline);
     if (result != vk::Result::eSuccess) {
-        throw std::runtime_error("Failed to create graphics pipeline! Error Code: " + vk::to_string(result));
+        throw std::runtime_error(std::string(depthOnly ? "Failed to create depth pre-pass pipeline!"
+                                                       : "Failed to create graphics pipeline!") +
+                                 " Error Code: " + vk::to_string(result));
+    }
+
+    for (vk::ShaderModule shaderModule: shaderModules) {
+        logicalDevice.destroyShaderModule(shaderModule);
+    }
+
+    return pipeline;
+}
+
+void Application::prepareGraphicsPipelines() {
+    // GPU-driven draws of every mesh share one multi-draw call, and with it one pipeline with the features of all
+    uint32_t framePermutation = getFramePermutation();
+    std::vector<uint32_t> permutations;
+    if (gpuDrivenEnabled) {
+        permutations.push_back(getScenePermutation() | framePermutation);
+    } else {
+        for (uint32_t meshIndex = 0; meshIndex < drawCommands.size(); meshIndex++) {
+            permutations.push_back(getDrawPermutation(meshIndex) | framePermutation);
+        }
+    }
+
+    for (uint32_t permutation: permutations) {
+        if (graphicsPipelines.count(permutation) == 0) {
+            graphicsPipelines[permutation] = buildScenePipeline(permutation, false);
+        }
+    }
+}
+
+void Application::retireGraphicsPipelines() {
+    // Frames in flight may still be drawing with them
+    for (auto &[permutation, pipeline]: graphicsPipelines) {
+        deletionQueue.push(timelineValue, pipeline);
+    }
+    graphicsPipelines.clear();
+    deletionQueue.push(timelineValue, depthPrepassPipeline);
+}
+
+uint32_t Application::getFramePermutation() const {
+    // The clusters are binned in the central camera's screen space, which the other views don't share
+    uint32_t lightingMode = LIGHTING_UNLIT;
+    if (lightCount > 0) {
+        lightingMode = settings.clusteredLighting && !multiviewEnabled ? LIGHTING_CLUSTERED : LIGHTING_ALL_LIGHTS;
+    }
+
+    return lightingMode << PERMUTATION_LIGHTING_SHIFT;
+}
+
+uint32_t Application::getDrawPermutation(uint32_t meshIndex) const {
+    uint32_t permutation = meshPermutations[meshIndex];
+    if (textures[drawCommands[meshIndex].textureIndex].alphaTested) {
+        permutation |= PERMUTATION_ALPHA_TEST;
+    }
+
+    return permutation;
+}
+
+uint32_t Application::getScenePermutation() const {
+    uint32_t permutation = 0;
+    for (uint32_t meshIndex = 0; meshIndex < drawCommands.size(); meshIndex++) {
+        permutation |= getDrawPermutation(meshIndex);
     }
 
-    logicalDevice.destroyShaderModule(fragmentShaderModule);
-    logicalDevice.destroyShaderModule(vertexShaderModule);
+    return permutation;
 }
 
 std::vector<char> Application::readFile(const std::string &fileName) {
@@ -765,7 +1330,7 @@ void Application::createRenderPass() {
             .setFormat(swapChainImageFormat)
             .setSamples(msaaSamples)
             .setLoadOp(vk::AttachmentLoadOp::eClear)
-            .setStoreOp(vk::AttachmentStoreOp::eStore)
+            .setStoreOp(vk::AttachmentStoreOp::eDontCare)
             .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
             .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
             .setInitialLayout(vk::ImageLayout::eUndefined)
@@ -779,7 +1344,7 @@ void Application::createRenderPass() {
             .setFormat(findDepthFormat())
             .setSamples(msaaSamples)
             .setLoadOp(vk::AttachmentLoadOp::eClear)
-            .setStoreOp(vk::AttachmentStoreOp::eStore)
+            .setStoreOp(vk::AttachmentStoreOp::eDontCare)
             .setStencilLoadOp(vk::AttachmentLoadOp::eDontCare)
             .setStencilStoreOp(vk::AttachmentStoreOp::eDontCare)
             .setInitialLayout(vk::ImageLayout::eUndefined)
@@ -867,32 +1432,205 @@ void Application::createCommandPool() {
     }
 }
 
+void Application::createFrameCommandPools() {
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+    // No individual reset flag: buffers from these pools are only ever released by resetting the whole pool
+    vk::CommandPoolCreateInfo commandPoolCreateInfo = vk::CommandPoolCreateInfo()
+            .setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+            .setQueueFamilyIndex(queueFamilyIndices.graphicsFamily.value());
+
+    uint32_t recordingThreadCount = settings.parallelRecording ? threadPool->getThreadCount() : 0;
+
+    frameCommandPools.resize(maxFramesInFlight);
+
+    for (auto &pools: frameCommandPools) {
+        vk::Result result = logicalDevice.createCommandPool(&commandPoolCreateInfo, nullptr, &pools.primaryPool);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to create frame command pool! Error Code: " + vk::to_string(result));
+        }
+
+        // One pool per recording thread, as a command pool may only be used from one thread at a time
+        pools.threadPools.resize(recordingThreadCount);
+        pools.secondaryCommandBuffers.resize(recordingThreadCount);
+        pools.depthPrepassCommandBuffers.resize(recordingThreadCount);
+
+        for (uint32_t i = 0; i < recordingThreadCount; i++) {
+            result = logicalDevice.createCommandPool(&commandPoolCreateInfo, nullptr, &pools.threadPools[i]);
+            if (result != vk::Result::eSuccess) {
+                throw std::runtime_error(
+                        "Failed to create thread command pool! Error Code: " + vk::to_string(result));
+            }
+
+            // A shading buffer and a depth pre-pass buffer, both recorded by the same task
+            std::array<vk::CommandBuffer, 2> threadCommandBuffers;
+            vk::CommandBufferAllocateInfo allocateInfo = vk::CommandBufferAllocateInfo()
+                    .setCommandPool(pools.threadPools[i])
+                    .setLevel(vk::CommandBufferLevel::eSecondary)
+                    .setCommandBufferCount(static_cast<uint32_t>(threadCommandBuffers.size()));
+
+            result = logicalDevice.allocateCommandBuffers(&allocateInfo, threadCommandBuffers.data());
+            if (result != vk::Result::eSuccess) {
+                throw std::runtime_error(
+                        "Failed to allocate secondary command buffer! Error Code: " + vk::to_string(result));
+            }
+
+            pools.secondaryCommandBuffers[i] = threadCommandBuffers[0];
+            pools.depthPrepassCommandBuffers[i] = threadCommandBuffers[1];
+        }
+    }
+}
+
+void Application::resetFrameCommandPools(uint32_t frameIndex) {
+    const FrameCommandPools &pools = frameCommandPools[frameIndex];
+
+    logicalDevice.resetCommandPool(pools.primaryPool, vk::CommandPoolResetFlags());
+
+    for (auto pool: pools.threadPools) {
+        logicalDevice.resetCommandPool(pool, vk::CommandPoolResetFlags());
+    }
+}
+
 void Application::createCommandBuffers() {
-    commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+    commandBuffers.resize(maxFramesInFlight);
 
-    vk::CommandBufferAllocateInfo allocateCreateInfo = vk::CommandBufferAllocateInfo()
-            .setCommandPool(commandPool)
+    for (size_t i = 0; i < maxFramesInFlight; i++) {
+        vk::CommandBufferAllocateInfo allocateCreateInfo = vk::CommandBufferAllocateInfo()
+                .setCommandPool(frameCommandPools[i].primaryPool)
+                .setLevel(vk::CommandBufferLevel::ePrimary)
+                .setCommandBufferCount(1);
+
+        vk::Result result = logicalDevice.allocateCommandBuffers(&allocateCreateInfo, &commandBuffers[i]);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to allocate command buffers! Error Code: " + vk::to_string(result));
+        }
+    }
+}
+
+void Application::createCachedCommandBuffers() {
+    if (!settings.cachedCommandBuffers) {
+        return;
+    }
+
+    if (!cachedCommandPool) {
+        QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+        vk::CommandPoolCreateInfo commandPoolCreateInfo = vk::CommandPoolCreateInfo()
+                .setFlags(vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+                .setQueueFamilyIndex(queueFamilyIndices.graphicsFamily.value());
+
+        vk::Result result = logicalDevice.createCommandPool(&commandPoolCreateInfo, nullptr, &cachedCommandPool);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to create cached command pool! Error Code: " + vk::to_string(result));
+        }
+    }
+
+    // The swapchain image count may change on recreation, so the cache is sized from the current swapchain
+    cachedCommandBuffers.resize(maxFramesInFlight * swapChainImages.size());
+    cachedCommandBufferGenerations.assign(cachedCommandBuffers.size(), 0);
+
+    vk::CommandBufferAllocateInfo allocateInfo = vk::CommandBufferAllocateInfo()
+            .setCommandPool(cachedCommandPool)
             .setLevel(vk::CommandBufferLevel::ePrimary)
-            .setCommandBufferCount((uint32_t) commandBuffers.size());
+            .setCommandBufferCount(static_cast<uint32_t>(cachedCommandBuffers.size()));
 
-    vk::Result result = logicalDevice.allocateCommandBuffers(&allocateCreateInfo, commandBuffers.data());
+    vk::Result result = logicalDevice.allocateCommandBuffers(&allocateInfo, cachedCommandBuffers.data());
     if (result != vk::Result::eSuccess) {
-        throw std::runtime_error("Failed to allocate command buffers! Error Code: " + vk::to_string(result));
+        throw std::runtime_error("Failed to allocate cached command buffers! Error Code: " + vk::to_string(result));
+    }
+}
+
+void Application::invalidateCommandBuffers() {
+    commandBufferGeneration++;
+}
+
+vk::CommandBuffer Application::getFrameCommandBuffer(uint32_t imageIndex) {
+    if (!settings.cachedCommandBuffers) {
+        resetFrameCommandPools(currentFrame);
+        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+
+        return commandBuffers[currentFrame];
     }
+
+    // Buffers of this frame slot are only ever submitted from this slot, whose last submission has already completed,
+    // so a stale one can be reset and re-recorded in place
+    size_t cacheIndex = currentFrame * swapChainImages.size() + imageIndex;
+    vk::CommandBuffer commandBuffer = cachedCommandBuffers[cacheIndex];
+
+    if (cachedCommandBufferGenerations[cacheIndex] != commandBufferGeneration) {
+        commandBuffer.reset();
+        recordCommandBuffer(commandBuffer, imageIndex);
+        cachedCommandBufferGenerations[cacheIndex] = commandBufferGeneration;
+    }
+
+    return commandBuffer;
 }
 
 void Application::recordCommandBuffer(vk::CommandBuffer commandBuffer, uint32_t imageIndex) {
     vk::CommandBufferBeginInfo beginCreateInfo = vk::CommandBufferBeginInfo();
+    if (!settings.cachedCommandBuffers) {
+        beginCreateInfo.setFlags(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+    }
 
     vk::Result result = commandBuffer.begin(&beginCreateInfo);
     if (result != vk::Result::eSuccess) {
         throw std::runtime_error("Failed to allocate command buffers! Error Code: " + vk::to_string(result));
     }
 
+    // Secondary buffers live in the per-frame pools that are reset every frame, so cached buffers are recorded inline
+    bool recordInParallel = settings.parallelRecording && !settings.cachedCommandBuffers && !gpuDrivenEnabled &&
+                            !frameCommandPools[currentFrame].threadPools.empty();
+
     std::array<vk::ClearValue, 2> clearValues{};
     clearValues[0].color = vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f});
     clearValues[1].depthStencil = vk::ClearDepthStencilValue{1.0f, 0};
 
+    // Missing permutations are built here, as the secondary buffers are recorded on several threads
+    prepareGraphicsPipelines();
+
+    // Occlusion culling times its own passes, which the light binning comes before
+    if (occlusionCullingEnabled) {
+        recordLightBinning(commandBuffer);
+        recordOcclusionCulledFrame(commandBuffer, imageIndex);
+        commandBuffer.end();
+        return;
+    }
+
+    // The draw list has to be complete before rendering begins, as dispatches are not allowed inside it
+    if (gpuDrivenEnabled) {
+        recordDrawCommandGeneration(commandBuffer);
+    }
+
+    // Both queries span the rendering, outside of which they have to begin and end. Draw list generation has
+    // completed by the first timestamp and belongs to neither section. The pre-pass has no fragment shader, so every
+    // counted invocation is shading
+    gpuTimer.reset(commandBuffer, currentFrame);
+    fragmentCounter.begin(commandBuffer, currentFrame, depthPrepassEnabled);
+    gpuTimer.writeTimestamp(commandBuffer, currentFrame, 0, vk::PipelineStageFlagBits2::eAllCommands);
+    recordLightBinning(commandBuffer);
+    gpuTimer.writeTimestamp(commandBuffer, currentFrame, 1, vk::PipelineStageFlagBits2::eComputeShader);
+    // Inside a multiview pass a timestamp writes one query per view, overrunning the next sections' queries, so the
+    // pre-pass/shading split is only written there with a single view. With several, the pre-pass counts as shading
+    if (multiviewEnabled) {
+        gpuTimer.writeTimestamp(commandBuffer, currentFrame, 2, vk::PipelineStageFlagBits2::eComputeShader);
+    }
+
+    if (dynamicRenderingEnabled) {
+        if (recordInParallel) {
+            beginDynamicRendering(commandBuffer, imageIndex, vk::RenderingFlagBits::eContentsSecondaryCommandBuffers);
+            recordSecondaryCommandBuffers(commandBuffer, imageIndex);
+        } else {
+            beginDynamicRendering(commandBuffer, imageIndex, {});
+            recordSceneDraws(commandBuffer);
+        }
+
+        endDynamicRendering(commandBuffer, imageIndex);
+        gpuTimer.writeTimestamp(commandBuffer, currentFrame, 3, vk::PipelineStageFlagBits2::eAllGraphics);
+        fragmentCounter.end(commandBuffer, currentFrame);
+        commandBuffer.end();
+        return;
+    }
+
     vk::RenderPassBeginInfo renderPassBeginCreateInfo = vk::RenderPassBeginInfo()
             .setClearValueCount(static_cast<uint32_t>(clearValues.size()))
             .setPClearValues(clearValues.data())
@@ -900,44 +1638,513 @@ void Application::recordCommandBuffer(vk::CommandBuffer commandBuffer, uint32_t
             .setFramebuffer(swapChainFrameBuffers[imageIndex])
             .setRenderArea(vk::Rect2D({0, 0}, swapChainExtent));
 
-    commandBuffer.beginRenderPass(&renderPassBeginCreateInfo, vk::SubpassContents::eInline);
-    commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline);
+    if (recordInParallel) {
+        commandBuffer.beginRenderPass(&renderPassBeginCreateInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+        recordSecondaryCommandBuffers(commandBuffer, imageIndex);
+    } else {
+        commandBuffer.beginRenderPass(&renderPassBeginCreateInfo, vk::SubpassContents::eInline);
+        recordSceneDraws(commandBuffer);
+    }
 
-    vk::Viewport viewport = vk::Viewport()
-            .setX(0.0f)
+    commandBuffer.endRenderPass();
+    gpuTimer.writeTimestamp(commandBuffer, currentFrame, 3, vk::PipelineStageFlagBits2::eAllGraphics);
+    fragmentCounter.end(commandBuffer, currentFrame);
+    commandBuffer.end();
+}
+
+void Application::beginDynamicRendering(vk::CommandBuffer commandBuffer, uint32_t imageIndex, vk::RenderingFlags flags,
+                                        RenderingPass pass) {
+    bool resolveToSceneImage = dynamicResolutionEnabled || multiviewEnabled;
+    vk::RenderingAttachmentInfo colorAttachment = vk::RenderingAttachmentInfo()
+            .setImageView(colorImageView)
+            .setImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+            .setResolveMode(vk::ResolveModeFlagBits::eAverage)
+            .setResolveImageView(resolveToSceneImage ? sceneImageView : swapChainImageViews[imageIndex])
+            .setResolveImageLayout(vk::ImageLayout::eColorAttachmentOptimal)
+            .setLoadOp(vk::AttachmentLoadOp::eClear)
+            .setStoreOp(vk::AttachmentStoreOp::eDontCare)
+            .setClearValue(vk::ClearColorValue(std::array<float, 4>{0.0f, 0.0f, 0.0f, 1.0f}));
+
+    vk::RenderingAttachmentInfo depthAttachment = vk::RenderingAttachmentInfo()
+            .setImageView(depthImageView)
+            .setImageLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+            .setLoadOp(vk::AttachmentLoadOp::eClear)
+            .setStoreOp(vk::AttachmentStoreOp::eDontCare)
+            .setClearValue(vk::ClearDepthStencilValue{1.0f, 0});
+
+    vk::RenderingInfo renderingInfo = vk::RenderingInfo()
+            .setFlags(flags)
+            .setRenderArea(vk::Rect2D({0, 0}, renderExtent))
+            .setLayerCount(1)
+            .setViewMask(getViewMask())
+            .setColorAttachmentCount(1)
+            .setPColorAttachments(&colorAttachment)
+            .setPDepthAttachment(&depthAttachment);
+
+    // The early pass keeps the multisampled targets for the depth pyramid and the late pass, which continues on
+    // them and resolves. Its barriers were recorded by the depth pyramid build
+    if (pass == RenderingPass::Early) {
+        colorAttachment.setResolveMode(vk::ResolveModeFlagBits::eNone)
+                .setResolveImageView(nullptr)
+                .setStoreOp(vk::AttachmentStoreOp::eStore);
+        depthAttachment.setStoreOp(vk::AttachmentStoreOp::eStore);
+    } else if (pass == RenderingPass::Late) {
+        colorAttachment.setLoadOp(vk::AttachmentLoadOp::eLoad);
+        depthAttachment.setLoadOp(vk::AttachmentLoadOp::eLoad);
+
+        commandBuffer.beginRendering(&renderingInfo);
+        return;
+    }
+
+    // These barriers do what the render pass's initial layouts and external dependency did. Every attachment is
+    // cleared, so previous contents are discarded and the old layout is always UNDEFINED, which also keeps the
+    // recording valid when a cached buffer is replayed. With multiview the attachments have a layer per view
+    vk::ImageSubresourceRange colorRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, VK_REMAINING_ARRAY_LAYERS);
+    vk::ImageAspectFlags depthAspect = vk::ImageAspectFlagBits::eDepth;
+    if (hasStencilComponent(findDepthFormat())) {
+        depthAspect |= vk::ImageAspectFlagBits::eStencil;
+    }
+
+    std::array<vk::ImageMemoryBarrier2, 3> barriers = {
+            // The acquire semaphore is waited on at COLOR_ATTACHMENT_OUTPUT, which this barrier chains onto
+            vk::ImageMemoryBarrier2()
+                    .setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+                    .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+                    .setDstStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+                    .setDstAccessMask(vk::AccessFlagBits2::eColorAttachmentWrite)
+                    .setOldLayout(vk::ImageLayout::eUndefined)
+                    .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
+                    .setImage(swapChainImages[imageIndex])
+                    .setSubresourceRange(colorRange),
+            // The multisampled targets are shared by all frames in flight, so the previous frame's writes must finish
+            vk::ImageMemoryBarrier2()
+                    .setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+                    .setSrcAccessMask(vk::AccessFlagBits2::eColorAttachmentWrite)
+                    .setDstStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+                    .setDstAccessMask(vk::AccessFlagBits2::eColorAttachmentWrite)
+                    .setOldLayout(vk::ImageLayout::eUndefined)
+                    .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
+                    .setImage(colorImage)
+                    .setSubresourceRange(colorRange),
+            vk::ImageMemoryBarrier2()
+                    .setSrcStageMask(vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+                                     vk::PipelineStageFlagBits2::eLateFragmentTests)
+                    .setSrcAccessMask(vk::AccessFlagBits2::eDepthStencilAttachmentWrite)
+                    .setDstStageMask(vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+                                     vk::PipelineStageFlagBits2::eLateFragmentTests)
+                    .setDstAccessMask(vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+                                      vk::AccessFlagBits2::eDepthStencilAttachmentWrite)
+                    .setOldLayout(vk::ImageLayout::eUndefined)
+                    .setNewLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+                    .setImage(depthImage)
+                    .setSubresourceRange(vk::ImageSubresourceRange(depthAspect, 0, 1, 0, VK_REMAINING_ARRAY_LAYERS))
+    };
+
+    // With dynamic resolution or multiview the swapchain image is only blitted to, and the resolve goes to the scene
+    // image that all frames in flight share, once the previous frame's blit has read it
+    if (resolveToSceneImage) {
+        barriers[0].setSrcStageMask(vk::PipelineStageFlagBits2::eBlit)
+                .setImage(sceneImage);
+    }
+
+    vk::DependencyInfo dependencyInfo = vk::DependencyInfo()
+            .setImageMemoryBarrierCount(static_cast<uint32_t>(barriers.size()))
+            .setPImageMemoryBarriers(barriers.data());
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+
+    commandBuffer.beginRendering(&renderingInfo);
+}
+
+void Application::endDynamicRendering(vk::CommandBuffer commandBuffer, uint32_t imageIndex) {
+    commandBuffer.endRendering();
+
+    if (dynamicResolutionEnabled || multiviewEnabled) {
+        recordUpscale(commandBuffer, imageIndex);
+        return;
+    }
+
+    // The present engine reads the image without a further stage, so only the layout change is needed here
+    vk::ImageMemoryBarrier2 presentBarrier = vk::ImageMemoryBarrier2()
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+            .setSrcAccessMask(vk::AccessFlagBits2::eColorAttachmentWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eNone)
+            .setDstAccessMask(vk::AccessFlagBits2::eNone)
+            .setOldLayout(vk::ImageLayout::eColorAttachmentOptimal)
+            .setNewLayout(vk::ImageLayout::ePresentSrcKHR)
+            .setImage(swapChainImages[imageIndex])
+            .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1));
+
+    vk::DependencyInfo dependencyInfo = vk::DependencyInfo()
+            .setImageMemoryBarrierCount(1)
+            .setPImageMemoryBarriers(&presentBarrier);
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+}
+
+void Application::recordUpscale(vk::CommandBuffer commandBuffer, uint32_t imageIndex) {
+    vk::ImageSubresourceRange colorRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+    vk::ImageSubresourceRange sceneRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, viewCount);
+
+    std::array<vk::ImageMemoryBarrier2, 2> blitBarriers = {
+            vk::ImageMemoryBarrier2()
+                    .setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+                    .setSrcAccessMask(vk::AccessFlagBits2::eColorAttachmentWrite)
+                    .setDstStageMask(vk::PipelineStageFlagBits2::eBlit)
+                    .setDstAccessMask(vk::AccessFlagBits2::eTransferRead)
+                    .setOldLayout(vk::ImageLayout::eColorAttachmentOptimal)
+                    .setNewLayout(vk::ImageLayout::eTransferSrcOptimal)
+                    .setImage(sceneImage)
+                    .setSubresourceRange(sceneRange),
+            // The acquire semaphore is waited on at COLOR_ATTACHMENT_OUTPUT, which this barrier chains onto. The blit
+            // covers the whole image, so its previous contents are discarded
+            vk::ImageMemoryBarrier2()
+                    .setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+                    .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+                    .setDstStageMask(vk::PipelineStageFlagBits2::eBlit)
+                    .setDstAccessMask(vk::AccessFlagBits2::eTransferWrite)
+                    .setOldLayout(vk::ImageLayout::eUndefined)
+                    .setNewLayout(vk::ImageLayout::eTransferDstOptimal)
+                    .setImage(swapChainImages[imageIndex])
+                    .setSubresourceRange(colorRange)
+    };
+
+    vk::DependencyInfo dependencyInfo = vk::DependencyInfo()
+            .setImageMemoryBarrierCount(static_cast<uint32_t>(blitBarriers.size()))
+            .setPImageMemoryBarriers(blitBarriers.data());
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+
+    // Blits clamp to the image edge, not the region, so magnifying the rendered area blends its last row and column
+    // with the texels past it, which hold what an earlier, larger frame resolved there. Ending the region one texel
+    // early keeps every sample inside the rendered area
+    vk::Extent2D viewExtent = getViewExtent();
+    auto sourceEnd = [](uint32_t rendered, uint32_t available) {
+        return static_cast<int32_t>(rendered < available && rendered > 1 ? rendered - 1 : rendered);
+    };
+    vk::Offset3D sourceEndOffset(sourceEnd(renderExtent.width, viewExtent.width),
+                                 sourceEnd(renderExtent.height, viewExtent.height), 1);
+
+    // Each view fills a column of the swapchain image; the columns split its width exactly, so a view may be
+    // stretched by one pixel
+    std::array<vk::ImageBlit2, MAX_VIEWS> blitRegions;
+    for (uint32_t view = 0; view < viewCount; view++) {
+        auto columnStart = static_cast<int32_t>(swapChainExtent.width * view / viewCount);
+        auto columnEnd = static_cast<int32_t>(swapChainExtent.width * (view + 1) / viewCount);
+
+        blitRegions[view] = vk::ImageBlit2()
+                .setSrcSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, view, 1))
+                .setSrcOffsets({vk::Offset3D(0, 0, 0), sourceEndOffset})
+                .setDstSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1))
+                .setDstOffsets({vk::Offset3D(columnStart, 0, 0),
+                                vk::Offset3D(columnEnd, static_cast<int32_t>(swapChainExtent.height), 1)});
+    }
+
+    vk::BlitImageInfo2 blitInfo = vk::BlitImageInfo2()
+            .setSrcImage(sceneImage)
+            .setSrcImageLayout(vk::ImageLayout::eTransferSrcOptimal)
+            .setDstImage(swapChainImages[imageIndex])
+            .setDstImageLayout(vk::ImageLayout::eTransferDstOptimal)
+            .setRegionCount(viewCount)
+            .setPRegions(blitRegions.data())
+            .setFilter(vk::Filter::eLinear);
+    commandBuffer.blitImage2(&blitInfo);
+
+    vk::ImageMemoryBarrier2 presentBarrier = vk::ImageMemoryBarrier2()
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eBlit)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eNone)
+            .setDstAccessMask(vk::AccessFlagBits2::eNone)
+            .setOldLayout(vk::ImageLayout::eTransferDstOptimal)
+            .setNewLayout(vk::ImageLayout::ePresentSrcKHR)
+            .setImage(swapChainImages[imageIndex])
+            .setSubresourceRange(colorRange);
+
+    dependencyInfo.setImageMemoryBarrierCount(1)
+            .setPImageMemoryBarriers(&presentBarrier);
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+}
+
+void Application::recordSecondaryCommandBuffers(vk::CommandBuffer primaryCommandBuffer, uint32_t imageIndex) {
+    const FrameCommandPools &pools = frameCommandPools[currentFrame];
+
+    // Contiguous draw ranges, one per recording thread, so the primary replays them in scene order
+    uint32_t rangeCount = static_cast<uint32_t>(std::min(pools.secondaryCommandBuffers.size(),
+                                                         std::max<size_t>(visibleDraws.size(), 1)));
+
+    // The fragment count query is active in the primary while these run
+    vk::CommandBufferInheritanceInfo inheritanceInfo = vk::CommandBufferInheritanceInfo();
+    if (fragmentCounter.isSupported()) {
+        inheritanceInfo.setPipelineStatistics(vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations);
+    }
+
+    vk::Format depthFormat = findDepthFormat();
+    vk::CommandBufferInheritanceRenderingInfo inheritanceRenderingInfo = vk::CommandBufferInheritanceRenderingInfo()
+            .setViewMask(getViewMask())
+            .setColorAttachmentCount(1)
+            .setPColorAttachmentFormats(&swapChainImageFormat)
+            .setDepthAttachmentFormat(depthFormat)
+            .setRasterizationSamples(msaaSamples);
+
+    if (dynamicRenderingEnabled) {
+        inheritanceInfo.setPNext(&inheritanceRenderingInfo);
+    } else {
+        inheritanceInfo.setRenderPass(renderPass)
+                .setSubpass(0)
+                .setFramebuffer(swapChainFrameBuffers[imageIndex]);
+    }
+
+    vk::CommandBufferBeginInfo beginInfo = vk::CommandBufferBeginInfo()
+            .setFlags(vk::CommandBufferUsageFlagBits::eRenderPassContinue |
+                      vk::CommandBufferUsageFlagBits::eOneTimeSubmit)
+            .setPInheritanceInfo(&inheritanceInfo);
+
+    threadPool->parallelFor(rangeCount, [&](uint32_t rangeIndex) {
+        size_t firstDraw = visibleDraws.size() * rangeIndex / rangeCount;
+        size_t lastDraw = visibleDraws.size() * (rangeIndex + 1) / rangeCount;
+
+        // The range's share of the pre-pass goes into a buffer of its own, so the primary can run the whole pre-pass
+        // before any shading
+        if (depthPrepassEnabled) {
+            vk::CommandBuffer depthPrepassCommandBuffer = pools.depthPrepassCommandBuffers[rangeIndex];
+
+            vk::Result result = depthPrepassCommandBuffer.begin(&beginInfo);
+            if (result != vk::Result::eSuccess) {
+                throw std::runtime_error(
+                        "Failed to begin secondary command buffer! Error Code: " + vk::to_string(result));
+            }
+
+            recordDraws(depthPrepassCommandBuffer, firstDraw, lastDraw - firstDraw, true);
+            depthPrepassCommandBuffer.end();
+        }
+
+        vk::CommandBuffer commandBuffer = pools.secondaryCommandBuffers[rangeIndex];
+
+        vk::Result result = commandBuffer.begin(&beginInfo);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error(
+                    "Failed to begin secondary command buffer! Error Code: " + vk::to_string(result));
+        }
+
+        // The primary can't record between the buffers it executes, so the first shading range ends the pre-pass
+        // section
+        if (rangeIndex == 0 && !multiviewEnabled) {
+            gpuTimer.writeTimestamp(commandBuffer, currentFrame, 2, vk::PipelineStageFlagBits2::eAllGraphics);
+        }
+
+        recordDraws(commandBuffer, firstDraw, lastDraw - firstDraw);
+        commandBuffer.end();
+    });
+
+    std::vector<vk::CommandBuffer> executedCommandBuffers;
+    if (depthPrepassEnabled) {
+        executedCommandBuffers.insert(executedCommandBuffers.end(), pools.depthPrepassCommandBuffers.begin(),
+                                      pools.depthPrepassCommandBuffers.begin() + rangeCount);
+    }
+    executedCommandBuffers.insert(executedCommandBuffers.end(), pools.secondaryCommandBuffers.begin(),
+                                  pools.secondaryCommandBuffers.begin() + rangeCount);
+
+    primaryCommandBuffer.executeCommands(static_cast<uint32_t>(executedCommandBuffers.size()),
+                                         executedCommandBuffers.data());
+}
+
+void Application::recordSceneDraws(vk::CommandBuffer commandBuffer) {
+    if (depthPrepassEnabled) {
+        recordDraws(commandBuffer, 0, visibleDraws.size(), true);
+    }
+
+    if (!multiviewEnabled) {
+        gpuTimer.writeTimestamp(commandBuffer, currentFrame, 2, vk::PipelineStageFlagBits2::eAllGraphics);
+    }
+    recordDraws(commandBuffer, 0, visibleDraws.size());
+}
+
+void Application::recordDraws(vk::CommandBuffer commandBuffer, size_t firstDraw, size_t drawCount, bool depthOnly) {
+    // Secondary command buffers inherit no state, so every range binds everything it uses. Shading pipelines are
+    // bound per permutation below
+    if (depthOnly) {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, depthPrepassPipeline);
+    }
+
+    // Behind a pre-pass depth is already final, and only the nearest surface passes an EQUAL test. Alpha-tested
+    // draws are left out of the pre-pass, as it would lay down depth where their texels are discarded, so they test
+    // against the opaque depth and write their own
+    uint32_t framePermutation = getFramePermutation();
+    auto bindPermutation = [&](uint32_t drawPermutation) {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                   graphicsPipelines.at(drawPermutation | framePermutation));
+
+        bool depthFinal = depthPrepassEnabled && !(drawPermutation & PERMUTATION_ALPHA_TEST);
+        commandBuffer.setDepthCompareOp(depthFinal ? vk::CompareOp::eEqual : vk::CompareOp::eLess);
+        commandBuffer.setDepthWriteEnable(depthFinal ? vk::False : vk::True);
+    };
+
+    vk::Viewport viewport = vk::Viewport()
+            .setX(0.0f)
             .setY(0.0f)
-            .setWidth((float) swapChainExtent.width)
-            .setHeight((float) swapChainExtent.height)
+            .setWidth((float) renderExtent.width)
+            .setHeight((float) renderExtent.height)
             .setMinDepth(0.0f)
             .setMaxDepth(1.0f);
     commandBuffer.setViewport(0, 1, &viewport);
 
     vk::Rect2D scissor = vk::Rect2D()
             .setOffset({0, 0})
-            .setExtent(swapChainExtent);
+            .setExtent(renderExtent);
     commandBuffer.setScissor(0, 1, &scissor);
 
-    vk::Buffer vertexBuffers[] = {vertexBuffer};
-    vk::DeviceSize offsets[] = {0};
-    commandBuffer.bindVertexBuffers(0, 1, vertexBuffers, offsets);
+    // Both streams live in the vertex buffer, positions first; depth-only draws bind just the positions
+    vk::Buffer vertexBuffers[] = {vertexBuffer, vertexBuffer};
+    vk::DeviceSize offsets[] = {0, getVertexAttributesOffset()};
+    commandBuffer.bindVertexBuffers(0, depthOnly ? 1 : 2, vertexBuffers, offsets);
     commandBuffer.bindIndexBuffer(indexBuffer, 0, vk::IndexType::eUint32);
     commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, 1,
                                      &descriptorSets[currentFrame], 0, nullptr);
 
-    commandBuffer.drawIndexed(static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+    // The texture set is bound once; draws only change the material index
+    if (bindlessEnabled && !depthOnly) {
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 1, 1,
+                                         &bindlessDescriptorSets[currentFrame], 0, nullptr);
+    }
 
-    commandBuffer.endRenderPass();
-    commandBuffer.end();
+    // One call for the whole scene, whatever the number of objects. Each command selects its transform through
+    // firstInstance and its material through the indirect buffer. The call can't be split by permutation, so with
+    // any alpha-tested material the pre-pass is skipped and the shading pass tests and writes depth itself
+    if (gpuDrivenEnabled) {
+        uint32_t scenePermutation = getScenePermutation();
+        if (depthOnly && (scenePermutation & PERMUTATION_ALPHA_TEST)) {
+            return;
+        }
+        if (!depthOnly) {
+            bindPermutation(scenePermutation);
+        }
+
+        DrawParameters parameters{0, MATERIAL_FROM_DRAW};
+        commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, sizeof(parameters),
+                                    &parameters);
+
+        commandBuffer.drawIndexedIndirectCount(indirectBuffers[currentFrame], INDIRECT_COMMANDS_OFFSET,
+                                               indirectBuffers[currentFrame], 0, visibleObjectCount,
+                                               sizeof(IndirectDraw));
+        return;
+    }
+
+    // Draws are sorted by key, so the material is only pushed where the state part of the key changes, and the
+    // pipeline only bound where its permutation does
+    uint64_t boundState = ~uint64_t(0);
+    uint32_t boundPermutation = UINT32_MAX;
+
+    for (size_t i = firstDraw; i < firstDraw + drawCount; i++) {
+        const VisibleDraw &visibleDraw = visibleDraws[i];
+        const DrawCommand &draw = drawCommands[visibleDraw.meshIndex];
+        uint32_t drawPermutation = DrawSorter::getPipeline(visibleDraw.sortKey);
+
+        if (depthOnly && (drawPermutation & PERMUTATION_ALPHA_TEST)) {
+            continue;
+        }
+
+        if (!depthOnly && DrawSorter::getState(visibleDraw.sortKey) != boundState) {
+            boundState = DrawSorter::getState(visibleDraw.sortKey);
+
+            if (drawPermutation != boundPermutation) {
+                boundPermutation = drawPermutation;
+                bindPermutation(drawPermutation);
+            }
+
+            uint32_t materialIndex = DrawSorter::getMaterial(visibleDraw.sortKey);
+            commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eVertex,
+                                        offsetof(DrawParameters, materialIndex), sizeof(materialIndex),
+                                        &materialIndex);
+        }
+
+        commandBuffer.pushConstants(pipelineLayout, vk::ShaderStageFlagBits::eVertex,
+                                    offsetof(DrawParameters, transformBase), sizeof(visibleDraw.firstInstance),
+                                    &visibleDraw.firstInstance);
+        commandBuffer.drawIndexed(draw.indexCount, visibleDraw.instanceCount, draw.firstIndex, draw.vertexOffset, 0);
+    }
+}
+
+void Application::paceFrame() {
+    if (!presentWaitEnabled) {
+        // Without present timing only the CPU cadence can be observed
+        framePacer.recordPresent(FramePacer::Clock::now());
+        return;
+    }
+
+    // A present id belongs to the swapchain it was presented to, which may have been replaced since
+    if (lastPresentId == 0 || lastPresentSwapChain != swapChain) {
+        return;
+    }
+
+    // Block until the previous frame is on screen, i.e. right after a vblank, with a timeout so a stalled
+    // presentation engine cannot hang the render loop
+    VkResult result = waitForPresentKHR(logicalDevice, swapChain, lastPresentId, 100'000'000);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+
+    auto presentTime = FramePacer::Clock::now();
+    framePacer.recordPresent(presentTime);
+
+    if (settings.frameStatistics) {
+        frameStatistics.completeFrames(lastPresentId, presentTime);
+    }
+
+    std::this_thread::sleep_until(framePacer.getNextFrameStart());
 }
 
 void Application::drawFrame() {
-    vk::Result result = logicalDevice.waitForFences(1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-    if (result != vk::Result::eSuccess) {
-        throw std::runtime_error("Failed to wait for in-flight fence! Error Code: " + vk::to_string(result));
+    if (settings.framePacing) {
+        paceFrame();
+    }
+
+    frameStartTime = FramePacer::Clock::now();
+
+    // Wait for the previous submission that used this frame slot's resources
+    waitForTimelineValue(frameTimelineValues[currentFrame]);
+
+    deletionQueue.flush(logicalDevice, getCompletedTimelineValue());
+    destroyRetiredSwapChains(false);
+
+    if (occlusionCullingEnabled) {
+        collectOcclusionStatistics(currentFrame);
+    } else {
+        collectFrameQueries(currentFrame);
+    }
+
+    frameNumber++;
+
+    memoryBudget.update();
+    enforceMemoryBudget();
+
+    auto cpuStartTime = std::chrono::steady_clock::now();
+
+    ensureInstanceBufferCapacity(currentFrame);
+    if (gpuDrivenEnabled) {
+        ensureDrawCommandBufferCapacity(currentFrame);
+    }
+
+    // The slot's previous submission has completed, so its descriptor set can be rewritten. Command buffers that
+    // bound the old contents are no longer valid and get re-recorded
+    if (descriptorSetGenerations[currentFrame] != descriptorGeneration) {
+        updateDescriptorSet(currentFrame);
+        invalidateCommandBuffers();
+    }
+
+    // Bindless textures are rewritten in place, leaving recorded command buffers valid
+    if (bindlessEnabled && bindlessTextureGenerations[currentFrame] != textureGeneration) {
+        updateBindlessTextures(currentFrame);
+    }
+
+    if (settings.frameStatistics) {
+        auto now = FrameStatistics::Clock::now();
+
+        // With present wait, frames are completed by paceFrame when they are actually displayed
+        if (!(settings.framePacing && presentWaitEnabled)) {
+            frameStatistics.completeFrames(getCompletedTimelineValue(), now);
+        }
+        frameStatistics.beginFrame(now);
     }
 
     uint32_t imageIndex;
-    result = logicalDevice.acquireNextImageKHR(swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame],
+    vk::Result result = logicalDevice.acquireNextImageKHR(swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame],
                                                VK_NULL_HANDLE, &imageIndex);
     if (result == vk::Result::eErrorOutOfDateKHR) {
         recreateSwapChain();
@@ -947,34 +2154,52 @@ void Application::drawFrame() {
     }
 
     updateUniformBuffer(currentFrame);
+    updateInstanceBuffer(currentFrame);
+    cullObjects(currentFrame);
 
-    result = logicalDevice.resetFences(1, &inFlightFences[currentFrame]);
-    if (result != vk::Result::eSuccess) {
-        throw std::runtime_error("Failed to reset in-flight fence! Error Code: " + vk::to_string(result));
-    }
-
-    commandBuffers[currentFrame].reset();
-    recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+    vk::CommandBuffer commandBuffer = getFrameCommandBuffer(imageIndex);
 
     vk::Semaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
     vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
 
-    vk::Semaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+    vk::Semaphore signalSemaphores[] = {renderFinishedSemaphores[imageIndex], timelineSemaphore};
+
+    // Values for binary semaphores are ignored
+    uint64_t frameTimelineValue = signalNextTimelineValue();
+    uint64_t waitValues[] = {0};
+    uint64_t signalValues[] = {0, frameTimelineValue};
+
+    vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo = vk::TimelineSemaphoreSubmitInfo()
+            .setWaitSemaphoreValueCount(1)
+            .setPWaitSemaphoreValues(waitValues)
+            .setSignalSemaphoreValueCount(2)
+            .setPSignalSemaphoreValues(signalValues);
 
     vk::SubmitInfo submitInfo = vk::SubmitInfo()
+            .setPNext(&timelineSubmitInfo)
             .setWaitSemaphoreCount(1)
             .setPWaitSemaphores(waitSemaphores)
             .setPWaitDstStageMask(waitStages)
             .setCommandBufferCount(1)
-            .setPCommandBuffers(&commandBuffers[currentFrame])
-            .setSignalSemaphoreCount(1)
+            .setPCommandBuffers(&commandBuffer)
+            .setSignalSemaphoreCount(2)
             .setPSignalSemaphores(signalSemaphores);
 
-    result = graphicsQueue.submit(1, &submitInfo, inFlightFences[currentFrame]);
+    result = graphicsQueue.submit(1, &submitInfo, VK_NULL_HANDLE);
     if (result != vk::Result::eSuccess) {
         throw std::runtime_error("Failed to submit draw command buffer! Error Code: " + vk::to_string(result));
     }
 
+    frameTimelineValues[currentFrame] = frameTimelineValue;
+
+    if (settings.frameStatistics) {
+        frameStatistics.submitFrame(frameTimelineValue);
+    }
+
+    if (settings.framePacing) {
+        framePacer.recordFrameWork(FramePacer::Clock::now() - frameStartTime);
+    }
+
     vk::SwapchainKHR swapChains[] = {swapChain};
 
     vk::PresentInfoKHR presentInfo = vk::PresentInfoKHR()
@@ -985,7 +2210,26 @@ void Application::drawFrame() {
             .setPImageIndices(&imageIndex)
             .setPResults(nullptr);
 
+    vk::PresentIdKHR presentId = vk::PresentIdKHR()
+            .setSwapchainCount(1)
+            .setPPresentIds(&frameTimelineValue);
+
+    if (presentWaitEnabled) {
+        presentInfo.setPNext(&presentId);
+        lastPresentId = frameTimelineValue;
+        lastPresentSwapChain = swapChain;
+    }
+
     result = presentQueue.presentKHR(&presentInfo);
+    frameCpuTime = std::chrono::steady_clock::now() - cpuStartTime;
+
+    if (result == vk::Result::eSuccess || result == vk::Result::eSuboptimalKHR) {
+        for (auto &retiredSwapChain: retiredSwapChains) {
+            if (retiredSwapChain.remainingPresents > 0) {
+                retiredSwapChain.remainingPresents--;
+            }
+        }
+    }
     if (result == vk::Result::eErrorOutOfDateKHR || result == vk::Result::eSuboptimalKHR || framebufferResized) {
         framebufferResized = false;
         recreateSwapChain();
@@ -993,36 +2237,86 @@ void Application::drawFrame() {
         throw std::runtime_error("Failed to present: present queue! Error Code: " + vk::to_string(result));
     }
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    currentFrame = (currentFrame + 1) % maxFramesInFlight;
 }
 
 void Application::createSyncObjects() {
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    imageAvailableSemaphores.resize(maxFramesInFlight);
+    frameTimelineValues.assign(maxFramesInFlight, 0);
 
     vk::SemaphoreCreateInfo semaphoreCreateInfo = vk::SemaphoreCreateInfo();
-    vk::FenceCreateInfo fenceCreateInfo = vk::FenceCreateInfo()
-            .setFlags(vk::FenceCreateFlagBits::eSignaled);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < maxFramesInFlight; i++) {
         vk::Result result = logicalDevice.createSemaphore(&semaphoreCreateInfo, nullptr, &imageAvailableSemaphores[i]);
         if (result != vk::Result::eSuccess) {
             throw std::runtime_error(
                     "Failed to create image available semaphore! Error Code: " + vk::to_string(result));
         }
+    }
+}
+
+void Application::createPresentSemaphores() {
+    renderFinishedSemaphores.resize(swapChainImages.size());
+
+    vk::SemaphoreCreateInfo semaphoreCreateInfo = vk::SemaphoreCreateInfo();
 
-        result = logicalDevice.createSemaphore(&semaphoreCreateInfo, nullptr, &renderFinishedSemaphores[i]);
+    for (size_t i = 0; i < swapChainImages.size(); i++) {
+        vk::Result result = logicalDevice.createSemaphore(&semaphoreCreateInfo, nullptr, &renderFinishedSemaphores[i]);
         if (result != vk::Result::eSuccess) {
             throw std::runtime_error(
                     "Failed to create render finished semaphore! Error Code: " + vk::to_string(result));
         }
+    }
+}
 
-        result = logicalDevice.createFence(&fenceCreateInfo, nullptr, &inFlightFences[i]);
-        if (result != vk::Result::eSuccess) {
-            throw std::runtime_error("Failed to create in-flight fence! Error Code: " + vk::to_string(result));
-        }
+void Application::createTimelineSemaphore() {
+    vk::SemaphoreTypeCreateInfo semaphoreTypeCreateInfo = vk::SemaphoreTypeCreateInfo()
+            .setSemaphoreType(vk::SemaphoreType::eTimeline)
+            .setInitialValue(0);
+
+    vk::SemaphoreCreateInfo semaphoreCreateInfo = vk::SemaphoreCreateInfo()
+            .setPNext(&semaphoreTypeCreateInfo);
+
+    vk::Result result = logicalDevice.createSemaphore(&semaphoreCreateInfo, nullptr, &timelineSemaphore);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create timeline semaphore! Error Code: " + vk::to_string(result));
+    }
+}
+
+uint64_t Application::signalNextTimelineValue() {
+    return ++timelineValue;
+}
+
+uint64_t Application::getCompletedTimelineValue() {
+    vk::Result result = logicalDevice.getSemaphoreCounterValue(timelineSemaphore, &completedTimelineValue);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to query timeline semaphore value! Error Code: " + vk::to_string(result));
+    }
+
+    return completedTimelineValue;
+}
+
+bool Application::isTimelineValueComplete(uint64_t value) {
+    // Only ask the driver when the cached value is not already far enough along
+    return value <= completedTimelineValue || value <= getCompletedTimelineValue();
+}
+
+void Application::waitForTimelineValue(uint64_t value) {
+    if (value <= completedTimelineValue) {
+        return;
+    }
+
+    vk::SemaphoreWaitInfo waitInfo = vk::SemaphoreWaitInfo()
+            .setSemaphoreCount(1)
+            .setPSemaphores(&timelineSemaphore)
+            .setPValues(&value);
+
+    vk::Result result = logicalDevice.waitSemaphores(&waitInfo, UINT64_MAX);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to wait for timeline semaphore! Error Code: " + vk::to_string(result));
     }
+
+    completedTimelineValue = std::max(completedTimelineValue, value);
 }
 
 void Application::recreateSwapChain() {
@@ -1035,35 +2329,120 @@ void Application::recreateSwapChain() {
         glfwWaitEvents();
     }
 
-    logicalDevice.waitIdle();
-
-    cleanupSwapChain();
+    // The old swapchain keeps presenting what is already queued while the new one is created from it; its resources
+    // are destroyed later from drawFrame instead of draining the GPU here
+    retireSwapChain();
 
-    createSwapChain();
+    createSwapChain(retiredSwapChains.back().swapChain);
     createImageViews();
+    createPresentSemaphores();
     createColorResources();
     createDepthResources();
-    createFramebuffers();
+    if (dynamicResolutionEnabled || multiviewEnabled) {
+        createSceneImage();
+    }
+    if (occlusionCullingEnabled) {
+        createDepthPyramid();
+    }
+    // Dynamic rendering references the image views directly, so a resize creates no framebuffers
+    if (!dynamicRenderingEnabled) {
+        createFramebuffers();
+    }
+
+    createCachedCommandBuffers();
+    invalidateCommandBuffers();
+    cameraDirty = true;
 }
 
-void Application::cleanupSwapChain() {
-    logicalDevice.destroyImageView(colorImageView);
-    logicalDevice.destroyImage(colorImage);
-    logicalDevice.freeMemory(colorImageMemory);
+void Application::retireSwapChain() {
+    // Every frame submitted so far may still reference these resources
+    for (auto commandBuffer: cachedCommandBuffers) {
+        deletionQueue.push(timelineValue, cachedCommandPool, commandBuffer);
+    }
+
+    for (auto framebuffer: swapChainFrameBuffers) {
+        deletionQueue.push(timelineValue, framebuffer);
+    }
+
+    for (auto imageView: swapChainImageViews) {
+        deletionQueue.push(timelineValue, imageView);
+    }
+
+    retireAttachments();
 
-    logicalDevice.destroyImageView(depthImageView);
-    logicalDevice.destroyImage(depthImage);
-    logicalDevice.freeMemory(depthImageMemory);
+    // Dynamic resolution may have been turned off by the new swapchain, so this goes by the image itself
+    if (sceneImage) {
+        deletionQueue.push(timelineValue, sceneImageView);
+        deletionQueue.push(timelineValue, sceneImage);
+        deferFreeDeviceMemory(timelineValue, sceneImageMemory);
+        sceneImage = nullptr;
+    }
 
-    for (auto swapChainFrameBuffer : swapChainFrameBuffers) {
-        logicalDevice.destroyFramebuffer(swapChainFrameBuffer);
+    if (occlusionCullingEnabled) {
+        retireDepthPyramid();
     }
 
-    for (auto swapChainImageView : swapChainImageViews) {
-        logicalDevice.destroyImageView(swapChainImageView);
+    RetiredSwapChain retiredSwapChain{};
+    retiredSwapChain.swapChain = swapChain;
+    retiredSwapChain.presentSemaphores = std::move(renderFinishedSemaphores);
+    retiredSwapChain.timelineValue = timelineValue;
+    // Presents of the old images are only known to be consumed once the new swapchain has presented a full round
+    // of frames in flight behind them
+    retiredSwapChain.remainingPresents = maxFramesInFlight;
+
+    retiredSwapChains.push_back(std::move(retiredSwapChain));
+
+    swapChainImageViews.clear();
+    swapChainFrameBuffers.clear();
+    renderFinishedSemaphores.clear();
+    cachedCommandBuffers.clear();
+}
+
+void Application::retireAttachments() {
+    deletionQueue.push(timelineValue, colorImageView);
+    deletionQueue.push(timelineValue, colorImage);
+    deferFreeDeviceMemory(timelineValue, colorImageMemory);
+
+    deletionQueue.push(timelineValue, depthImageView);
+    deletionQueue.push(timelineValue, depthImage);
+    deferFreeDeviceMemory(timelineValue, depthImageMemory);
+}
+
+void Application::destroyRetiredSwapChains(bool waitForCompletion) {
+    auto destroyable = [&](const RetiredSwapChain &retiredSwapChain) {
+        if (waitForCompletion) {
+            waitForTimelineValue(retiredSwapChain.timelineValue);
+            return true;
+        }
+
+        return retiredSwapChain.remainingPresents == 0 && isTimelineValueComplete(retiredSwapChain.timelineValue);
+    };
+
+    // Retired in order, so the oldest swapchain is always the first to become destroyable
+    size_t destroyedCount = 0;
+    while (destroyedCount < retiredSwapChains.size() && destroyable(retiredSwapChains[destroyedCount])) {
+        const RetiredSwapChain &retiredSwapChain = retiredSwapChains[destroyedCount];
+
+        for (auto semaphore: retiredSwapChain.presentSemaphores) {
+            logicalDevice.destroySemaphore(semaphore);
+        }
+
+        logicalDevice.destroySwapchainKHR(retiredSwapChain.swapChain);
+
+        destroyedCount++;
     }
 
-    logicalDevice.destroySwapchainKHR(swapChain);
+    retiredSwapChains.erase(retiredSwapChains.begin(), retiredSwapChains.begin() + destroyedCount);
+}
+
+void Application::cleanupSwapChain() {
+    retireSwapChain();
+
+    // The views of the swapchain images have to go before the swapchains themselves
+    waitForTimelineValue(timelineValue);
+    deletionQueue.flushAll(logicalDevice);
+
+    destroyRetiredSwapChains(true);
 }
 
 void Application::framebufferResizeCallback(GLFWwindow *window, int width, int height) {
@@ -1071,14 +2450,52 @@ void Application::framebufferResizeCallback(GLFWwindow *window, int width, int h
     app->framebufferResized = true;
 }
 
+void Application::keyCallback(GLFWwindow *window, int key, int scancode, int action, int mods) {
+    auto app = reinterpret_cast<Application *>(glfwGetWindowUserPointer(window));
+    app->frameStatistics.recordInput(FrameStatistics::Clock::now());
+}
+
+void Application::mouseButtonCallback(GLFWwindow *window, int button, int action, int mods) {
+    auto app = reinterpret_cast<Application *>(glfwGetWindowUserPointer(window));
+    app->frameStatistics.recordInput(FrameStatistics::Clock::now());
+}
+
+void Application::cursorPositionCallback(GLFWwindow *window, double x, double y) {
+    auto app = reinterpret_cast<Application *>(glfwGetWindowUserPointer(window));
+    app->frameStatistics.recordInput(FrameStatistics::Clock::now());
+}
+
+vk::DeviceSize Application::getVertexAttributesOffset() const {
+    // Rounded up so the second stream starts aligned for any attribute format
+    return (sizeof(VertexPosition) * vertices.size() + 15) & ~vk::DeviceSize(15);
+}
+
+vk::DeviceSize Application::getVertexBufferSize() const {
+    return getVertexAttributesOffset() + sizeof(VertexAttributes) * vertices.size();
+}
+
+void Application::writeVertexStreams(void *data) const {
+    auto *positions = static_cast<VertexPosition *>(data);
+    auto *attributes = reinterpret_cast<VertexAttributes *>(static_cast<char *>(data) + getVertexAttributesOffset());
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const Vertex &vertex = vertices[i];
+
+        positions[i] = {vertex.position.x, vertex.position.y, vertex.position.z};
+        attributes[i] = {{vertex.color.x, vertex.color.y, vertex.color.z},
+                         {vertex.textureCoordinates.x, vertex.textureCoordinates.y},
+                         {vertex.normal.x, vertex.normal.y, vertex.normal.z}};
+    }
+}
+
 void Application::createVertexBuffer() {
-    vk::DeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+    vk::DeviceSize bufferSize = getVertexBufferSize();
 
     vk::Buffer stagingBuffer;
     vk::DeviceMemory stagingBufferMemory;
     createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc,
-                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, stagingBuffer,
-                 stagingBufferMemory);
+                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                 MemoryCategory::Staging, stagingBuffer, stagingBufferMemory);
 
     void *data;
     vk::Result result = logicalDevice.mapMemory(stagingBufferMemory, 0, bufferSize, vk::MemoryMapFlags(), &data);
@@ -1086,15 +2503,15 @@ void Application::createVertexBuffer() {
         throw std::runtime_error("Failed to map vertex buffer memory! Error Code: " + vk::to_string(result));
     }
 
-    memcpy(data, vertices.data(), (size_t) bufferSize);
+    writeVertexStreams(data);
     logicalDevice.unmapMemory(stagingBufferMemory);
 
     createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
-                 vk::MemoryPropertyFlagBits::eDeviceLocal, vertexBuffer, vertexBufferMemory);
-    copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
+                 vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Geometry, vertexBuffer, vertexBufferMemory);
+    uint64_t uploadTimelineValue = copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
 
-    logicalDevice.destroyBuffer(stagingBuffer);
-    logicalDevice.freeMemory(stagingBufferMemory);
+    deletionQueue.push(uploadTimelineValue, stagingBuffer);
+    deferFreeDeviceMemory(uploadTimelineValue, stagingBufferMemory);
 }
 
 void Application::createIndexBuffer() {
@@ -1103,8 +2520,8 @@ void Application::createIndexBuffer() {
     vk::Buffer stagingBuffer;
     vk::DeviceMemory stagingBufferMemory;
     createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc,
-                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, stagingBuffer,
-                 stagingBufferMemory);
+                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                 MemoryCategory::Staging, stagingBuffer, stagingBufferMemory);
 
     void *data;
     vk::Result result = logicalDevice.mapMemory(stagingBufferMemory, 0, bufferSize, vk::MemoryMapFlags(), &data);
@@ -1116,11 +2533,11 @@ void Application::createIndexBuffer() {
     logicalDevice.unmapMemory(stagingBufferMemory);
 
     createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eIndexBuffer,
-                 vk::MemoryPropertyFlagBits::eDeviceLocal, indexBuffer, indexBufferMemory);
-    copyBuffer(stagingBuffer, indexBuffer, bufferSize);
+                 vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Geometry, indexBuffer, indexBufferMemory);
+    uint64_t uploadTimelineValue = copyBuffer(stagingBuffer, indexBuffer, bufferSize);
 
-    logicalDevice.destroyBuffer(stagingBuffer);
-    logicalDevice.freeMemory(stagingBufferMemory);
+    deletionQueue.push(uploadTimelineValue, stagingBuffer);
+    deferFreeDeviceMemory(uploadTimelineValue, stagingBufferMemory);
 }
 
 uint32_t Application::findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) {
@@ -1137,8 +2554,22 @@ uint32_t Application::findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlag
     throw std::runtime_error("Failed to find suitable memory type!");
 }
 
+bool Application::hasMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags properties) {
+    vk::PhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
+    physicalDevice.getMemoryProperties(&physicalDeviceMemoryProperties);
+
+    for (uint32_t i = 0; i < physicalDeviceMemoryProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) &&
+            (physicalDeviceMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void Application::createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
-                               vk::Buffer &buffer, vk::DeviceMemory &bufferMemory) {
+                               MemoryCategory category, vk::Buffer &buffer, vk::DeviceMemory &bufferMemory) {
     vk::BufferCreateInfo bufferCreateInfo = vk::BufferCreateInfo()
             .setSize(size)
             .setUsage(usage)
@@ -1152,33 +2583,88 @@ void Application::createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage,
     vk::MemoryRequirements memoryRequirements;
     logicalDevice.getBufferMemoryRequirements(buffer, &memoryRequirements);
 
-    vk::MemoryAllocateInfo memoryAllocateInfo = vk::MemoryAllocateInfo()
-            .setAllocationSize(memoryRequirements.size)
-            .setMemoryTypeIndex(findMemoryType(memoryRequirements.memoryTypeBits, properties));
-
-    result = logicalDevice.allocateMemory(&memoryAllocateInfo, nullptr, &bufferMemory);
-    if (result != vk::Result::eSuccess) {
-        throw std::runtime_error("Failed to allocate buffer memory! Error Code: " + vk::to_string(result));
+    try {
+        bufferMemory = allocateDeviceMemory(memoryRequirements, properties, category);
+    }
+    catch (...) {
+        logicalDevice.destroyBuffer(buffer);
+        throw;
     }
 
     logicalDevice.bindBufferMemory(buffer, bufferMemory, 0);
 }
 
-void Application::copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size) {
-    vk::CommandBuffer commandBuffer = beginSingleTimeCommands();
+vk::DeviceMemory Application::allocateDeviceMemory(const vk::MemoryRequirements &memoryRequirements,
+                                                   vk::MemoryPropertyFlags properties, MemoryCategory category) {
+    uint32_t memoryTypeIndex = findMemoryType(memoryRequirements.memoryTypeBits, properties);
 
-    vk::BufferCopy copyRegion = vk::BufferCopy().setSize(size);
-    commandBuffer.copyBuffer(srcBuffer, dstBuffer, 1, &copyRegion);
+    vk::MemoryAllocateInfo memoryAllocateInfo = vk::MemoryAllocateInfo()
+            .setAllocationSize(memoryRequirements.size)
+            .setMemoryTypeIndex(memoryTypeIndex);
 
-    endSingleTimeCommands(commandBuffer);
-}
+    vk::DeviceMemory memory;
+    vk::Result result = logicalDevice.allocateMemory(&memoryAllocateInfo, nullptr, &memory);
 
-void Application::createDescriptorSetLayout() {
-    vk::DescriptorSetLayoutBinding uboLayoutBinding = vk::DescriptorSetLayoutBinding()
-            .setBinding(0)
-            .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+    // Out of memory is not fatal while something can still be evicted. This path waits for the GPU, since evicted
+    // memory is only released once nothing uses it any more
+    while (result == vk::Result::eErrorOutOfDeviceMemory && !evictionInProgress) {
+        Texture *evictable = findEvictableTexture();
+        if (!evictable || !dropTextureMipLevel(*evictable)) {
+            break;
+        }
+
+        waitForTimelineValue(timelineValue);
+        deletionQueue.flush(logicalDevice, getCompletedTimelineValue());
+
+        result = logicalDevice.allocateMemory(&memoryAllocateInfo, nullptr, &memory);
+    }
+
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to allocate " + std::string(MemoryBudget::getCategoryName(category)) +
+                                 " memory! Error Code: " + vk::to_string(result));
+    }
+
+    memoryBudget.trackAllocation(memory, category, memoryTypeIndex, memoryRequirements.size);
+
+    return memory;
+}
+
+void Application::freeDeviceMemory(vk::DeviceMemory memory) {
+    memoryBudget.trackFree(memory);
+    logicalDevice.freeMemory(memory);
+}
+
+void Application::deferFreeDeviceMemory(uint64_t timelineValue, vk::DeviceMemory memory) {
+    deletionQueue.push(timelineValue, [this, memory](vk::Device) { freeDeviceMemory(memory); });
+}
+
+uint64_t Application::copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size) {
+    vk::CommandBuffer commandBuffer = beginSingleTimeCommands();
+
+    vk::BufferCopy copyRegion = vk::BufferCopy().setSize(size);
+    commandBuffer.copyBuffer(srcBuffer, dstBuffer, 1, &copyRegion);
+
+    // Nothing waits for the upload on the CPU any more, so later submissions rely on this barrier to see the copy
+    vk::MemoryBarrier2 uploadBarrier = vk::MemoryBarrier2()
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eCopy)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eAllCommands)
+            .setDstAccessMask(vk::AccessFlagBits2::eMemoryRead);
+
+    vk::DependencyInfo dependencyInfo = vk::DependencyInfo()
+            .setMemoryBarrierCount(1)
+            .setPMemoryBarriers(&uploadBarrier);
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+
+    return endSingleTimeCommands(commandBuffer);
+}
+
+void Application::createDescriptorSetLayout() {
+    vk::DescriptorSetLayoutBinding uboLayoutBinding = vk::DescriptorSetLayoutBinding()
+            .setBinding(0)
+            .setDescriptorType(vk::DescriptorType::eUniformBuffer)
             .setDescriptorCount(1)
-            .setStageFlags(vk::ShaderStageFlagBits::eVertex)
+            .setStageFlags(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment)
             .setPImmutableSamplers(nullptr);
 
     vk::DescriptorSetLayoutBinding samplerLayoutBinding = vk::DescriptorSetLayoutBinding()
@@ -1188,7 +2674,31 @@ void Application::createDescriptorSetLayout() {
             .setPImmutableSamplers(nullptr)
             .setStageFlags(vk::ShaderStageFlagBits::eFragment);
 
-    std::array<vk::DescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+    vk::DescriptorSetLayoutBinding instanceLayoutBinding = vk::DescriptorSetLayoutBinding()
+            .setBinding(2)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setPImmutableSamplers(nullptr)
+            .setStageFlags(vk::ShaderStageFlagBits::eVertex);
+
+    // The lights and the frame slot's clusters
+    vk::DescriptorSetLayoutBinding lightLayoutBinding = vk::DescriptorSetLayoutBinding()
+            .setBinding(3)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setPImmutableSamplers(nullptr)
+            .setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+    vk::DescriptorSetLayoutBinding clusterLayoutBinding = vk::DescriptorSetLayoutBinding()
+            .setBinding(4)
+            .setDescriptorCount(1)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setPImmutableSamplers(nullptr)
+            .setStageFlags(vk::ShaderStageFlagBits::eFragment);
+
+    std::array<vk::DescriptorSetLayoutBinding, 5> bindings = {uboLayoutBinding, samplerLayoutBinding,
+                                                              instanceLayoutBinding, lightLayoutBinding,
+                                                              clusterLayoutBinding};
     vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = vk::DescriptorSetLayoutCreateInfo()
             .setBindingCount(static_cast<uint32_t>(bindings.size()))
             .setPBindings(bindings.data());
@@ -1197,134 +2707,1431 @@ void Application::createDescriptorSetLayout() {
     if (result != vk::Result::eSuccess) {
         throw std::runtime_error("Failed to create descriptor set layout! Error Code: " + vk::to_string(result));
     }
+
+    if (!bindlessEnabled) {
+        return;
+    }
+
+    // Samplers, the texture array, and the indirect buffer the GPU-driven path reads materials from. Entries past
+    // the loaded textures, and the indirect buffer on the CPU path, are never written
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindlessBindings = {
+            vk::DescriptorSetLayoutBinding()
+                    .setBinding(0)
+                    .setDescriptorType(vk::DescriptorType::eSampler)
+                    .setDescriptorCount(BINDLESS_SAMPLER_COUNT)
+                    .setStageFlags(vk::ShaderStageFlagBits::eFragment),
+            vk::DescriptorSetLayoutBinding()
+                    .setBinding(1)
+                    .setDescriptorType(vk::DescriptorType::eSampledImage)
+                    .setDescriptorCount(bindlessTextureCapacity)
+                    .setStageFlags(vk::ShaderStageFlagBits::eFragment),
+            vk::DescriptorSetLayoutBinding()
+                    .setBinding(2)
+                    .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                    .setDescriptorCount(1)
+                    .setStageFlags(vk::ShaderStageFlagBits::eVertex)
+    };
+
+    std::array<vk::DescriptorBindingFlags, 3> bindlessBindingFlags = {
+            vk::DescriptorBindingFlags(),
+            vk::DescriptorBindingFlagBits::ePartiallyBound | vk::DescriptorBindingFlagBits::eUpdateAfterBind,
+            vk::DescriptorBindingFlagBits::ePartiallyBound
+    };
+
+    vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo = vk::DescriptorSetLayoutBindingFlagsCreateInfo()
+            .setBindingCount(static_cast<uint32_t>(bindlessBindingFlags.size()))
+            .setPBindingFlags(bindlessBindingFlags.data());
+
+    layoutCreateInfo = vk::DescriptorSetLayoutCreateInfo()
+            .setPNext(&bindingFlagsCreateInfo)
+            .setFlags(vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool)
+            .setBindingCount(static_cast<uint32_t>(bindlessBindings.size()))
+            .setPBindings(bindlessBindings.data());
+
+    result = logicalDevice.createDescriptorSetLayout(&layoutCreateInfo, nullptr, &bindlessSetLayout);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create descriptor set layout! Error Code: " + vk::to_string(result));
+    }
+}
+
+void Application::createUniformBuffers() {
+    vk::DeviceSize bufferSize = sizeof(UniformBufferObject);
+
+    uniformBuffers.resize(maxFramesInFlight);
+    uniformBuffersMemory.resize(maxFramesInFlight);
+    uniformBuffersMapped.resize(maxFramesInFlight);
+
+    vk::Result result;
+
+    for (size_t i = 0; i < maxFramesInFlight; i++) {
+        createBuffer(bufferSize, vk::BufferUsageFlagBits::eUniformBuffer,
+                     vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                     MemoryCategory::Uniforms, uniformBuffers[i], uniformBuffersMemory[i]);
+        result = logicalDevice.mapMemory(uniformBuffersMemory[i], 0, bufferSize, vk::MemoryMapFlags(),
+                                         &uniformBuffersMapped[i]);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to map uniform buffer memory! Error Code: " + vk::to_string(result));
+        }
+    }
+}
+
+void Application::updateUniformBuffer(uint32_t currentImage) {
+    // The camera backs off as the scene grows, matching the original view for a single instance. It only moves when
+    // the instances or the aspect ratio change
+    if (cameraDirty) {
+        float distance = std::max(2.0f, 0.8f * getSceneExtent());
+        cameraPosition = glm::vec3(distance);
+        cameraFarPlane = std::max(100.0f, 4.0f * distance);
+
+        vk::Extent2D viewExtent = getViewExtent();
+        cameraView = glm::lookAt(cameraPosition, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        cameraProjection = glm::perspective(glm::radians(45.0f), viewExtent.width / (float) viewExtent.height,
+                                            CAMERA_NEAR_PLANE, cameraFarPlane);
+        cameraProjection[1][1] *= -1;
+
+        // Multiview cameras look the same way from points spaced along the camera's right axis, left to right and
+        // centered on the camera, which the lighting clusters and the draw order keep using
+        glm::vec3 right = glm::vec3(cameraView[0][0], cameraView[1][0], cameraView[2][0]);
+        float spacing = VIEW_SPACING * distance;
+        for (uint32_t view = 0; view < viewCount; view++) {
+            float offset = spacing * (static_cast<float>(view) - 0.5f * static_cast<float>(viewCount - 1));
+            cameraViewProjections[view] = cameraProjection * glm::translate(cameraView, -offset * right);
+        }
+
+        // The cameras only differ along the right axis, which is parallel to the top, bottom, near and far planes,
+        // so the union of their frustums is bounded by the first camera's left plane and the last camera's right plane
+        cameraFrustum = FrustumCuller::extractFrustum(&cameraViewProjections[0][0][0]);
+        cameraFrustum[1] = FrustumCuller::extractFrustum(&cameraViewProjections[viewCount - 1][0][0])[1];
+        cameraDirty = false;
+    }
+
+    UniformBufferObject ubo;
+    ubo.view = cameraView;
+    ubo.projection = cameraProjection;
+    ubo.lightCount = lightCount;
+    ubo.viewportSize = glm::vec2(renderExtent.width, renderExtent.height);
+    ubo.depthRange = glm::vec2(CAMERA_NEAR_PLANE, cameraFarPlane);
+    std::copy(cameraViewProjections.begin(), cameraViewProjections.end(), ubo.viewProjections);
+
+    memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+}
+
+void Application::createDrawCommandPipeline() {
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i] = vk::DescriptorSetLayoutBinding()
+                .setBinding(i)
+                .setDescriptorCount(1)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    }
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = vk::DescriptorSetLayoutCreateInfo()
+            .setBindingCount(static_cast<uint32_t>(bindings.size()))
+            .setPBindings(bindings.data());
+
+    vk::Result result = logicalDevice.createDescriptorSetLayout(&layoutCreateInfo, nullptr, &drawCommandSetLayout);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create descriptor set layout! Error Code: " + vk::to_string(result));
+    }
+
+    vk::PushConstantRange pushConstantRange = vk::PushConstantRange()
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+            .setOffset(0)
+            .setSize(sizeof(uint32_t));
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = vk::PipelineLayoutCreateInfo()
+            .setSetLayoutCount(1)
+            .setPSetLayouts(&drawCommandSetLayout)
+            .setPushConstantRangeCount(1)
+            .setPPushConstantRanges(&pushConstantRange);
+
+    result = logicalDevice.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &drawCommandPipelineLayout);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create pipeline layout! Error Code: " + vk::to_string(result));
+    }
+
+    auto computeShaderCode = readFile("resources/shaders/compiled/draw_commands.spv");
+    vk::ShaderModule computeShaderModule = createShaderModule(computeShaderCode);
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo = vk::ComputePipelineCreateInfo()
+            .setStage(vk::PipelineShaderStageCreateInfo()
+                              .setStage(vk::ShaderStageFlagBits::eCompute)
+                              .setModule(computeShaderModule)
+                              .setPName("main"))
+            .setLayout(drawCommandPipelineLayout);
+
+    result = logicalDevice.createComputePipelines(VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &drawCommandPipeline);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create compute pipeline! Error Code: " + vk::to_string(result));
+    }
+
+    logicalDevice.destroyShaderModule(computeShaderModule);
+}
+
+void Application::createMeshBuffer() {
+    vk::DeviceSize bufferSize = sizeof(drawCommands[0]) * drawCommands.size();
+
+    vk::Buffer stagingBuffer;
+    vk::DeviceMemory stagingBufferMemory;
+    createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc,
+                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                 MemoryCategory::Staging, stagingBuffer, stagingBufferMemory);
+
+    void *data;
+    vk::Result result = logicalDevice.mapMemory(stagingBufferMemory, 0, bufferSize, vk::MemoryMapFlags(), &data);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to map mesh buffer memory! Error Code: " + vk::to_string(result));
+    }
+
+    memcpy(data, drawCommands.data(), (size_t) bufferSize);
+    logicalDevice.unmapMemory(stagingBufferMemory);
+
+    createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
+                 vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Geometry, meshBuffer, meshBufferMemory);
+    uint64_t uploadTimelineValue = copyBuffer(stagingBuffer, meshBuffer, bufferSize);
+
+    deletionQueue.push(uploadTimelineValue, stagingBuffer);
+    deferFreeDeviceMemory(uploadTimelineValue, stagingBufferMemory);
+}
+
+void Application::createDrawCommandBuffers() {
+    objectBuffers.resize(maxFramesInFlight);
+    objectBuffersMemory.resize(maxFramesInFlight);
+    objectBuffersMapped.resize(maxFramesInFlight);
+    indirectBuffers.resize(maxFramesInFlight);
+    indirectBuffersMemory.resize(maxFramesInFlight);
+    if (occlusionCullingEnabled) {
+        occlusionBuffers.resize(maxFramesInFlight);
+        occlusionBuffersMemory.resize(maxFramesInFlight);
+    }
+    drawCommandBufferCapacities.assign(maxFramesInFlight, 0);
+
+    for (uint32_t i = 0; i < maxFramesInFlight; i++) {
+        ensureDrawCommandBufferCapacity(i);
+    }
+}
+
+void Application::ensureDrawCommandBufferCapacity(uint32_t frameIndex) {
+    if (drawCommandBufferCapacities[frameIndex] >= objectCount) {
+        return;
+    }
+
+    // Only this slot's finished submissions used the old buffers
+    if (indirectBuffers[frameIndex]) {
+        deletionQueue.push(frameTimelineValues[frameIndex], objectBuffers[frameIndex]);
+        deferFreeDeviceMemory(frameTimelineValues[frameIndex], objectBuffersMemory[frameIndex]);
+        deletionQueue.push(frameTimelineValues[frameIndex], indirectBuffers[frameIndex]);
+        deferFreeDeviceMemory(frameTimelineValues[frameIndex], indirectBuffersMemory[frameIndex]);
+    }
+
+    uint32_t capacity = std::max(objectCount, drawCommandBufferCapacities[frameIndex] * 2);
+
+    // The visible object list is rewritten by the CPU every frame after culling
+    vk::DeviceSize objectBufferSize = sizeof(ObjectData) * capacity;
+    createBuffer(objectBufferSize, vk::BufferUsageFlagBits::eStorageBuffer,
+                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                 MemoryCategory::Instances, objectBuffers[frameIndex], objectBuffersMemory[frameIndex]);
+
+    vk::Result result = logicalDevice.mapMemory(objectBuffersMemory[frameIndex], 0, objectBufferSize,
+                                                vk::MemoryMapFlags(), &objectBuffersMapped[frameIndex]);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to map object buffer memory! Error Code: " + vk::to_string(result));
+    }
+
+    vk::DeviceSize indirectBufferSize = INDIRECT_COMMANDS_OFFSET + sizeof(IndirectDraw) * capacity;
+    createBuffer(indirectBufferSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+                                     vk::BufferUsageFlagBits::eTransferDst,
+                 vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Instances, indirectBuffers[frameIndex],
+                 indirectBuffersMemory[frameIndex]);
+
+    if (occlusionCullingEnabled) {
+        if (occlusionBuffers[frameIndex]) {
+            deletionQueue.push(frameTimelineValues[frameIndex], occlusionBuffers[frameIndex]);
+            deferFreeDeviceMemory(frameTimelineValues[frameIndex], occlusionBuffersMemory[frameIndex]);
+        }
+
+        // Counters followed by the retest list, which holds at most every object of the frame
+        createBuffer(OCCLUSION_RETEST_OFFSET + sizeof(uint32_t) * capacity,
+                     vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst |
+                     vk::BufferUsageFlagBits::eTransferSrc,
+                     vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Instances, occlusionBuffers[frameIndex],
+                     occlusionBuffersMemory[frameIndex]);
+    }
+
+    drawCommandBufferCapacities[frameIndex] = capacity;
+
+    if (!descriptorSets.empty()) {
+        updateDescriptorSet(frameIndex);
+        invalidateCommandBuffers();
+    }
+}
+
+void Application::recordDrawCommandGeneration(vk::CommandBuffer commandBuffer) {
+    vk::Buffer indirectBuffer = indirectBuffers[currentFrame];
+
+    commandBuffer.fillBuffer(indirectBuffer, 0, sizeof(uint32_t), 0);
+
+    vk::BufferMemoryBarrier2 clearBarrier = vk::BufferMemoryBarrier2()
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eClear)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite)
+            .setBuffer(indirectBuffer)
+            .setOffset(0)
+            .setSize(sizeof(uint32_t));
+
+    vk::DependencyInfo dependencyInfo = vk::DependencyInfo()
+            .setBufferMemoryBarrierCount(1)
+            .setPBufferMemoryBarriers(&clearBarrier);
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, drawCommandPipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, drawCommandPipelineLayout, 0, 1,
+                                     &drawCommandDescriptorSets[currentFrame], 0, nullptr);
+    commandBuffer.pushConstants(drawCommandPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, sizeof(uint32_t),
+                                &visibleObjectCount);
+    commandBuffer.dispatch((visibleObjectCount + 63) / 64, 1, 1);
+
+    // The bindless vertex shader also reads each draw's material from the draw list, through gl_DrawID
+    vk::BufferMemoryBarrier2 indirectBarrier = vk::BufferMemoryBarrier2()
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eShaderStorageRead)
+            .setBuffer(indirectBuffer)
+            .setOffset(0)
+            .setSize(VK_WHOLE_SIZE);
+
+    dependencyInfo.setPBufferMemoryBarriers(&indirectBarrier);
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+}
+
+void Application::createLightBinningPipeline() {
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i] = vk::DescriptorSetLayoutBinding()
+                .setBinding(i)
+                .setDescriptorCount(1)
+                .setDescriptorType(i == 0 ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+                .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    }
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = vk::DescriptorSetLayoutCreateInfo()
+            .setBindingCount(static_cast<uint32_t>(bindings.size()))
+            .setPBindings(bindings.data());
+
+    vk::Result result = logicalDevice.createDescriptorSetLayout(&layoutCreateInfo, nullptr, &lightBinningSetLayout);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create descriptor set layout! Error Code: " + vk::to_string(result));
+    }
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = vk::PipelineLayoutCreateInfo()
+            .setSetLayoutCount(1)
+            .setPSetLayouts(&lightBinningSetLayout);
+
+    result = logicalDevice.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &lightBinningPipelineLayout);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create pipeline layout! Error Code: " + vk::to_string(result));
+    }
+
+    auto computeShaderCode = readFile("resources/shaders/compiled/light_binning.spv");
+    vk::ShaderModule computeShaderModule = createShaderModule(computeShaderCode);
+
+    vk::ComputePipelineCreateInfo pipelineCreateInfo = vk::ComputePipelineCreateInfo()
+            .setStage(vk::PipelineShaderStageCreateInfo()
+                              .setStage(vk::ShaderStageFlagBits::eCompute)
+                              .setModule(computeShaderModule)
+                              .setPName("main"))
+            .setLayout(lightBinningPipelineLayout);
+
+    result = logicalDevice.createComputePipelines(VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr,
+                                                  &lightBinningPipeline);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create compute pipeline! Error Code: " + vk::to_string(result));
+    }
+
+    logicalDevice.destroyShaderModule(computeShaderModule);
+}
+
+void Application::createLightBuffers() {
+    clusterBuffers.resize(maxFramesInFlight);
+    clusterBuffersMemory.resize(maxFramesInFlight);
+
+    // A count per cluster, then each cluster's index slots
+    vk::DeviceSize clusterBufferSize = sizeof(uint32_t) * CLUSTER_COUNT * (1 + MAX_LIGHTS_PER_CLUSTER);
+    for (uint32_t i = 0; i < maxFramesInFlight; i++) {
+        createBuffer(clusterBufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
+                     vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Lights, clusterBuffers[i],
+                     clusterBuffersMemory[i]);
+    }
+
+    setLightCount(settings.lightCount);
+}
+
+void Application::setLightCount(uint32_t count) {
+    // Scattered over the instance grid, up to a unit above the models. Radii shrink as the lights get denser, so
+    // about the same number reaches any point whatever the count. The buffer holds at least one light, as it is bound
+    // either way
+    std::vector<PointLight> lights(std::max(count, 1u));
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    float extent = std::max(getSceneExtent(), 2.5f);
+    float radius = std::max(2.0f * extent / std::sqrt(static_cast<float>(lights.size())), 0.1f);
+
+    for (auto &light: lights) {
+        light = {{(unit(random) - 0.5f) * extent, (unit(random) - 0.5f) * extent, unit(random)}, radius,
+                 {0.2f + 0.8f * unit(random), 0.2f + 0.8f * unit(random), 0.2f + 0.8f * unit(random)}, 1.0f};
+    }
+
+    vk::DeviceSize bufferSize = sizeof(PointLight) * lights.size();
+
+    vk::Buffer stagingBuffer;
+    vk::DeviceMemory stagingBufferMemory;
+    createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferSrc,
+                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                 MemoryCategory::Staging, stagingBuffer, stagingBufferMemory);
+
+    void *data;
+    vk::Result result = logicalDevice.mapMemory(stagingBufferMemory, 0, bufferSize, vk::MemoryMapFlags(), &data);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to map light buffer memory! Error Code: " + vk::to_string(result));
+    }
+
+    memcpy(data, lights.data(), (size_t) bufferSize);
+    logicalDevice.unmapMemory(stagingBufferMemory);
+
+    // Every frame submitted so far may still read the old lights
+    if (lightBuffer) {
+        deletionQueue.push(timelineValue, lightBuffer);
+        deferFreeDeviceMemory(timelineValue, lightBufferMemory);
+    }
+
+    createBuffer(bufferSize, vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
+                 vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Lights, lightBuffer, lightBufferMemory);
+    uint64_t uploadTimelineValue = copyBuffer(stagingBuffer, lightBuffer, bufferSize);
+
+    deletionQueue.push(uploadTimelineValue, stagingBuffer);
+    deferFreeDeviceMemory(uploadTimelineValue, stagingBufferMemory);
+
+    lightCount = count;
+
+    // Each slot rewrites its sets before its next frame. The binning pass is only recorded with lights
+    descriptorGeneration++;
+    invalidateCommandBuffers();
+}
+
+void Application::recordLightBinning(vk::CommandBuffer commandBuffer) {
+    // Without lights, or with multiview shading every light, the fragment shaders don't read the clusters
+    if (lightCount == 0 || multiviewEnabled) {
+        return;
+    }
+
+    // Lights append themselves to the clusters they reach, so the counts start from zero
+    commandBuffer.fillBuffer(clusterBuffers[currentFrame], 0, sizeof(uint32_t) * CLUSTER_COUNT, 0);
+
+    vk::BufferMemoryBarrier2 clearBarrier = vk::BufferMemoryBarrier2()
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eClear)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite)
+            .setBuffer(clusterBuffers[currentFrame])
+            .setOffset(0)
+            .setSize(sizeof(uint32_t) * CLUSTER_COUNT);
+
+    vk::DependencyInfo clearDependencyInfo = vk::DependencyInfo()
+            .setBufferMemoryBarrierCount(1)
+            .setPBufferMemoryBarriers(&clearBarrier);
+    commandBuffer.pipelineBarrier2(&clearDependencyInfo);
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, lightBinningPipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, lightBinningPipelineLayout, 0, 1,
+                                     &lightBinningDescriptorSets[currentFrame], 0, nullptr);
+    commandBuffer.dispatch((lightCount + 63) / 64, 1, 1);
+
+    vk::BufferMemoryBarrier2 clusterBarrier = vk::BufferMemoryBarrier2()
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eFragmentShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead)
+            .setBuffer(clusterBuffers[currentFrame])
+            .setOffset(0)
+            .setSize(VK_WHOLE_SIZE);
+
+    vk::DependencyInfo dependencyInfo = vk::DependencyInfo()
+            .setBufferMemoryBarrierCount(1)
+            .setPBufferMemoryBarriers(&clusterBarrier);
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+}
+
+void Application::createFrameQueries() {
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+    gpuTimer.initialize(logicalDevice, physicalDevice, queueFamilyIndices.graphicsFamily.value(), maxFramesInFlight,
+                        {"light binning", "depth pre-pass", "shading"});
+    fragmentCounter.initialize(logicalDevice, pipelineStatisticsEnabled, maxFramesInFlight);
+
+    // The swapchain keeps its transfer usage, which costs nothing
+    if (dynamicResolutionEnabled && !gpuTimer.isSupported()) {
+        std::cerr << "GPU timestamps unavailable: rendering at full resolution" << std::endl;
+        dynamicResolutionEnabled = false;
+        updateRenderExtent();
+    }
+}
+
+void Application::collectFrameQueries(uint32_t frameIndex) {
+    // The slot's previous frame has completed, so its queries are final
+    if (gpuTimer.collect(logicalDevice, frameIndex)) {
+        frameGpuTime = std::chrono::duration<double, std::milli>(gpuTimer.getLastFrameMilliseconds());
+
+        if (dynamicResolutionEnabled) {
+            updateRenderScale(gpuTimer.getLastFrameMilliseconds());
+        }
+    }
+
+    fragmentCounter.collect(logicalDevice, frameIndex);
+}
+
+void Application::updateRenderScale(double gpuMilliseconds) {
+    // The render area, viewport and scissor are recorded into the command buffers
+    if (resolutionController.recordFrame(gpuMilliseconds)) {
+        updateRenderExtent();
+        invalidateCommandBuffers();
+    }
+
+    ResolutionController::SampleRequest request = resolutionController.takeSampleRequest();
+    if (!settings.dynamicMsaa || request == ResolutionController::SampleRequest::None) {
+        return;
+    }
+
+    vk::PhysicalDeviceLimits limits = physicalDevice.getProperties().limits;
+    vk::SampleCountFlags supportedCounts = limits.framebufferColorSampleCounts & limits.framebufferDepthSampleCounts;
+    auto maximumCount = static_cast<uint32_t>(getMaxUsableSampleCount());
+
+    // Halve or double, skipping counts the attachments don't support. Rendering always resolves the color
+    // attachment, which needs at least two samples
+    auto sampleCount = static_cast<uint32_t>(msaaSamples);
+    do {
+        sampleCount = request == ResolutionController::SampleRequest::Fewer ? sampleCount >> 1 : sampleCount << 1;
+    } while (sampleCount >= 2 && sampleCount <= maximumCount &&
+             !(supportedCounts & static_cast<vk::SampleCountFlagBits>(sampleCount)));
+
+    if (sampleCount >= 2 && sampleCount <= maximumCount) {
+        setSampleCount(static_cast<vk::SampleCountFlagBits>(sampleCount));
+    }
+}
+
+void Application::updateRenderExtent() {
+    vk::Extent2D viewExtent = getViewExtent();
+    if (!dynamicResolutionEnabled) {
+        renderExtent = viewExtent;
+        return;
+    }
+
+    float scale = resolutionController.getScale();
+    renderExtent = vk::Extent2D(std::max(1u, static_cast<uint32_t>(std::lround(viewExtent.width * scale))),
+                                std::max(1u, static_cast<uint32_t>(std::lround(viewExtent.height * scale))));
+}
+
+vk::Extent2D Application::getViewExtent() const {
+    // Views are laid out side by side, each in its column of the swapchain image
+    return {std::max(1u, swapChainExtent.width / viewCount), swapChainExtent.height};
+}
+
+uint32_t Application::getViewMask() const {
+    // Without multiview a view mask of 0 renders the single layer as usual
+    return multiviewEnabled ? (1u << viewCount) - 1 : 0;
+}
+
+void Application::setSampleCount(vk::SampleCountFlagBits sampleCount) {
+    // Frames in flight still render with the old attachments and pipelines
+    retireAttachments();
+    retireGraphicsPipelines();
+
+    msaaSamples = sampleCount;
+    createColorResources();
+    createDepthResources();
+    createGraphicsPipeline();
+
+    // Shading cost changes with the sample count by an amount the controller can't predict
+    resolutionController.restartMeasurement();
+}
+
+void Application::createInstanceBuffers() {
+    instanceCount = sceneInstances.empty() ? settings.instanceCount : static_cast<uint32_t>(sceneInstances.size());
+    buildInstanceHierarchy();
+
+    instanceBuffers.resize(maxFramesInFlight);
+    instanceBuffersMemory.resize(maxFramesInFlight);
+    instanceBuffersMapped.resize(maxFramesInFlight);
+    instanceBufferCapacities.assign(maxFramesInFlight, 0);
+
+    for (uint32_t i = 0; i < maxFramesInFlight; i++) {
+        ensureInstanceBufferCapacity(i);
+    }
+}
+
+void Application::ensureInstanceBufferCapacity(uint32_t frameIndex) {
+    if (instanceBufferCapacities[frameIndex] >= instanceCount) {
+        return;
+    }
+
+    // Only this slot's finished submissions used the old buffer
+    if (instanceBuffers[frameIndex]) {
+        deletionQueue.push(frameTimelineValues[frameIndex], instanceBuffers[frameIndex]);
+        deferFreeDeviceMemory(frameTimelineValues[frameIndex], instanceBuffersMemory[frameIndex]);
+    }
+
+    // Grow geometrically so a rising instance count does not reallocate every frame
+    uint32_t capacity = std::max(instanceCount, instanceBufferCapacities[frameIndex] * 2);
+    vk::DeviceSize bufferSize = sizeof(glm::mat4) * capacity;
+
+    createBuffer(bufferSize, vk::BufferUsageFlagBits::eStorageBuffer,
+                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                 MemoryCategory::Instances, instanceBuffers[frameIndex], instanceBuffersMemory[frameIndex]);
+
+    vk::Result result = logicalDevice.mapMemory(instanceBuffersMemory[frameIndex], 0, bufferSize, vk::MemoryMapFlags(),
+                                                &instanceBuffersMapped[frameIndex]);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to map instance buffer memory! Error Code: " + vk::to_string(result));
+    }
+
+    instanceBufferCapacities[frameIndex] = capacity;
+    instanceBufferVersions[frameIndex] = 0;
+
+    // Descriptor sets do not exist yet while the buffers are first created
+    if (!descriptorSets.empty()) {
+        updateDescriptorSet(frameIndex);
+        invalidateCommandBuffers();
+    }
+}
+
+void Application::buildInstanceHierarchy() {
+    transformHierarchy.clear();
+    uint32_t root = transformHierarchy.addNode(TransformHierarchy::NO_PARENT);
+
+    // Scene instances hang off the root with their own transforms, and their objects were listed as the scene loaded
+    if (!sceneInstances.empty()) {
+        firstInstanceNode = transformHierarchy.getNodeCount();
+        for (const SceneDescription::Instance &instance: sceneInstances) {
+            uint32_t node = transformHierarchy.addNode(root);
+            transformHierarchy.setLocalTranslation(node, instance.translation[0], instance.translation[1],
+                                                   instance.translation[2]);
+            transformHierarchy.setLocalRotation(node, instance.rotation[0], instance.rotation[1],
+                                                instance.rotation[2], instance.rotation[3]);
+            transformHierarchy.setLocalScale(node, instance.scale);
+        }
+    } else {
+        buildInstanceGrid(root);
+    }
+
+    objectCount = static_cast<uint32_t>(objects.size());
+    frustumCuller.resize(objectCount);
+
+    // Every slot's buffer and the culler's spheres are rewritten in full, and the camera frames the new instances
+    instanceBufferVersions.assign(maxFramesInFlight, 0);
+    cullingSphereVersion = 0;
+    cameraDirty = true;
+}
+
+void Application::buildInstanceGrid(uint32_t root) {
+    // One node per grid row under the root, then the instances of each row. Breadth-first, the instances come last
+    // and in instance order, so they map straight onto the instance buffer
+    float spacing = 2.5f;
+    sceneExtent = spacing * std::ceil(std::sqrt(static_cast<float>(instanceCount)));
+
+    uint32_t gridSide = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(instanceCount))));
+    uint32_t rowCount = (instanceCount + gridSide - 1) / gridSide;
+    float gridOrigin = -0.5f * spacing * static_cast<float>(gridSide - 1);
+
+    uint32_t firstRowNode = transformHierarchy.getNodeCount();
+    for (uint32_t row = 0; row < rowCount; row++) {
+        uint32_t node = transformHierarchy.addNode(root);
+        transformHierarchy.setLocalTranslation(node, gridOrigin, gridOrigin + spacing * static_cast<float>(row), 0.0f);
+    }
+
+    firstInstanceNode = transformHierarchy.getNodeCount();
+    for (uint32_t i = 0; i < instanceCount; i++) {
+        uint32_t node = transformHierarchy.addNode(firstRowNode + i / gridSide);
+        transformHierarchy.setLocalTranslation(node, spacing * static_cast<float>(i % gridSide), 0.0f, 0.0f);
+    }
+    setInstanceRotations(0.0f);
+
+    // Every mesh is drawn at every instance
+    objects.resize(size_t(instanceCount) * drawCommands.size());
+    for (uint32_t mesh = 0; mesh < drawCommands.size(); mesh++) {
+        for (uint32_t i = 0; i < instanceCount; i++) {
+            objects[size_t(mesh) * instanceCount + i] = {mesh, i};
+        }
+    }
+}
+
+void Application::setInstanceRotations(float time) {
+    float speed = 0.25f;
+
+    // Each instance spins about Z with its own phase
+    uint32_t rangeCount = std::min(instanceCount, threadPool->getThreadCount() * 4);
+    threadPool->parallelFor(rangeCount, [&](uint32_t rangeIndex) {
+        uint32_t first = static_cast<uint32_t>(uint64_t(instanceCount) * rangeIndex / rangeCount);
+        uint32_t last = static_cast<uint32_t>(uint64_t(instanceCount) * (rangeIndex + 1) / rangeCount);
+
+        for (uint32_t i = first; i < last; i++) {
+            float angle = (time * speed) * glm::radians(90.0f) + 0.37f * static_cast<float>(i);
+            transformHierarchy.setLocalRotation(firstInstanceNode + i, 0.0f, 0.0f, std::sin(0.5f * angle),
+                                                std::cos(0.5f * angle));
+        }
+    });
+}
+
+void Application::updateInstanceBuffer(uint32_t frameIndex) {
+    // Without animation the instances keep their first pose and the hierarchy has nothing to recompute. Scene
+    // instances always keep theirs
+    if (settings.animate && sceneInstances.empty()) {
+        setInstanceRotations(std::chrono::duration<float, std::chrono::seconds::period>(
+                std::chrono::high_resolution_clock::now() - animationStartTime).count());
+    }
+
+    // The instances are written straight into the slot's buffer as they are recomputed. A slot's buffer only needs
+    // the matrices that changed since the slot last ran
+    TransformHierarchy::WorldOutput instanceOutput{static_cast<float *>(instanceBuffersMapped[frameIndex]),
+                                                   firstInstanceNode, instanceCount, instanceBufferVersions[frameIndex]};
+    transformHierarchy.update(*threadPool, &instanceOutput);
+    instanceBufferVersions[frameIndex] = transformHierarchy.getVersion();
+
+    // Instance scales are uniform, so only the spheres of objects whose instance moved change, and their radius
+    // scales with the length of any axis
+    uint32_t rangeCount = std::min(objectCount, threadPool->getThreadCount() * 4);
+    threadPool->parallelFor(rangeCount, [&](uint32_t rangeIndex) {
+        uint32_t first = static_cast<uint32_t>(uint64_t(objectCount) * rangeIndex / rangeCount);
+        uint32_t last = static_cast<uint32_t>(uint64_t(objectCount) * (rangeIndex + 1) / rangeCount);
+
+        for (uint32_t objectIndex = first; objectIndex < last; objectIndex++) {
+            const ObjectData &object = objects[objectIndex];
+            uint32_t node = firstInstanceNode + object.transformIndex;
+            if (transformHierarchy.getWorldVersion(node) <= cullingSphereVersion) {
+                continue;
+            }
+
+            glm::mat4 model;
+            memcpy(&model, transformHierarchy.getWorldMatrix(node), sizeof(model));
+
+            const glm::vec4 &sphere = drawCommands[object.meshIndex].boundingSphere;
+            glm::vec4 center = model * glm::vec4(glm::vec3(sphere), 1.0f);
+            frustumCuller.setSphere(objectIndex, center.x, center.y, center.z,
+                                    sphere.w * glm::length(glm::vec3(model[0])));
+        }
+    });
+    cullingSphereVersion = transformHierarchy.getVersion();
+}
+
+void Application::setInstanceCount(uint32_t count) {
+    // The draw's instance count is baked into recorded command buffers; buffers grow when each slot next runs
+    instanceCount = count;
+    buildInstanceHierarchy();
+    invalidateCommandBuffers();
+}
+
+void Application::cullObjects(uint32_t frameIndex) {
+    if (settings.frustumCulling) {
+        frustumCuller.cull(cameraFrustum, *threadPool);
+    } else {
+        frustumCuller.cullNone();
+    }
+
+    const std::vector<uint32_t> &visibleObjects = frustumCuller.getVisibleObjects();
+
+    // The GPU-driven path takes the visible list as is, with only its length baked into the command buffer
+    if (gpuDrivenEnabled) {
+        auto *mappedObjects = static_cast<ObjectData *>(objectBuffersMapped[frameIndex]);
+        for (size_t i = 0; i < visibleObjects.size(); i++) {
+            mappedObjects[i] = objects[visibleObjects[i]];
+        }
+
+        // Visible objects are ordered by mesh, so each mesh's texture is stamped once per run
+        uint32_t previousMesh = UINT32_MAX;
+        for (uint32_t objectIndex: visibleObjects) {
+            if (objects[objectIndex].meshIndex != previousMesh) {
+                previousMesh = objects[objectIndex].meshIndex;
+                textures[drawCommands[previousMesh].textureIndex].lastUsedFrame = frameNumber;
+            }
+        }
+
+        if (visibleObjectCount != visibleObjects.size()) {
+            visibleObjectCount = static_cast<uint32_t>(visibleObjects.size());
+            invalidateCommandBuffers();
+        }
+
+        if (occlusionCullingEnabled) {
+            occlusionSubmittedObjectCounts[frameIndex] = visibleObjectCount;
+        }
+        return;
+    }
+
+    // Otherwise runs of consecutive visible instances of a mesh become one instanced draw, so with nothing culled
+    // this is still one draw per mesh. Without instancing every object is a draw of its own
+    std::vector<VisibleDraw> draws;
+    for (uint32_t objectIndex: visibleObjects) {
+        uint32_t meshIndex = objects[objectIndex].meshIndex;
+        uint32_t instance = objects[objectIndex].transformIndex;
+
+        if (settings.instancing && !draws.empty() && draws.back().meshIndex == meshIndex &&
+            draws.back().firstInstance + draws.back().instanceCount == instance) {
+            draws.back().instanceCount++;
+        } else {
+            draws.push_back({meshIndex, instance, 1, 0});
+        }
+    }
+
+    // Textures of meshes outside the frustum keep their older stamp, so eviction reduces them first
+    for (const auto &draw: draws) {
+        textures[drawCommands[draw.meshIndex].textureIndex].lastUsedFrame = frameNumber;
+    }
+
+    sortDraws(draws);
+
+    if (draws != visibleDraws) {
+        visibleDraws = std::move(draws);
+        invalidateCommandBuffers();
+    }
+}
+
+void Application::sortDraws(std::vector<VisibleDraw> &draws) {
+    // The depth bucket is the distance from the camera to a run's first instance, so runs of one material are drawn
+    // roughly front to back. Every draw is in the main pass; the pipeline field holds its permutation flags, to which
+    // recording adds the frame's lighting mode
+    float depthScale = static_cast<float>((1u << DrawSorter::DEPTH_BITS) - 1) / cameraFarPlane;
+
+    drawSortEntries.resize(draws.size());
+    uint32_t rangeCount = static_cast<uint32_t>(std::min<size_t>(draws.size(), threadPool->getThreadCount() * 4));
+    threadPool->parallelFor(rangeCount, [&](uint32_t rangeIndex) {
+        size_t first = draws.size() * rangeIndex / rangeCount;
+        size_t last = draws.size() * (rangeIndex + 1) / rangeCount;
+
+        for (size_t i = first; i < last; i++) {
+            const float *model = transformHierarchy.getWorldMatrix(firstInstanceNode + draws[i].firstInstance);
+            float depth = glm::length(glm::vec3(model[12], model[13], model[14]) - cameraPosition) * depthScale;
+            auto depthBucket = static_cast<uint32_t>(std::clamp(depth, 0.0f, depthScale * cameraFarPlane));
+
+            drawSortEntries[i] = {DrawSorter::makeKey(0, getDrawPermutation(draws[i].meshIndex),
+                                                      drawCommands[draws[i].meshIndex].textureIndex,
+                                                      draws[i].meshIndex, depthBucket),
+                                  static_cast<uint32_t>(i)};
+        }
+    });
+
+    drawSorter.sort(drawSortEntries, *threadPool);
+
+    std::vector<VisibleDraw> sortedDraws(draws.size());
+    for (size_t i = 0; i < drawSortEntries.size(); i++) {
+        sortedDraws[i] = draws[drawSortEntries[i].draw];
+        sortedDraws[i].sortKey = drawSortEntries[i].key;
+    }
+    draws = std::move(sortedDraws);
+}
+
+float Application::getSceneExtent() const {
+    return sceneExtent;
+}
+
+void Application::createDescriptorPool() {
+    // Set 0 holds the camera, texture and three storage buffers, and the light binning set the camera and two
+    // storage buffers. The draw command sets add three storage buffers per frame slot, and the occlusion culling sets
+    // five storage buffers, the camera and the depth pyramid
+    uint32_t setsPerFrame = 2 + (gpuDrivenEnabled ? 1 : 0) + (occlusionCullingEnabled ? 1 : 0);
+    uint32_t uniformBuffersPerFrame = 2 + (occlusionCullingEnabled ? 1 : 0);
+    uint32_t samplersPerFrame = occlusionCullingEnabled ? 2 : 1;
+    uint32_t storageBuffersPerFrame = 5 + (gpuDrivenEnabled ? 3 : 0) + (occlusionCullingEnabled ? 5 : 0);
+
+    std::array<vk::DescriptorPoolSize, 3> poolSizes{};
+    poolSizes[0] = vk::DescriptorPoolSize()
+            .setType(vk::DescriptorType::eUniformBuffer)
+            .setDescriptorCount(static_cast<uint32_t>(maxFramesInFlight) * uniformBuffersPerFrame);
+    poolSizes[1] = vk::DescriptorPoolSize()
+            .setType(vk::DescriptorType::eCombinedImageSampler)
+            .setDescriptorCount(static_cast<uint32_t>(maxFramesInFlight) * samplersPerFrame);
+
+    poolSizes[2] = vk::DescriptorPoolSize()
+            .setType(vk::DescriptorType::eStorageBuffer)
+            .setDescriptorCount(static_cast<uint32_t>(maxFramesInFlight) * storageBuffersPerFrame);
+
+    vk::DescriptorPoolCreateInfo poolCreateInfo = vk::DescriptorPoolCreateInfo()
+            .setPoolSizeCount(static_cast<uint32_t>(poolSizes.size()))
+            .setPPoolSizes(poolSizes.data())
+            .setMaxSets(static_cast<uint32_t>(maxFramesInFlight) * setsPerFrame);
+
+    vk::Result result = logicalDevice.createDescriptorPool(&poolCreateInfo, nullptr, &descriptorPool);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create descriptor pool! Error Code: " + vk::to_string(result));
+    }
+
+    if (!bindlessEnabled) {
+        return;
+    }
+
+    // Update-after-bind sets need a pool created for them
+    std::array<vk::DescriptorPoolSize, 3> bindlessPoolSizes = {
+            vk::DescriptorPoolSize(vk::DescriptorType::eSampler, maxFramesInFlight * BINDLESS_SAMPLER_COUNT),
+            vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, maxFramesInFlight * bindlessTextureCapacity),
+            vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, maxFramesInFlight)
+    };
+
+    poolCreateInfo = vk::DescriptorPoolCreateInfo()
+            .setFlags(vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind)
+            .setPoolSizeCount(static_cast<uint32_t>(bindlessPoolSizes.size()))
+            .setPPoolSizes(bindlessPoolSizes.data())
+            .setMaxSets(static_cast<uint32_t>(maxFramesInFlight));
+
+    result = logicalDevice.createDescriptorPool(&poolCreateInfo, nullptr, &bindlessDescriptorPool);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create descriptor pool! Error Code: " + vk::to_string(result));
+    }
+}
+
+void Application::createDescriptorSets() {
+    std::vector<vk::DescriptorSetLayout> layouts(maxFramesInFlight, descriptorSetLayout);
+
+    vk::DescriptorSetAllocateInfo allocateInfo = vk::DescriptorSetAllocateInfo()
+            .setDescriptorPool(descriptorPool)
+            .setDescriptorSetCount(static_cast<uint32_t>(maxFramesInFlight))
+            .setPSetLayouts(layouts.data());
+
+    descriptorSets.resize(maxFramesInFlight);
+
+    vk::Result result = logicalDevice.allocateDescriptorSets(&allocateInfo, descriptorSets.data());
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to allocate descriptor sets! Error Code: " + vk::to_string(result));
+    }
+
+    std::vector<vk::DescriptorSetLayout> lightBinningLayouts(maxFramesInFlight, lightBinningSetLayout);
+    allocateInfo.setPSetLayouts(lightBinningLayouts.data());
+
+    lightBinningDescriptorSets.resize(maxFramesInFlight);
+
+    result = logicalDevice.allocateDescriptorSets(&allocateInfo, lightBinningDescriptorSets.data());
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to allocate descriptor sets! Error Code: " + vk::to_string(result));
+    }
+
+    if (gpuDrivenEnabled) {
+        std::vector<vk::DescriptorSetLayout> drawCommandLayouts(maxFramesInFlight, drawCommandSetLayout);
+        allocateInfo.setPSetLayouts(drawCommandLayouts.data());
+
+        drawCommandDescriptorSets.resize(maxFramesInFlight);
+
+        result = logicalDevice.allocateDescriptorSets(&allocateInfo, drawCommandDescriptorSets.data());
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to allocate descriptor sets! Error Code: " + vk::to_string(result));
+        }
+    }
+
+    if (occlusionCullingEnabled) {
+        std::vector<vk::DescriptorSetLayout> occlusionCullLayouts(maxFramesInFlight, occlusionCullSetLayout);
+        allocateInfo.setPSetLayouts(occlusionCullLayouts.data());
+
+        occlusionCullDescriptorSets.resize(maxFramesInFlight);
+
+        result = logicalDevice.allocateDescriptorSets(&allocateInfo, occlusionCullDescriptorSets.data());
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to allocate descriptor sets! Error Code: " + vk::to_string(result));
+        }
+    }
+
+    if (bindlessEnabled) {
+        std::vector<vk::DescriptorSetLayout> bindlessLayouts(maxFramesInFlight, bindlessSetLayout);
+        allocateInfo.setDescriptorPool(bindlessDescriptorPool)
+                .setPSetLayouts(bindlessLayouts.data());
+
+        bindlessDescriptorSets.resize(maxFramesInFlight);
+
+        result = logicalDevice.allocateDescriptorSets(&allocateInfo, bindlessDescriptorSets.data());
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to allocate descriptor sets! Error Code: " + vk::to_string(result));
+        }
+
+        bindlessTextureGenerations.assign(maxFramesInFlight, textureGeneration);
+
+        // The sampler never changes and its binding is not update-after-bind, so it is written once here. Later
+        // updates only touch the texture array, which leaves recorded command buffers valid
+        std::array<vk::DescriptorImageInfo, BINDLESS_SAMPLER_COUNT> samplerInfos = {
+                vk::DescriptorImageInfo().setSampler(textureSampler)
+        };
+
+        std::vector<vk::WriteDescriptorSet> samplerWrites(maxFramesInFlight);
+        for (uint32_t i = 0; i < maxFramesInFlight; i++) {
+            samplerWrites[i] = vk::WriteDescriptorSet()
+                    .setDstSet(bindlessDescriptorSets[i])
+                    .setDstBinding(0)
+                    .setDstArrayElement(0)
+                    .setDescriptorType(vk::DescriptorType::eSampler)
+                    .setDescriptorCount(static_cast<uint32_t>(samplerInfos.size()))
+                    .setPImageInfo(samplerInfos.data());
+        }
+
+        logicalDevice.updateDescriptorSets(static_cast<uint32_t>(samplerWrites.size()), samplerWrites.data(), 0,
+                                           nullptr);
+    }
+
+    descriptorSetGenerations.assign(maxFramesInFlight, descriptorGeneration);
+
+    for (uint32_t i = 0; i < maxFramesInFlight; i++) {
+        updateDescriptorSet(i);
+        if (bindlessEnabled) {
+            updateBindlessTextures(i);
+        }
+    }
+}
+
+void Application::updateDescriptorSet(uint32_t frameIndex) {
+    vk::DescriptorBufferInfo bufferInfo = vk::DescriptorBufferInfo()
+            .setBuffer(uniformBuffers[frameIndex])
+            .setOffset(0)
+            .setRange(sizeof(UniformBufferObject));
+
+    vk::DescriptorImageInfo imageInfo = vk::DescriptorImageInfo()
+            .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
+            .setImageView(textures[0].view)
+            .setSampler(textureSampler);
+
+    vk::DescriptorBufferInfo instanceBufferInfo = vk::DescriptorBufferInfo()
+            .setBuffer(instanceBuffers[frameIndex])
+            .setOffset(0)
+            .setRange(VK_WHOLE_SIZE);
+
+    vk::DescriptorBufferInfo lightBufferInfo(lightBuffer, 0, VK_WHOLE_SIZE);
+    vk::DescriptorBufferInfo clusterBufferInfo(clusterBuffers[frameIndex], 0, VK_WHOLE_SIZE);
+
+    std::array<vk::WriteDescriptorSet, 5> descriptorWrites{};
+
+    descriptorWrites[0] = vk::WriteDescriptorSet()
+            .setDstSet(descriptorSets[frameIndex])
+            .setDstBinding(0)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eUniformBuffer)
+            .setDescriptorCount(1)
+            .setPBufferInfo(&bufferInfo);
+
+    descriptorWrites[1] = vk::WriteDescriptorSet()
+            .setDstSet(descriptorSets[frameIndex])
+            .setDstBinding(1)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+            .setDescriptorCount(1)
+            .setPImageInfo(&imageInfo);
+
+    descriptorWrites[2] = vk::WriteDescriptorSet()
+            .setDstSet(descriptorSets[frameIndex])
+            .setDstBinding(2)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setDescriptorCount(1)
+            .setPBufferInfo(&instanceBufferInfo);
+
+    descriptorWrites[3] = vk::WriteDescriptorSet()
+            .setDstSet(descriptorSets[frameIndex])
+            .setDstBinding(3)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setDescriptorCount(1)
+            .setPBufferInfo(&lightBufferInfo);
+
+    descriptorWrites[4] = vk::WriteDescriptorSet()
+            .setDstSet(descriptorSets[frameIndex])
+            .setDstBinding(4)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+            .setDescriptorCount(1)
+            .setPBufferInfo(&clusterBufferInfo);
+
+    // Bindless pipelines never read the single texture binding, so it is left unwritten rather than pointing at a
+    // view that a mip drop may destroy
+    uint32_t writeCount = static_cast<uint32_t>(descriptorWrites.size());
+    if (bindlessEnabled) {
+        std::rotate(descriptorWrites.begin() + 1, descriptorWrites.begin() + 2, descriptorWrites.end());
+        writeCount--;
+    }
+
+    logicalDevice.updateDescriptorSets(writeCount, descriptorWrites.data(), 0, nullptr);
+
+    std::array<vk::DescriptorBufferInfo, 3> lightBinningBufferInfos = {
+            vk::DescriptorBufferInfo(uniformBuffers[frameIndex], 0, sizeof(UniformBufferObject)),
+            lightBufferInfo,
+            clusterBufferInfo
+    };
+
+    std::array<vk::WriteDescriptorSet, 3> lightBinningWrites{};
+    for (uint32_t i = 0; i < lightBinningWrites.size(); i++) {
+        lightBinningWrites[i] = vk::WriteDescriptorSet()
+                .setDstSet(lightBinningDescriptorSets[frameIndex])
+                .setDstBinding(i)
+                .setDstArrayElement(0)
+                .setDescriptorType(i == 0 ? vk::DescriptorType::eUniformBuffer : vk::DescriptorType::eStorageBuffer)
+                .setDescriptorCount(1)
+                .setPBufferInfo(&lightBinningBufferInfos[i]);
+    }
+
+    logicalDevice.updateDescriptorSets(static_cast<uint32_t>(lightBinningWrites.size()), lightBinningWrites.data(), 0,
+                                       nullptr);
+
+    if (bindlessEnabled && gpuDrivenEnabled) {
+        vk::DescriptorBufferInfo indirectBufferInfo(indirectBuffers[frameIndex], 0, VK_WHOLE_SIZE);
+
+        vk::WriteDescriptorSet indirectWrite = vk::WriteDescriptorSet()
+                .setDstSet(bindlessDescriptorSets[frameIndex])
+                .setDstBinding(2)
+                .setDstArrayElement(0)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setDescriptorCount(1)
+                .setPBufferInfo(&indirectBufferInfo);
+
+        logicalDevice.updateDescriptorSets(1, &indirectWrite, 0, nullptr);
+    }
+
+    if (gpuDrivenEnabled) {
+        std::array<vk::DescriptorBufferInfo, 3> drawCommandBufferInfos = {
+                vk::DescriptorBufferInfo(meshBuffer, 0, VK_WHOLE_SIZE),
+                vk::DescriptorBufferInfo(objectBuffers[frameIndex], 0, VK_WHOLE_SIZE),
+                vk::DescriptorBufferInfo(indirectBuffers[frameIndex], 0, VK_WHOLE_SIZE)
+        };
+
+        vk::WriteDescriptorSet drawCommandWrite = vk::WriteDescriptorSet()
+                .setDstSet(drawCommandDescriptorSets[frameIndex])
+                .setDstBinding(0)
+                .setDstArrayElement(0)
+                .setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                .setDescriptorCount(static_cast<uint32_t>(drawCommandBufferInfos.size()))
+                .setPBufferInfo(drawCommandBufferInfos.data());
+
+        logicalDevice.updateDescriptorSets(1, &drawCommandWrite, 0, nullptr);
+    }
+
+    if (occlusionCullingEnabled) {
+        vk::DescriptorBufferInfo cameraInfo(uniformBuffers[frameIndex], 0, sizeof(UniformBufferObject));
+        vk::DescriptorBufferInfo instanceInfo(instanceBuffers[frameIndex], 0, VK_WHOLE_SIZE);
+        vk::DescriptorBufferInfo occlusionInfo(occlusionBuffers[frameIndex], 0, VK_WHOLE_SIZE);
+        vk::DescriptorImageInfo depthPyramidInfo(depthPyramidSampler, depthPyramidView, vk::ImageLayout::eGeneral);
+
+        std::array<vk::DescriptorBufferInfo, 3> drawCommandBufferInfos = {
+                vk::DescriptorBufferInfo(meshBuffer, 0, VK_WHOLE_SIZE),
+                vk::DescriptorBufferInfo(objectBuffers[frameIndex], 0, VK_WHOLE_SIZE),
+                vk::DescriptorBufferInfo(indirectBuffers[frameIndex], 0, VK_WHOLE_SIZE)
+        };
+
+        vk::WriteDescriptorSet write = vk::WriteDescriptorSet()
+                .setDstSet(occlusionCullDescriptorSets[frameIndex])
+                .setDstArrayElement(0)
+                .setDescriptorCount(1);
+
+        std::array<vk::WriteDescriptorSet, 5> occlusionWrites = {
+                vk::WriteDescriptorSet(write).setDstBinding(0).setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                        .setDescriptorCount(static_cast<uint32_t>(drawCommandBufferInfos.size()))
+                        .setPBufferInfo(drawCommandBufferInfos.data()),
+                vk::WriteDescriptorSet(write).setDstBinding(3).setDescriptorType(vk::DescriptorType::eUniformBuffer)
+                        .setPBufferInfo(&cameraInfo),
+                vk::WriteDescriptorSet(write).setDstBinding(4).setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                        .setPBufferInfo(&instanceInfo),
+                vk::WriteDescriptorSet(write).setDstBinding(5)
+                        .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                        .setPImageInfo(&depthPyramidInfo),
+                vk::WriteDescriptorSet(write).setDstBinding(6).setDescriptorType(vk::DescriptorType::eStorageBuffer)
+                        .setPBufferInfo(&occlusionInfo)
+        };
+
+        logicalDevice.updateDescriptorSets(static_cast<uint32_t>(occlusionWrites.size()), occlusionWrites.data(), 0,
+                                           nullptr);
+    }
+
+    descriptorSetGenerations[frameIndex] = descriptorGeneration;
+}
+
+void Application::updateBindlessTextures(uint32_t frameIndex) {
+    // The material index of a draw is its texture's index here
+    uint32_t textureCount = std::min(static_cast<uint32_t>(textures.size()), bindlessTextureCapacity);
+    std::vector<vk::DescriptorImageInfo> textureInfos(textureCount);
+    for (uint32_t i = 0; i < textureCount; i++) {
+        textureInfos[i] = vk::DescriptorImageInfo()
+                .setImageView(textures[i].view)
+                .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
+    }
+
+    // Only the update-after-bind texture array is written; the sampler was written when the set was allocated
+    vk::WriteDescriptorSet write = vk::WriteDescriptorSet()
+            .setDstSet(bindlessDescriptorSets[frameIndex])
+            .setDstBinding(1)
+            .setDstArrayElement(0)
+            .setDescriptorType(vk::DescriptorType::eSampledImage)
+            .setDescriptorCount(textureCount)
+            .setPImageInfo(textureInfos.data());
+
+    logicalDevice.updateDescriptorSets(1, &write, 0, nullptr);
+    bindlessTextureGenerations[frameIndex] = textureGeneration;
+}
+
+void Application::enforceMemoryBudget() {
+    if (memoryBudget.getDeviceLocalOverBudget() == 0 || !isTimelineValueComplete(lastEvictionTimelineValue)) {
+        return;
+    }
+
+    // One step per frame: the largest mip of the least recently used texture that still has one to spare
+    Texture *evictable = findEvictableTexture();
+    if (evictable && dropTextureMipLevel(*evictable)) {
+        return;
+    }
+
+    if (!geometryInHostMemory) {
+        demoteGeometryToHostMemory();
+    }
+}
+
+Application::Texture *Application::findEvictableTexture() {
+    // Least recently drawn first, and of textures last drawn in the same frame the largest
+    Texture *evictable = nullptr;
+    for (auto &texture: textures) {
+        if (texture.mipLevels > 1 && (!evictable || texture.lastUsedFrame < evictable->lastUsedFrame ||
+                                      (texture.lastUsedFrame == evictable->lastUsedFrame &&
+                                       texture.width * texture.height > evictable->width * evictable->height))) {
+            evictable = &texture;
+        }
+    }
+
+    return evictable;
 }
 
-void Application::createUniformBuffers() {
-    vk::DeviceSize bufferSize = sizeof(UniformBufferObject);
+bool Application::dropTextureMipLevel(Texture &texture) {
+    if (texture.mipLevels <= 1) {
+        return false;
+    }
 
-    uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    Texture reduced = texture;
+    reduced.width = std::max(texture.width / 2, 1u);
+    reduced.height = std::max(texture.height / 2, 1u);
+    reduced.mipLevels = texture.mipLevels - 1;
+    reduced.droppedMipLevels = texture.droppedMipLevels + 1;
+
+    // The copy is made from the old image, so both exist until it completes. When device memory is exhausted the
+    // smaller copy goes to host memory instead, which the GPU can still sample, so the old image can be released
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst |
+                                vk::ImageUsageFlagBits::eSampled;
+    evictionInProgress = true;
+    try {
+        createImage(reduced.width, reduced.height, reduced.mipLevels, vk::SampleCountFlagBits::e1,
+                    vk::Format::eR8G8B8A8Srgb, vk::ImageTiling::eOptimal, usage,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Textures, reduced.image, reduced.memory);
+    }
+    catch (const std::runtime_error &) {
+        try {
+            createImage(reduced.width, reduced.height, reduced.mipLevels, vk::SampleCountFlagBits::e1,
+                        vk::Format::eR8G8B8A8Srgb, vk::ImageTiling::eOptimal, usage,
+                        vk::MemoryPropertyFlagBits::eHostVisible, MemoryCategory::Textures, reduced.image,
+                        reduced.memory);
+        }
+        catch (const std::runtime_error &) {
+            // Not even the smaller copy fits anywhere right now; the caller moves on to other measures
+            evictionInProgress = false;
+            return false;
+        }
+    }
+    evictionInProgress = false;
 
-    vk::Result result;
+    imageLayoutTracker.registerImage(reduced.image, vk::ImageAspectFlagBits::eColor, reduced.mipLevels, 1);
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        createBuffer(bufferSize, vk::BufferUsageFlagBits::eUniformBuffer,
-                     vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-                     uniformBuffers[i], uniformBuffersMemory[i]);
-        result = logicalDevice.mapMemory(uniformBuffersMemory[i], 0, bufferSize, vk::MemoryMapFlags(),
-                                         &uniformBuffersMapped[i]);
-        if (result != vk::Result::eSuccess) {
-            throw std::runtime_error("Failed to map uniform buffer memory! Error Code: " + vk::to_string(result));
-        }
+    // Every level except the largest is copied down by one, so the texture is never re-read from disk
+    vk::CommandBuffer commandBuffer = beginSingleTimeCommands();
+
+    imageLayoutTracker.transition(commandBuffer, texture.image,
+                                  vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 1, reduced.mipLevels, 0, 1),
+                                  vk::ImageLayout::eTransferSrcOptimal);
+    imageLayoutTracker.transition(commandBuffer, reduced.image,
+                                  vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, reduced.mipLevels, 0, 1),
+                                  vk::ImageLayout::eTransferDstOptimal);
+    imageLayoutTracker.flush(commandBuffer);
+
+    std::vector<vk::ImageCopy> regions;
+    for (uint32_t level = 0; level < reduced.mipLevels; level++) {
+        regions.push_back(vk::ImageCopy()
+                                  .setSrcSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level + 1, 0, 1))
+                                  .setDstSubresource(vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1))
+                                  .setExtent(vk::Extent3D(std::max(reduced.width >> level, 1u),
+                                                          std::max(reduced.height >> level, 1u), 1)));
     }
-}
 
-void Application::updateUniformBuffer(uint32_t currentImage) {
-    static auto startTime = std::chrono::high_resolution_clock::now();
-    auto currentTime = std::chrono::high_resolution_clock::now();
+    commandBuffer.copyImage(texture.image, vk::ImageLayout::eTransferSrcOptimal,
+                            reduced.image, vk::ImageLayout::eTransferDstOptimal,
+                            static_cast<uint32_t>(regions.size()), regions.data());
 
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-    float speed = 0.25f;
+    imageLayoutTracker.transition(commandBuffer, reduced.image,
+                                  vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, reduced.mipLevels, 0, 1),
+                                  vk::ImageLayout::eShaderReadOnlyOptimal);
+    imageLayoutTracker.flush(commandBuffer);
 
-    UniformBufferObject ubo;
-    ubo.model = glm::rotate(glm::mat4(1.0f), (time * speed) * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-    ubo.projection = glm::perspective(glm::radians(45.0f), swapChainExtent.width / (float) swapChainExtent.height, 0.1f,
-                                      100.0f);
-    ubo.projection[1][1] *= -1;
+    uint64_t evictionTimelineValue = endSingleTimeCommands(commandBuffer);
 
-    memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+    reduced.view = createImageView(reduced.image, vk::Format::eR8G8B8A8Srgb, vk::ImageAspectFlagBits::eColor,
+                                   reduced.mipLevels);
+
+    // Frames already submitted still sample the old image; later ones pick up the new view through the refreshed
+    // descriptor sets
+    imageLayoutTracker.unregisterImage(texture.image);
+    deletionQueue.push(evictionTimelineValue, texture.view);
+    deletionQueue.push(evictionTimelineValue, texture.image);
+    deferFreeDeviceMemory(evictionTimelineValue, texture.memory);
+
+    texture = reduced;
+    if (bindlessEnabled) {
+        textureGeneration++;
+    } else {
+        descriptorGeneration++;
+    }
+    lastEvictionTimelineValue = evictionTimelineValue;
+
+    return true;
 }
 
-void Application::createDescriptorPool() {
-    std::array<vk::DescriptorPoolSize, 2> poolSizes{};
-    poolSizes[0] = vk::DescriptorPoolSize()
-            .setType(vk::DescriptorType::eUniformBuffer)
-            .setDescriptorCount(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
-    poolSizes[1] = vk::DescriptorPoolSize()
-            .setType(vk::DescriptorType::eCombinedImageSampler)
-            .setDescriptorCount(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+void Application::demoteGeometryToHostMemory() {
+    // Host-visible memory is filled straight from the CPU copies of the mesh, so no staging or copy is needed
+    vk::DeviceSize vertexBufferSize = getVertexBufferSize();
+    vk::DeviceSize indexBufferSize = sizeof(indices[0]) * indices.size();
 
-    vk::DescriptorPoolCreateInfo poolCreateInfo = vk::DescriptorPoolCreateInfo()
-            .setPoolSizeCount(static_cast<uint32_t>(poolSizes.size()))
-            .setPPoolSizes(poolSizes.data())
-            .setMaxSets(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT));
+    vk::Buffer hostVertexBuffer;
+    vk::DeviceMemory hostVertexBufferMemory;
+    createBuffer(vertexBufferSize, vk::BufferUsageFlagBits::eVertexBuffer,
+                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                 MemoryCategory::Geometry, hostVertexBuffer, hostVertexBufferMemory);
 
-    vk::Result result = logicalDevice.createDescriptorPool(&poolCreateInfo, nullptr, &descriptorPool);
+    vk::Buffer hostIndexBuffer;
+    vk::DeviceMemory hostIndexBufferMemory;
+    createBuffer(indexBufferSize, vk::BufferUsageFlagBits::eIndexBuffer,
+                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                 MemoryCategory::Geometry, hostIndexBuffer, hostIndexBufferMemory);
+
+    void *data;
+    vk::Result result = logicalDevice.mapMemory(hostVertexBufferMemory, 0, vertexBufferSize, vk::MemoryMapFlags(), &data);
     if (result != vk::Result::eSuccess) {
-        throw std::runtime_error("Failed to create descriptor pool! Error Code: " + vk::to_string(result));
+        throw std::runtime_error("Failed to map vertex buffer memory! Error Code: " + vk::to_string(result));
+    }
+    writeVertexStreams(data);
+    logicalDevice.unmapMemory(hostVertexBufferMemory);
+
+    result = logicalDevice.mapMemory(hostIndexBufferMemory, 0, indexBufferSize, vk::MemoryMapFlags(), &data);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to map index buffer memory! Error Code: " + vk::to_string(result));
     }
+    memcpy(data, indices.data(), (size_t) indexBufferSize);
+    logicalDevice.unmapMemory(hostIndexBufferMemory);
+
+    // Every submitted frame may still read the device-local copies
+    deletionQueue.push(timelineValue, vertexBuffer);
+    deferFreeDeviceMemory(timelineValue, vertexBufferMemory);
+    deletionQueue.push(timelineValue, indexBuffer);
+    deferFreeDeviceMemory(timelineValue, indexBufferMemory);
+
+    vertexBuffer = hostVertexBuffer;
+    vertexBufferMemory = hostVertexBufferMemory;
+    indexBuffer = hostIndexBuffer;
+    indexBufferMemory = hostIndexBufferMemory;
+
+    geometryInHostMemory = true;
+    lastEvictionTimelineValue = timelineValue;
+    invalidateCommandBuffers();
 }
 
-void Application::createDescriptorSets() {
-    std::vector<vk::DescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+void Application::loadScene() {
+    // Without a scene file the model is repeated over the instance grid
+    SceneDescription scene;
+    if (settings.scene.empty()) {
+        scene.meshPaths = {MODEL_PATH};
+        scene.texturePaths = {TEXTURE_PATH};
+        scene.materials = {{0}};
+    } else {
+        scene = SceneDescription::load(settings.scene);
+        sceneInstances = scene.instances;
+    }
 
-    vk::DescriptorSetAllocateInfo allocateInfo = vk::DescriptorSetAllocateInfo()
-            .setDescriptorPool(descriptorPool)
-            .setDescriptorSetCount(static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT))
-            .setPSetLayouts(layouts.data());
+    if (!settings.saveBinaryScene.empty()) {
+        scene.saveBinary(settings.saveBinaryScene);
+    }
 
-    descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+    SceneAssets assets = SceneAssets::fetch(scene, *threadPool);
+    if (settings.frameStatistics) {
+        std::cout << assets.buildReport() << std::endl;
+    }
 
-    vk::Result result = logicalDevice.allocateDescriptorSets(&allocateInfo, descriptorSets.data());
-    if (result != vk::Result::eSuccess) {
-        throw std::runtime_error("Failed to allocate descriptor sets! Error Code: " + vk::to_string(result));
+    // Uploads stay on this thread, one texture per unique image
+    for (const SceneAssets::Image &image: assets.images) {
+        createTextureImage(image);
     }
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vk::DescriptorBufferInfo bufferInfo = vk::DescriptorBufferInfo()
-                .setBuffer(uniformBuffers[i])
-                .setOffset(0)
-                .setRange(sizeof(UniformBufferObject));
+    if (textures.size() > 1 && !bindlessEnabled) {
+        std::cerr << "Scene materials unavailable: without bindless textures every draw samples the first texture"
+                  << std::endl;
+    }
 
-        vk::DescriptorImageInfo imageInfo = vk::DescriptorImageInfo()
-                .setImageLayout(vk::ImageLayout::eShaderReadOnlyOptimal)
-                .setImageView(textureImageView)
-                .setSampler(textureSampler);
+    // A model's geometry is uploaded once, with the texture it is first drawn with. Every other texture it is drawn
+    // with repeats its draw commands with that texture
+    std::vector<uint32_t> modelFirstDraws(assets.models.size(), UINT32_MAX);
+    std::vector<uint32_t> modelDrawCounts(assets.models.size(), 0);
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> firstDraws;
+
+    auto getDraws = [&](uint32_t mesh, uint32_t material) {
+        uint32_t model = assets.meshModels[mesh];
+        uint32_t texture = assets.textureImages[scene.materials[material].texture];
+
+        auto [found, inserted] = firstDraws.emplace(std::make_pair(model, texture),
+                                                    static_cast<uint32_t>(drawCommands.size()));
+        if (inserted && modelFirstDraws[model] == UINT32_MAX) {
+            loadModel(assets.models[model], texture);
+            modelFirstDraws[model] = found->second;
+            modelDrawCounts[model] = static_cast<uint32_t>(drawCommands.size()) - found->second;
+        } else if (inserted) {
+            for (uint32_t i = 0; i < modelDrawCounts[model]; i++) {
+                DrawCommand drawCommand = drawCommands[modelFirstDraws[model] + i];
+                drawCommand.textureIndex = texture;
+                drawCommands.push_back(drawCommand);
+                meshPermutations.push_back(meshPermutations[modelFirstDraws[model] + i]);
+            }
+        }
 
-        std::array<vk::WriteDescriptorSet, 2> descriptorWrites{};
+        return std::make_pair(found->second, modelDrawCounts[model]);
+    };
 
-        descriptorWrites[0] = vk::WriteDescriptorSet()
-                .setDstSet(descriptorSets[i])
-                .setDstBinding(0)
-                .setDstArrayElement(0)
-                .setDescriptorType(vk::DescriptorType::eUniformBuffer)
-                .setDescriptorCount(1)
-                .setPBufferInfo(&bufferInfo);
+    if (sceneInstances.empty()) {
+        getDraws(0, 0);
+        return;
+    }
 
-        descriptorWrites[1] = vk::WriteDescriptorSet()
-                .setDstSet(descriptorSets[i])
-                .setDstBinding(1)
-                .setDstArrayElement(0)
-                .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
-                .setDescriptorCount(1)
-                .setPImageInfo(&imageInfo);
+    objects.clear();
+    float extent = 0.0f;
+    for (uint32_t i = 0; i < sceneInstances.size(); i++) {
+        const SceneDescription::Instance &instance = sceneInstances[i];
+        auto [firstDraw, drawCount] = getDraws(instance.mesh, instance.material);
 
-        logicalDevice.updateDescriptorSets(static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        for (uint32_t draw = firstDraw; draw < firstDraw + drawCount; draw++) {
+            objects.push_back({draw, i});
+        }
+        extent = std::max({extent, std::abs(instance.translation[0]), std::abs(instance.translation[1])});
     }
-}
 
-void Application::createTextureImage(const char* texturePath) {
-    int textureWidth;
-    int textureHeight;
-    int textureChannels;
+    // Like the grid, a margin of one spacing around the outermost instances
+    sceneExtent = 2.0f * extent + 2.5f;
+
+    std::stable_sort(objects.begin(), objects.end(), [](const ObjectData &first, const ObjectData &second) {
+        return first.meshIndex < second.meshIndex;
+    });
+}
 
-    stbi_uc *pixels = stbi_load(texturePath, &textureWidth, &textureHeight, &textureChannels,
-                                STBI_rgb_alpha);
-    vk::DeviceSize imageSize = textureWidth * textureHeight * 4;
-    mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(textureWidth, textureHeight)))) + 1;
+void Application::createTextureImage(const SceneAssets::Image &image) {
+    auto textureWidth = static_cast<int32_t>(image.width);
+    auto textureHeight = static_cast<int32_t>(image.height);
+    const stbi_uc *pixels = image.pixels.get();
 
-    if (!pixels) {
-        throw std::runtime_error("Failed to load texture image!");
-    }
+    vk::DeviceSize imageSize = vk::DeviceSize(image.width) * image.height * 4;
+    uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(textureWidth, textureHeight)))) + 1;
 
     vk::Buffer stagingBuffer;
     vk::DeviceMemory stagingBufferMemory;
 
     createBuffer(imageSize, vk::BufferUsageFlagBits::eTransferSrc,
-                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent, stagingBuffer,
-                 stagingBufferMemory);
+                 vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                 MemoryCategory::Staging, stagingBuffer, stagingBufferMemory);
 
     void *data;
     vk::Result result = logicalDevice.mapMemory(stagingBufferMemory, 0, imageSize, vk::MemoryMapFlags(), &data);
@@ -1336,24 +4143,44 @@ void Application::createTextureImage(const char* texturePath) {
 
     logicalDevice.unmapMemory(stagingBufferMemory);
 
-    stbi_image_free(pixels);
+    // Any texel below the fragment shaders' ALPHA_CUTOFF makes the texture's draws alpha tested; fully opaque ones
+    // keep a permutation without the discard
+    bool alphaTested = false;
+    for (vk::DeviceSize i = 3; i < imageSize && !alphaTested; i += 4) {
+        alphaTested = pixels[i] < 128;
+    }
+
+    Texture texture{};
+    texture.alphaTested = alphaTested;
+    texture.width = static_cast<uint32_t>(textureWidth);
+    texture.height = static_cast<uint32_t>(textureHeight);
+    texture.mipLevels = mipLevels;
 
     createImage(textureWidth, textureHeight, mipLevels, vk::SampleCountFlagBits::e1, vk::Format::eR8G8B8A8Srgb,  vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferSrc |
                 vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
-                vk::MemoryPropertyFlagBits::eDeviceLocal, textureImage, textureImageMemory);
+                vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::Textures, texture.image, texture.memory);
+
+    imageLayoutTracker.registerImage(texture.image, vk::ImageAspectFlagBits::eColor, mipLevels, 1);
+
+    // Upload, mip generation and the final transition share one submission
+    vk::CommandBuffer commandBuffer = beginSingleTimeCommands();
+
+    transitionImageLayout(commandBuffer, texture.image, vk::ImageLayout::eTransferDstOptimal, 0, mipLevels);
+    copyBufferToImage(commandBuffer, stagingBuffer, texture.image, static_cast<uint32_t>(textureWidth), static_cast<uint32_t >(textureHeight));
+    generateMipmaps(commandBuffer, texture.image, vk::Format::eR8G8B8A8Srgb, textureWidth, textureHeight, mipLevels);
 
-    transitionImageLayout(textureImage, vk::Format::eR8G8B8A8Srgb, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, mipLevels);
-    copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(textureWidth), static_cast<uint32_t >(textureHeight));
+    textures.push_back(texture);
 
-    logicalDevice.destroyBuffer(stagingBuffer);
-    logicalDevice.freeMemory(stagingBufferMemory);
+    uint64_t uploadTimelineValue = endSingleTimeCommands(commandBuffer);
 
-    generateMipmaps(textureImage, vk::Format::eR8G8B8A8Srgb, textureWidth, textureHeight, mipLevels);
+    deletionQueue.push(uploadTimelineValue, stagingBuffer);
+    deferFreeDeviceMemory(uploadTimelineValue, stagingBufferMemory);
 }
 
 void Application::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, vk::SampleCountFlagBits numSamples,
                               vk::Format format, vk::ImageTiling tiling, vk::ImageUsageFlags usage,
-                              vk::MemoryPropertyFlags properties, vk::Image &image, vk::DeviceMemory &imageMemory) {
+                              vk::MemoryPropertyFlags properties, MemoryCategory category, vk::Image &image,
+                              vk::DeviceMemory &imageMemory, uint32_t arrayLayers) {
     vk::ImageCreateInfo imageCreateInfo = vk::ImageCreateInfo()
             .setImageType(vk::ImageType::e2D)
             .setExtent(
@@ -1362,7 +4189,7 @@ void Application::createImage(uint32_t width, uint32_t height, uint32_t mipLevel
                             .setHeight(height)
                             .setDepth(1))
             .setMipLevels(mipLevels)
-            .setArrayLayers(1)
+            .setArrayLayers(arrayLayers)
             .setFormat(format)
             .setTiling(tiling)
             .setInitialLayout(vk::ImageLayout::eUndefined)
@@ -1378,13 +4205,19 @@ void Application::createImage(uint32_t width, uint32_t height, uint32_t mipLevel
     vk::MemoryRequirements memoryRequirements;
     logicalDevice.getImageMemoryRequirements(image, &memoryRequirements);
 
-    vk::MemoryAllocateInfo allocateInfo = vk::MemoryAllocateInfo()
-            .setAllocationSize(memoryRequirements.size)
-            .setMemoryTypeIndex(findMemoryType(memoryRequirements.memoryTypeBits, properties));
+    // Lazily allocated memory is a preference: most desktop GPUs expose no such memory type
+    vk::MemoryPropertyFlags memoryProperties = properties;
+    if ((properties & vk::MemoryPropertyFlagBits::eLazilyAllocated) &&
+        !hasMemoryType(memoryRequirements.memoryTypeBits, properties)) {
+        memoryProperties &= ~vk::MemoryPropertyFlags(vk::MemoryPropertyFlagBits::eLazilyAllocated);
+    }
 
-    result = logicalDevice.allocateMemory(&allocateInfo, nullptr, &imageMemory);
-    if (result != vk::Result::eSuccess) {
-        throw std::runtime_error("Failed to allocate image memory! Error Code: " + vk::to_string(result));
+    try {
+        imageMemory = allocateDeviceMemory(memoryRequirements, memoryProperties, category);
+    }
+    catch (...) {
+        logicalDevice.destroyImage(image);
+        throw;
     }
 
     logicalDevice.bindImageMemory(image, imageMemory, 0);
@@ -1413,81 +4246,47 @@ vk::CommandBuffer Application::beginSingleTimeCommands() {
     return commandBuffer;
 }
 
-void Application::endSingleTimeCommands(vk::CommandBuffer commandBuffer)
+uint64_t Application::endSingleTimeCommands(vk::CommandBuffer commandBuffer)
 {
     commandBuffer.end();
 
+    uint64_t uploadTimelineValue = signalNextTimelineValue();
+
+    vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo = vk::TimelineSemaphoreSubmitInfo()
+            .setSignalSemaphoreValueCount(1)
+            .setPSignalSemaphoreValues(&uploadTimelineValue);
+
     vk::SubmitInfo submitInfo = vk::SubmitInfo()
+            .setPNext(&timelineSubmitInfo)
             .setCommandBufferCount(1)
-            .setPCommandBuffers(&commandBuffer);
+            .setPCommandBuffers(&commandBuffer)
+            .setSignalSemaphoreCount(1)
+            .setPSignalSemaphores(&timelineSemaphore);
 
     vk::Result result = graphicsQueue.submit(1, &submitInfo, VK_NULL_HANDLE);
     if (result != vk::Result::eSuccess) {
         throw std::runtime_error("Failed to submit command buffer to graphics queue! Error Code: " + vk::to_string(result));
     }
-    graphicsQueue.waitIdle();
 
-    logicalDevice.freeCommandBuffers(commandPool, 1, &commandBuffer);
+    // The submission is not waited for; the command buffer is freed once it has executed, and callers that need
+    // the result on the CPU wait for the returned value themselves
+    deletionQueue.push(uploadTimelineValue, commandPool, commandBuffer);
+
+    return uploadTimelineValue;
 }
 
-void Application::transitionImageLayout(vk::Image image, vk::Format format, vk::ImageLayout oldLayout, vk::ImageLayout newLayout, uint32_t mipLevels)
+void Application::transitionImageLayout(vk::CommandBuffer commandBuffer, vk::Image image, vk::ImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount)
 {
-    vk::CommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    // Needs to be properly initialised...
-    vk::ImageMemoryBarrier imageMemoryBarrier = vk::ImageMemoryBarrier()
-            .setOldLayout(oldLayout)
-            .setNewLayout(newLayout)
-            .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
-            .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
-            .setImage(image)
-            .setSubresourceRange(
-                    vk::ImageSubresourceRange()
-                    .setAspectMask(vk::ImageAspectFlagBits::eColor)
-                    .setBaseMipLevel(0)
-                    .setLevelCount(mipLevels)
-                    .setBaseArrayLayer(0)
-                    .setLayerCount(1)
-                    );
-
-
-    vk::PipelineStageFlags sourceStage;
-    vk::PipelineStageFlags destinationStage;
-
-    if (oldLayout == vk::ImageLayout::eUndefined && newLayout == vk::ImageLayout::eTransferDstOptimal)
-    {
-        imageMemoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eNone);
-        imageMemoryBarrier.setDstAccessMask(vk::AccessFlagBits::eTransferWrite);
-
-        sourceStage = vk::PipelineStageFlagBits::eTopOfPipe;
-        destinationStage = vk::PipelineStageFlagBits::eTransfer;
-    }
-    else if (oldLayout == vk::ImageLayout::eTransferDstOptimal && newLayout == vk::ImageLayout::eShaderReadOnlyOptimal)
-    {
-        imageMemoryBarrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
-        imageMemoryBarrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
-
-        sourceStage = vk::PipelineStageFlagBits::eTransfer;
-        destinationStage = vk::PipelineStageFlagBits::eFragmentShader;
-    }
-    else
-    {
-        throw std::invalid_argument("Unsupported layout transition!");
-    }
-
-    commandBuffer.pipelineBarrier(sourceStage,destinationStage,
-                                  vk::DependencyFlags(),
-                                  0,nullptr,
-                                  0,nullptr,
-                                  1, &imageMemoryBarrier);
-
-    endSingleTimeCommands(commandBuffer);
+    // The tracker knows the current layout and the stages that last touched the image, so any transition works and
+    // the barrier waits on no more than it has to
+    imageLayoutTracker.transition(commandBuffer, image,
+                                  vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, baseMipLevel, levelCount, 0, 1),
+                                  newLayout);
+    imageLayoutTracker.flush(commandBuffer);
 }
 
-void Application::copyBufferToImage(vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height)
+void Application::copyBufferToImage(vk::CommandBuffer commandBuffer, vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height)
 {
-    vk::CommandBuffer commandBuffer = beginSingleTimeCommands();
-
     vk::BufferImageCopy region = vk::BufferImageCopy()
             .setBufferOffset(0)
             .setBufferRowLength(0)
@@ -1503,18 +4302,18 @@ void Application::copyBufferToImage(vk::Buffer buffer, vk::Image image, uint32_t
             .setImageExtent(vk::Extent3D(width, height, 1));
 
     commandBuffer.copyBufferToImage(buffer, image, vk::ImageLayout::eTransferDstOptimal, 1, &region);
-    endSingleTimeCommands(commandBuffer);
 }
 
-vk::ImageView Application::createImageView(vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels)
+vk::ImageView Application::createImageView(vk::Image image, vk::Format format, vk::ImageAspectFlags aspectFlags, uint32_t mipLevels, uint32_t layerCount)
 {
+    // Multiview attachments are rendered through array views, one layer per view
     vk::ImageViewCreateInfo imageViewCreateInfo = vk::ImageViewCreateInfo()
             .setImage(image)
-            .setViewType(vk::ImageViewType::e2D)
+            .setViewType(layerCount > 1 ? vk::ImageViewType::e2DArray : vk::ImageViewType::e2D)
             .setFormat(format)
             .setSubresourceRange(vk::ImageSubresourceRange(
                     aspectFlags,
-                    0, mipLevels, 0, 1
+                    0, mipLevels, 0, layerCount
             ));
 
     vk::ImageView imageView;
@@ -1529,7 +4328,12 @@ vk::ImageView Application::createImageView(vk::Image image, vk::Format format, v
 
 void Application::createTextureImageView()
 {
-    textureImageView = createImageView(textureImage, vk::Format::eR8G8B8A8Srgb, vk::ImageAspectFlagBits::eColor, mipLevels);
+    for (auto &texture: textures) {
+        if (!texture.view) {
+            texture.view = createImageView(texture.image, vk::Format::eR8G8B8A8Srgb, vk::ImageAspectFlagBits::eColor,
+                                           texture.mipLevels);
+        }
+    }
 }
 
 void Application::createTextureSampler()
@@ -1551,7 +4355,8 @@ void Application::createTextureSampler()
             .setMipmapMode(vk::SamplerMipmapMode::eLinear)
             .setMipLodBias(0.0f)
             .setMinLod(0.0f)
-            .setMaxLod(static_cast<float>(mipLevels));
+            // Views define how many levels exist, which changes when textures lose mips under memory pressure
+            .setMaxLod(VK_LOD_CLAMP_NONE);
 
     vk::Result result = logicalDevice.createSampler(&samplerCreateInfo, nullptr, &textureSampler);
     if(result != vk::Result::eSuccess)
@@ -1562,11 +4367,24 @@ void Application::createTextureSampler()
 
 void Application::createDepthResources() {
     vk::Format depthFormat = findDepthFormat();
-
-    createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat, vk::ImageTiling::eOptimal,
-                vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal, depthImage,
-                depthImageMemory);
-    depthImageView = createImageView(depthImage, depthFormat, vk::ImageAspectFlagBits::eDepth, 1);
+    vk::Extent2D viewExtent = getViewExtent();
+
+    // Depth is cleared on load and discarded on store, so on tiled GPUs it never needs to exist outside tile memory.
+    // Occlusion culling is the exception: it reads depth back into the pyramid and continues the pass afterwards
+    if (occlusionCullingEnabled) {
+        createImage(viewExtent.width, viewExtent.height, 1, msaaSamples, depthFormat,
+                    vk::ImageTiling::eOptimal,
+                    vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::RenderTargets, depthImage,
+                    depthImageMemory, viewCount);
+    } else {
+        createImage(viewExtent.width, viewExtent.height, 1, msaaSamples, depthFormat,
+                    vk::ImageTiling::eOptimal,
+                    vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eLazilyAllocated,
+                    MemoryCategory::RenderTargets, depthImage, depthImageMemory, viewCount);
+    }
+    depthImageView = createImageView(depthImage, depthFormat, vk::ImageAspectFlagBits::eDepth, 1, viewCount);
 }
 
 vk::Format Application::findSupportedFormat(const std::vector<vk::Format> &candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features)
@@ -1603,22 +4421,29 @@ bool Application::hasStencilComponent(vk::Format format)
     return format == vk::Format::eD32SfloatS8Uint || format == vk::Format::eD24UnormS8Uint;
 }
 
-void Application::loadModel(const char* modelPath)
+void Application::loadModel(const SceneAssets::Model &model, uint32_t textureIndex)
 {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warning, error;
-
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warning, &error, modelPath))
-    {
-        throw std::runtime_error(warning + error);
-    }
+    const tinyobj::attrib_t &attrib = model.attrib;
+    const std::vector<tinyobj::shape_t> &shapes = model.shapes;
 
     std::unordered_map<Vertex, uint32_t, VertexHasher> uniqueVertices{};
 
+    // Models are appended to the shared geometry, with indices relative to the model's first vertex
+    uint32_t baseVertex = static_cast<uint32_t>(vertices.size());
+
     for (const auto& shape : shapes)
     {
+        DrawCommand drawCommand{};
+        drawCommand.firstIndex = static_cast<uint32_t>(indices.size());
+        drawCommand.indexCount = static_cast<uint32_t>(shape.mesh.indices.size());
+        drawCommand.vertexOffset = static_cast<int32_t>(baseVertex);
+        drawCommand.textureIndex = textureIndex;
+        drawCommands.push_back(drawCommand);
+
+        glm::vec3 boundsMin(std::numeric_limits<float>::max());
+        glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+        bool hasVertexColors = false;
+
         for (const auto& index : shape.mesh.indices)
         {
             Vertex vertex{};
@@ -1634,21 +4459,55 @@ void Application::loadModel(const char* modelPath)
                     1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
             };
 
+            // Models without vertex colors read as white, and meshes that are all white skip them
             vertex.color = {1.0f, 1.0f, 1.0f};
+            if (attrib.colors.size() >= 3 * static_cast<size_t>(index.vertex_index) + 3) {
+                vertex.color = {
+                        attrib.colors[3 * index.vertex_index + 0],
+                        attrib.colors[3 * index.vertex_index + 1],
+                        attrib.colors[3 * index.vertex_index + 2]
+                };
+                hasVertexColors = hasVertexColors || vertex.color != glm::vec3(1.0f);
+            }
+
+            // Models without normals are lit as if every surface faced up
+            vertex.normal = {0.0f, 0.0f, 1.0f};
+            if (index.normal_index >= 0) {
+                vertex.normal = {
+                        attrib.normals[3 * index.normal_index + 0],
+                        attrib.normals[3 * index.normal_index + 1],
+                        attrib.normals[3 * index.normal_index + 2]
+                };
+            }
+
+            boundsMin = glm::min(boundsMin, vertex.position);
+            boundsMax = glm::max(boundsMax, vertex.position);
 
             if (uniqueVertices.count(vertex) == 0)
             {
-                uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
+                uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size()) - baseVertex;
                 vertices.push_back(vertex);
             }
 
             indices.push_back(uniqueVertices[vertex]);
         }
+
+        // Bounding sphere around the box center, which is close enough to the optimal sphere for culling
+        glm::vec3 center = 0.5f * (boundsMin + boundsMax);
+        float radius = 0.0f;
+        for (uint32_t i = drawCommand.firstIndex; i < drawCommand.firstIndex + drawCommand.indexCount; i++)
+        {
+            radius = std::max(radius, glm::length(vertices[baseVertex + indices[i]].position - center));
+        }
+        drawCommands.back().boundingSphere = glm::vec4(center, radius);
+        meshPermutations.push_back(hasVertexColors ? PERMUTATION_VERTEX_COLORS : 0);
     }
+
+    invalidateCommandBuffers();
 }
 
 // Create a way to pre-generate mipmap levels as a way to cache them for faster runtime texture loading...
-void Application::generateMipmaps(vk::Image image, vk::Format imageFormat, int32_t textureWidth, int32_t textureHeight, uint32_t mipLevels)
+void Application::generateMipmaps(vk::CommandBuffer commandBuffer, vk::Image image, vk::Format imageFormat, int32_t textureWidth, int32_t textureHeight, uint32_t mipLevels)
 {
     // Check if linear blitting is supported
     vk::FormatProperties formatProperties;
@@ -1659,35 +4518,17 @@ void Application::generateMipmaps(vk::Image image, vk::Format imageFormat, int32
         throw std::runtime_error("Texture image format does not support linear blitting!");
     }
 
-    vk::CommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    vk::ImageMemoryBarrier barrier = vk::ImageMemoryBarrier()
-            .setImage(image)
-            .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
-            .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
-            .setSubresourceRange(
-                    vk::ImageSubresourceRange()
-                            .setAspectMask(vk::ImageAspectFlagBits::eColor)
-                            .setBaseArrayLayer(0)
-                            .setLayerCount(1)
-                            .setLevelCount(1)
-                    );
-
     int32_t mipWidth = textureWidth;
     int32_t mipHeight = textureHeight;
 
+    // Every level is already in TRANSFER_DST_OPTIMAL for copies and blits, so each step needs a single barrier that
+    // makes the previous level readable
     for (uint32_t i = 1; i < mipLevels; i++) {
-        barrier.subresourceRange.setBaseMipLevel(i - 1);
-        barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
-        barrier.setNewLayout(vk::ImageLayout::eTransferSrcOptimal);
-        barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
-        barrier.setDstAccessMask(vk::AccessFlagBits::eTransferRead);
-
-        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer,
-                                      vk::DependencyFlags(),
-                                      0,nullptr,
-                                      0,nullptr,
-                                      1, &barrier);
+        imageLayoutTracker.transition(commandBuffer, image,
+                                      vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, i - 1, 1, 0, 1),
+                                      vk::ImageLayout::eTransferSrcOptimal,
+                                      vk::PipelineStageFlagBits2::eBlit, vk::AccessFlagBits2::eTransferRead);
+        imageLayoutTracker.flush(commandBuffer);
 
         vk::ImageBlit blit = vk::ImageBlit()
                 .setSrcOffsets({
@@ -1720,34 +4561,15 @@ void Application::generateMipmaps(vk::Image image, vk::Format imageFormat, int32
                 image, vk::ImageLayout::eTransferDstOptimal,
                 1, &blit, vk::Filter::eLinear);
 
-        barrier.setOldLayout(vk::ImageLayout::eTransferSrcOptimal);
-        barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-        barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferRead);
-        barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
-
-        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
-                                      vk::DependencyFlags(),
-                                      0,nullptr,
-                                      0,nullptr,
-                                      1, &barrier);
-
         if (mipWidth > 1) { mipWidth /= 2; }
         if (mipHeight > 1) { mipHeight /= 2; }
     }
 
-    barrier.subresourceRange.setBaseMipLevel(mipLevels - 1);
-    barrier.setOldLayout(vk::ImageLayout::eTransferDstOptimal);
-    barrier.setNewLayout(vk::ImageLayout::eShaderReadOnlyOptimal);
-    barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
-    barrier.setDstAccessMask(vk::AccessFlagBits::eShaderRead);
-
-    commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader,
-                                  vk::DependencyFlags(),
-                                  0,nullptr,
-                                  0,nullptr,
-                                  1, &barrier);
-
-    endSingleTimeCommands(commandBuffer);
+    // One batch moves every level to SHADER_READ_ONLY_OPTIMAL: the sources as one range, the last level on its own
+    imageLayoutTracker.transition(commandBuffer, image,
+                                  vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1),
+                                  vk::ImageLayout::eShaderReadOnlyOptimal);
+    imageLayoutTracker.flush(commandBuffer);
 }
 
 vk::SampleCountFlagBits Application::getMaxUsableSampleCount()
@@ -1769,10 +4591,595 @@ vk::SampleCountFlagBits Application::getMaxUsableSampleCount()
 void Application::createColorResources()
 {
     vk::Format colorFormat = swapChainImageFormat;
+    vk::Extent2D viewExtent = getViewExtent();
+
+    // Only the resolved swapchain image is stored, so the multisampled image can live in lazily allocated memory,
+    // unless occlusion culling splits the frame into two passes that share it
+    if (occlusionCullingEnabled) {
+        createImage(viewExtent.width, viewExtent.height, 1, msaaSamples, colorFormat,
+                    vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eColorAttachment,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::RenderTargets, colorImage,
+                    colorImageMemory, viewCount);
+    } else {
+        createImage(viewExtent.width, viewExtent.height, 1, msaaSamples, colorFormat,
+                    vk::ImageTiling::eOptimal,
+                    vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eColorAttachment,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eLazilyAllocated,
+                    MemoryCategory::RenderTargets, colorImage, colorImageMemory, viewCount);
+    }
+
+    colorImageView = createImageView(colorImage, colorFormat, vk::ImageAspectFlagBits::eColor, 1, viewCount);
+}
+
+void Application::createSceneImage() {
+    // Stays at the view size, so scale changes only move the render area; it is read by the upscaling blit, which
+    // places each of its layers in the view's column of the swapchain image
+    vk::Extent2D viewExtent = getViewExtent();
+    createImage(viewExtent.width, viewExtent.height, 1, vk::SampleCountFlagBits::e1, swapChainImageFormat,
+                vk::ImageTiling::eOptimal,
+                vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,
+                vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::RenderTargets, sceneImage, sceneImageMemory,
+                viewCount);
+
+    sceneImageView = createImageView(sceneImage, swapChainImageFormat, vk::ImageAspectFlagBits::eColor, 1, viewCount);
+}
+
+std::string Application::buildTransientAttachmentReport() {
+    // Lazily allocated memory is only backed as far as the implementation needs it, which on tiled GPUs is often
+    // not at all
+    vk::DeviceSize allocatedSize = 0;
+    vk::DeviceSize committedSize = 0;
+    bool lazilyAllocated = false;
+
+    std::array<std::pair<vk::Image, vk::DeviceMemory>, 2> attachments = {
+            std::make_pair(colorImage, colorImageMemory),
+            std::make_pair(depthImage, depthImageMemory)
+    };
+
+    for (const auto &[image, memory]: attachments) {
+        vk::MemoryRequirements memoryRequirements;
+        logicalDevice.getImageMemoryRequirements(image, &memoryRequirements);
+        allocatedSize += memoryRequirements.size;
+
+        // Same choice createImage made for this image
+        if (!occlusionCullingEnabled && hasMemoryType(memoryRequirements.memoryTypeBits,
+                          vk::MemoryPropertyFlagBits::eDeviceLocal | vk::MemoryPropertyFlagBits::eLazilyAllocated)) {
+            vk::DeviceSize commitment = 0;
+            logicalDevice.getMemoryCommitment(memory, &commitment);
+            committedSize += commitment;
+            lazilyAllocated = true;
+        } else {
+            committedSize += memoryRequirements.size;
+        }
+    }
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "transient attachments: %.1f MiB allocated, %.1f MiB committed, %.1f MiB saved (%s)",
+                  static_cast<double>(allocatedSize) / (1024.0 * 1024.0),
+                  static_cast<double>(committedSize) / (1024.0 * 1024.0),
+                  static_cast<double>(allocatedSize - committedSize) / (1024.0 * 1024.0),
+                  lazilyAllocated ? "lazily allocated" : "no lazily allocated memory type");
+
+    return line;
+}
+
+void Application::createOcclusionCullingPipelines() {
+    // Culling: the draw command bindings, then the camera, instance transforms, depth pyramid and retest list
+    std::array<vk::DescriptorType, 7> cullBindingTypes = {
+            vk::DescriptorType::eStorageBuffer, vk::DescriptorType::eStorageBuffer, vk::DescriptorType::eStorageBuffer,
+            vk::DescriptorType::eUniformBuffer, vk::DescriptorType::eStorageBuffer,
+            vk::DescriptorType::eCombinedImageSampler, vk::DescriptorType::eStorageBuffer
+    };
+
+    std::array<vk::DescriptorSetLayoutBinding, 7> cullBindings{};
+    for (uint32_t i = 0; i < cullBindings.size(); i++) {
+        cullBindings[i] = vk::DescriptorSetLayoutBinding()
+                .setBinding(i)
+                .setDescriptorCount(1)
+                .setDescriptorType(cullBindingTypes[i])
+                .setStageFlags(vk::ShaderStageFlagBits::eCompute);
+    }
+
+    vk::DescriptorSetLayoutCreateInfo layoutCreateInfo = vk::DescriptorSetLayoutCreateInfo()
+            .setBindingCount(static_cast<uint32_t>(cullBindings.size()))
+            .setPBindings(cullBindings.data());
+
+    vk::Result result = logicalDevice.createDescriptorSetLayout(&layoutCreateInfo, nullptr, &occlusionCullSetLayout);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create descriptor set layout! Error Code: " + vk::to_string(result));
+    }
+
+    vk::PushConstantRange pushConstantRange = vk::PushConstantRange()
+            .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+            .setOffset(0)
+            .setSize(sizeof(OcclusionCullParameters));
+
+    vk::PipelineLayoutCreateInfo pipelineLayoutCreateInfo = vk::PipelineLayoutCreateInfo()
+            .setSetLayoutCount(1)
+            .setPSetLayouts(&occlusionCullSetLayout)
+            .setPushConstantRangeCount(1)
+            .setPPushConstantRanges(&pushConstantRange);
+
+    result = logicalDevice.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &occlusionCullPipelineLayout);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create pipeline layout! Error Code: " + vk::to_string(result));
+    }
+
+    // Pyramid levels: the level below (or the depth attachment) in, the level being built out
+    std::array<vk::DescriptorSetLayoutBinding, 2> pyramidBindings = {
+            vk::DescriptorSetLayoutBinding()
+                    .setBinding(0)
+                    .setDescriptorCount(1)
+                    .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                    .setStageFlags(vk::ShaderStageFlagBits::eCompute),
+            vk::DescriptorSetLayoutBinding()
+                    .setBinding(1)
+                    .setDescriptorCount(1)
+                    .setDescriptorType(vk::DescriptorType::eStorageImage)
+                    .setStageFlags(vk::ShaderStageFlagBits::eCompute)
+    };
+
+    layoutCreateInfo.setBindingCount(static_cast<uint32_t>(pyramidBindings.size()))
+            .setPBindings(pyramidBindings.data());
+
+    result = logicalDevice.createDescriptorSetLayout(&layoutCreateInfo, nullptr, &depthPyramidSetLayout);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create descriptor set layout! Error Code: " + vk::to_string(result));
+    }
+
+    pipelineLayoutCreateInfo.setPSetLayouts(&depthPyramidSetLayout)
+            .setPushConstantRangeCount(0)
+            .setPPushConstantRanges(nullptr);
+
+    result = logicalDevice.createPipelineLayout(&pipelineLayoutCreateInfo, nullptr, &depthPyramidPipelineLayout);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create pipeline layout! Error Code: " + vk::to_string(result));
+    }
+
+    auto createComputePipeline = [&](const std::string &shaderPath, vk::PipelineLayout layout) {
+        auto shaderCode = readFile(shaderPath);
+        vk::ShaderModule shaderModule = createShaderModule(shaderCode);
+
+        vk::ComputePipelineCreateInfo pipelineCreateInfo = vk::ComputePipelineCreateInfo()
+                .setStage(vk::PipelineShaderStageCreateInfo()
+                                  .setStage(vk::ShaderStageFlagBits::eCompute)
+                                  .setModule(shaderModule)
+                                  .setPName("main"))
+                .setLayout(layout);
+
+        vk::Pipeline pipeline;
+        vk::Result pipelineResult = logicalDevice.createComputePipelines(VK_NULL_HANDLE, 1, &pipelineCreateInfo,
+                                                                         nullptr, &pipeline);
+        logicalDevice.destroyShaderModule(shaderModule);
+
+        if (pipelineResult != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to create compute pipeline! Error Code: " + vk::to_string(pipelineResult));
+        }
+
+        return pipeline;
+    };
+
+    occlusionCullPipeline = createComputePipeline("resources/shaders/compiled/occlusion_cull.spv",
+                                                  occlusionCullPipelineLayout);
+    depthPyramidPipeline = createComputePipeline("resources/shaders/compiled/depth_pyramid.spv",
+                                                 depthPyramidPipelineLayout);
+    // The first level reads every sample of the multisampled depth attachment
+    if (msaaSamples != vk::SampleCountFlagBits::e1) {
+        depthPyramidMultisamplePipeline = createComputePipeline(
+                "resources/shaders/compiled/depth_pyramid_multisample.spv", depthPyramidPipelineLayout);
+    }
+
+    // Only ever read with texelFetch, so filtering does not matter
+    vk::SamplerCreateInfo samplerCreateInfo = vk::SamplerCreateInfo()
+            .setMagFilter(vk::Filter::eNearest)
+            .setMinFilter(vk::Filter::eNearest)
+            .setMipmapMode(vk::SamplerMipmapMode::eNearest)
+            .setAddressModeU(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeV(vk::SamplerAddressMode::eClampToEdge)
+            .setAddressModeW(vk::SamplerAddressMode::eClampToEdge)
+            .setMinLod(0.0f)
+            .setMaxLod(VK_LOD_CLAMP_NONE);
+
+    result = logicalDevice.createSampler(&samplerCreateInfo, nullptr, &depthPyramidSampler);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create depth pyramid sampler! Error Code: " + vk::to_string(result));
+    }
+
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+    gpuTimer.initialize(logicalDevice, physicalDevice, queueFamilyIndices.graphicsFamily.value(), maxFramesInFlight,
+                        {"early cull", "early pass", "depth pyramid", "late cull", "late pass"});
+}
+
+void Application::createDepthPyramid() {
+    // Power-of-two levels halve exactly, so the culling shader can pick the level a bounding box fits in
+    auto previousPowerOfTwo = [](uint32_t value) {
+        uint32_t result = 1;
+        while (result * 2 <= value) {
+            result *= 2;
+        }
+        return result;
+    };
+
+    depthPyramidExtent = vk::Extent2D(previousPowerOfTwo(swapChainExtent.width),
+                                      previousPowerOfTwo(swapChainExtent.height));
+    depthPyramidLevels = static_cast<uint32_t>(
+            std::floor(std::log2(std::max(depthPyramidExtent.width, depthPyramidExtent.height)))) + 1;
+
+    createImage(depthPyramidExtent.width, depthPyramidExtent.height, depthPyramidLevels, vk::SampleCountFlagBits::e1,
+                vk::Format::eR32Sfloat, vk::ImageTiling::eOptimal,
+                vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
+                vk::MemoryPropertyFlagBits::eDeviceLocal, MemoryCategory::RenderTargets, depthPyramid,
+                depthPyramidMemory);
+
+    depthPyramidView = createImageView(depthPyramid, vk::Format::eR32Sfloat, vk::ImageAspectFlagBits::eColor,
+                                       depthPyramidLevels);
+
+    depthPyramidLevelViews.resize(depthPyramidLevels);
+    for (uint32_t level = 0; level < depthPyramidLevels; level++) {
+        vk::ImageViewCreateInfo viewCreateInfo = vk::ImageViewCreateInfo()
+                .setImage(depthPyramid)
+                .setViewType(vk::ImageViewType::e2D)
+                .setFormat(vk::Format::eR32Sfloat)
+                .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level, 1, 0, 1));
+
+        vk::Result result = logicalDevice.createImageView(&viewCreateInfo, nullptr, &depthPyramidLevelViews[level]);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to create depth pyramid view! Error Code: " + vk::to_string(result));
+        }
+    }
+
+    // Shader reads and writes of the pyramid all use the general layout, so it is transitioned once here. Until
+    // the first frame writes it, its contents only cost the early phase some rejections the late phase recovers
+    vk::CommandBuffer commandBuffer = beginSingleTimeCommands();
+    imageLayoutTracker.registerImage(depthPyramid, vk::ImageAspectFlagBits::eColor, depthPyramidLevels, 1);
+    imageLayoutTracker.transition(commandBuffer, depthPyramid,
+                                  vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, depthPyramidLevels,
+                                                            0, 1),
+                                  vk::ImageLayout::eGeneral, vk::PipelineStageFlagBits2::eComputeShader,
+                                  vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eShaderSampledRead);
+    imageLayoutTracker.flush(commandBuffer);
+    endSingleTimeCommands(commandBuffer);
+
+    // One set per level; the pool lives as long as this pyramid
+    vk::DescriptorPoolSize poolSizes[] = {
+            vk::DescriptorPoolSize(vk::DescriptorType::eCombinedImageSampler, depthPyramidLevels),
+            vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, depthPyramidLevels)
+    };
+
+    vk::DescriptorPoolCreateInfo poolCreateInfo = vk::DescriptorPoolCreateInfo()
+            .setPoolSizeCount(2)
+            .setPPoolSizes(poolSizes)
+            .setMaxSets(depthPyramidLevels);
+
+    vk::Result result = logicalDevice.createDescriptorPool(&poolCreateInfo, nullptr, &depthPyramidDescriptorPool);
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to create descriptor pool! Error Code: " + vk::to_string(result));
+    }
+
+    std::vector<vk::DescriptorSetLayout> layouts(depthPyramidLevels, depthPyramidSetLayout);
+    vk::DescriptorSetAllocateInfo allocateInfo = vk::DescriptorSetAllocateInfo()
+            .setDescriptorPool(depthPyramidDescriptorPool)
+            .setDescriptorSetCount(depthPyramidLevels)
+            .setPSetLayouts(layouts.data());
+
+    depthPyramidDescriptorSets.resize(depthPyramidLevels);
+    result = logicalDevice.allocateDescriptorSets(&allocateInfo, depthPyramidDescriptorSets.data());
+    if (result != vk::Result::eSuccess) {
+        throw std::runtime_error("Failed to allocate descriptor sets! Error Code: " + vk::to_string(result));
+    }
+
+    for (uint32_t level = 0; level < depthPyramidLevels; level++) {
+        vk::DescriptorImageInfo inputInfo = level == 0
+                ? vk::DescriptorImageInfo(depthPyramidSampler, depthImageView,
+                                          vk::ImageLayout::eDepthStencilReadOnlyOptimal)
+                : vk::DescriptorImageInfo(depthPyramidSampler, depthPyramidLevelViews[level - 1],
+                                          vk::ImageLayout::eGeneral);
+        vk::DescriptorImageInfo outputInfo(nullptr, depthPyramidLevelViews[level], vk::ImageLayout::eGeneral);
+
+        std::array<vk::WriteDescriptorSet, 2> writes = {
+                vk::WriteDescriptorSet()
+                        .setDstSet(depthPyramidDescriptorSets[level])
+                        .setDstBinding(0)
+                        .setDescriptorCount(1)
+                        .setDescriptorType(vk::DescriptorType::eCombinedImageSampler)
+                        .setPImageInfo(&inputInfo),
+                vk::WriteDescriptorSet()
+                        .setDstSet(depthPyramidDescriptorSets[level])
+                        .setDstBinding(1)
+                        .setDescriptorCount(1)
+                        .setDescriptorType(vk::DescriptorType::eStorageImage)
+                        .setPImageInfo(&outputInfo)
+        };
+
+        logicalDevice.updateDescriptorSets(static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    // The culling sets reference the pyramid, so each frame slot rewrites its set before it next records
+    descriptorGeneration++;
+}
+
+void Application::retireDepthPyramid() {
+    for (auto levelView: depthPyramidLevelViews) {
+        deletionQueue.push(timelineValue, levelView);
+    }
+    depthPyramidLevelViews.clear();
+
+    deletionQueue.push(timelineValue, depthPyramidView);
+    deletionQueue.push(timelineValue, depthPyramid);
+    deferFreeDeviceMemory(timelineValue, depthPyramidMemory);
+
+    vk::DescriptorPool descriptorPoolToDestroy = depthPyramidDescriptorPool;
+    deletionQueue.push(timelineValue, [descriptorPoolToDestroy](vk::Device device) {
+        device.destroyDescriptorPool(descriptorPoolToDestroy);
+    });
 
-    createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, colorFormat, vk::ImageTiling::eOptimal,
-                vk::ImageUsageFlagBits::eTransientAttachment | vk::ImageUsageFlagBits::eColorAttachment, vk::MemoryPropertyFlagBits::eDeviceLocal,
-                colorImage, colorImageMemory);
+    imageLayoutTracker.unregisterImage(depthPyramid);
+}
+
+void Application::createOcclusionBuffers() {
+    // The retest lists are created with the draw command buffers, which they grow with; these are the readbacks
+    occlusionStatisticsBuffers.resize(maxFramesInFlight);
+    occlusionStatisticsBuffersMemory.resize(maxFramesInFlight);
+    occlusionStatisticsBuffersMapped.resize(maxFramesInFlight);
+    occlusionSubmittedObjectCounts.assign(maxFramesInFlight, 0);
+
+    for (uint32_t i = 0; i < maxFramesInFlight; i++) {
+        createBuffer(sizeof(OcclusionCounters), vk::BufferUsageFlagBits::eTransferDst,
+                     vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                     MemoryCategory::Staging, occlusionStatisticsBuffers[i], occlusionStatisticsBuffersMemory[i]);
+
+        vk::Result result = logicalDevice.mapMemory(occlusionStatisticsBuffersMemory[i], 0, sizeof(OcclusionCounters),
+                                                    vk::MemoryMapFlags(), &occlusionStatisticsBuffersMapped[i]);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to map occlusion statistics memory! Error Code: " + vk::to_string(result));
+        }
+
+        memset(occlusionStatisticsBuffersMapped[i], 0, sizeof(OcclusionCounters));
+    }
+}
+
+void Application::recordOcclusionCulledFrame(vk::CommandBuffer commandBuffer, uint32_t imageIndex) {
+    gpuTimer.reset(commandBuffer, currentFrame);
+    gpuTimer.writeTimestamp(commandBuffer, currentFrame, 0, vk::PipelineStageFlagBits2::eTopOfPipe);
+
+    // Early phase: everything the frustum let through, against the previous frame's pyramid
+    recordOcclusionCullPhase(commandBuffer, false);
+    gpuTimer.writeTimestamp(commandBuffer, currentFrame, 1, vk::PipelineStageFlagBits2::eComputeShader);
+
+    beginDynamicRendering(commandBuffer, imageIndex, {}, RenderingPass::Early);
+    recordDraws(commandBuffer, 0, visibleDraws.size());
+    commandBuffer.endRendering();
+    gpuTimer.writeTimestamp(commandBuffer, currentFrame, 2, vk::PipelineStageFlagBits2::eAllGraphics);
+
+    recordDepthPyramid(commandBuffer);
+    gpuTimer.writeTimestamp(commandBuffer, currentFrame, 3, vk::PipelineStageFlagBits2::eComputeShader);
+
+    // Late phase: only the early rejects, against the pyramid of what was just drawn
+    recordOcclusionCullPhase(commandBuffer, true);
+    gpuTimer.writeTimestamp(commandBuffer, currentFrame, 4, vk::PipelineStageFlagBits2::eComputeShader);
+
+    beginDynamicRendering(commandBuffer, imageIndex, {}, RenderingPass::Late);
+    recordDraws(commandBuffer, 0, visibleDraws.size());
+    endDynamicRendering(commandBuffer, imageIndex);
+    gpuTimer.writeTimestamp(commandBuffer, currentFrame, 5, vk::PipelineStageFlagBits2::eAllGraphics);
+
+    // The counters are read back once this frame slot comes around again
+    vk::MemoryBarrier2 countersBarrier = vk::MemoryBarrier2()
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eCopy)
+            .setDstAccessMask(vk::AccessFlagBits2::eTransferRead);
+
+    vk::DependencyInfo dependencyInfo = vk::DependencyInfo()
+            .setMemoryBarrierCount(1)
+            .setPMemoryBarriers(&countersBarrier);
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+
+    vk::BufferCopy countersCopy(0, 0, sizeof(OcclusionCounters));
+    commandBuffer.copyBuffer(occlusionBuffers[currentFrame], occlusionStatisticsBuffers[currentFrame], 1,
+                             &countersCopy);
+}
+
+void Application::recordOcclusionCullPhase(vk::CommandBuffer commandBuffer, bool latePhase) {
+    vk::Buffer indirectBuffer = indirectBuffers[currentFrame];
+
+    // Before the early phase this also orders the previous frame's pyramid writes before the reads here, and
+    // before the late phase the early pass's reads of the draw list, indirect and by the vertex shader, before it
+    // is rewritten
+    vk::MemoryBarrier2 clearBarrier = vk::MemoryBarrier2()
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eDrawIndirect |
+                             vk::PipelineStageFlagBits2::eVertexShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eClear)
+            .setDstAccessMask(vk::AccessFlagBits2::eTransferWrite);
+
+    vk::DependencyInfo dependencyInfo = vk::DependencyInfo()
+            .setMemoryBarrierCount(1)
+            .setPMemoryBarriers(&clearBarrier);
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+
+    commandBuffer.fillBuffer(indirectBuffer, 0, sizeof(uint32_t), 0);
+    if (!latePhase) {
+        commandBuffer.fillBuffer(occlusionBuffers[currentFrame], 0, sizeof(OcclusionCounters), 0);
+    }
+
+    vk::MemoryBarrier2 cullBarrier = vk::MemoryBarrier2()
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eClear | vk::PipelineStageFlagBits2::eComputeShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eShaderStorageWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite |
+                              vk::AccessFlagBits2::eShaderSampledRead);
+
+    dependencyInfo.setPMemoryBarriers(&cullBarrier);
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+
+    OcclusionCullParameters parameters{visibleObjectCount, latePhase ? 1u : 0u, occlusionTestEnabled ? 1u : 0u};
+
+    commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, occlusionCullPipeline);
+    commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, occlusionCullPipelineLayout, 0, 1,
+                                     &occlusionCullDescriptorSets[currentFrame], 0, nullptr);
+    commandBuffer.pushConstants(occlusionCullPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+                                sizeof(parameters), &parameters);
+    // The late phase only has the retest count on the GPU, so it covers the most it could be
+    commandBuffer.dispatch((visibleObjectCount + 63) / 64, 1, 1);
+
+    // The bindless vertex shader also reads each draw's material from the draw list, through gl_DrawID
+    vk::MemoryBarrier2 indirectBarrier = vk::MemoryBarrier2()
+            .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+            .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+            .setDstStageMask(vk::PipelineStageFlagBits2::eDrawIndirect | vk::PipelineStageFlagBits2::eVertexShader)
+            .setDstAccessMask(vk::AccessFlagBits2::eIndirectCommandRead | vk::AccessFlagBits2::eShaderStorageRead);
+
+    dependencyInfo.setPMemoryBarriers(&indirectBarrier);
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+}
 
-    colorImageView = createImageView(colorImage, colorFormat, vk::ImageAspectFlagBits::eColor, 1);
+void Application::recordDepthPyramid(vk::CommandBuffer commandBuffer) {
+    vk::ImageAspectFlags depthAspect = vk::ImageAspectFlagBits::eDepth;
+    if (hasStencilComponent(findDepthFormat())) {
+        depthAspect |= vk::ImageAspectFlagBits::eStencil;
+    }
+
+    // The early pass's depth becomes readable, and the previous readers of the pyramid (last frame's late cull and
+    // this frame's early cull) finish before it is overwritten
+    std::array<vk::ImageMemoryBarrier2, 2> barriers = {
+            vk::ImageMemoryBarrier2()
+                    .setSrcStageMask(vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+                                     vk::PipelineStageFlagBits2::eLateFragmentTests)
+                    .setSrcAccessMask(vk::AccessFlagBits2::eDepthStencilAttachmentWrite)
+                    .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                    .setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead)
+                    .setOldLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+                    .setNewLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal)
+                    .setImage(depthImage)
+                    .setSubresourceRange(vk::ImageSubresourceRange(depthAspect, 0, 1, 0, 1)),
+            vk::ImageMemoryBarrier2()
+                    .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                    .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+                    .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                    .setDstAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+                    .setOldLayout(vk::ImageLayout::eGeneral)
+                    .setNewLayout(vk::ImageLayout::eGeneral)
+                    .setImage(depthPyramid)
+                    .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0,
+                                                                   depthPyramidLevels, 0, 1))
+    };
+
+    vk::DependencyInfo dependencyInfo = vk::DependencyInfo()
+            .setImageMemoryBarrierCount(static_cast<uint32_t>(barriers.size()))
+            .setPImageMemoryBarriers(barriers.data());
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+
+    vk::Pipeline firstLevelPipeline = msaaSamples != vk::SampleCountFlagBits::e1 ? depthPyramidMultisamplePipeline
+                                                                                 : depthPyramidPipeline;
+
+    for (uint32_t level = 0; level < depthPyramidLevels; level++) {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, level == 0 ? firstLevelPipeline
+                                                                               : depthPyramidPipeline);
+        commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, depthPyramidPipelineLayout, 0, 1,
+                                         &depthPyramidDescriptorSets[level], 0, nullptr);
+
+        uint32_t levelWidth = std::max(depthPyramidExtent.width >> level, 1u);
+        uint32_t levelHeight = std::max(depthPyramidExtent.height >> level, 1u);
+        commandBuffer.dispatch((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+
+        // Each level reads the one before it
+        vk::ImageMemoryBarrier2 levelBarrier = vk::ImageMemoryBarrier2()
+                .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                .setSrcAccessMask(vk::AccessFlagBits2::eShaderStorageWrite)
+                .setDstStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                .setDstAccessMask(vk::AccessFlagBits2::eShaderSampledRead)
+                .setOldLayout(vk::ImageLayout::eGeneral)
+                .setNewLayout(vk::ImageLayout::eGeneral)
+                .setImage(depthPyramid)
+                .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, level, 1, 0, 1));
+
+        dependencyInfo.setImageMemoryBarrierCount(1)
+                .setPImageMemoryBarriers(&levelBarrier);
+        commandBuffer.pipelineBarrier2(&dependencyInfo);
+    }
+
+    // Depth goes back to being an attachment for the late pass, which also continues on the early pass's color
+    std::array<vk::ImageMemoryBarrier2, 2> attachmentBarriers = {
+            vk::ImageMemoryBarrier2()
+                    .setSrcStageMask(vk::PipelineStageFlagBits2::eComputeShader)
+                    .setSrcAccessMask(vk::AccessFlagBits2::eNone)
+                    .setDstStageMask(vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+                                     vk::PipelineStageFlagBits2::eLateFragmentTests)
+                    .setDstAccessMask(vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+                                      vk::AccessFlagBits2::eDepthStencilAttachmentWrite)
+                    .setOldLayout(vk::ImageLayout::eDepthStencilReadOnlyOptimal)
+                    .setNewLayout(vk::ImageLayout::eDepthStencilAttachmentOptimal)
+                    .setImage(depthImage)
+                    .setSubresourceRange(vk::ImageSubresourceRange(depthAspect, 0, 1, 0, 1)),
+            vk::ImageMemoryBarrier2()
+                    .setSrcStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+                    .setSrcAccessMask(vk::AccessFlagBits2::eColorAttachmentWrite)
+                    .setDstStageMask(vk::PipelineStageFlagBits2::eColorAttachmentOutput)
+                    .setDstAccessMask(vk::AccessFlagBits2::eColorAttachmentRead |
+                                      vk::AccessFlagBits2::eColorAttachmentWrite)
+                    .setOldLayout(vk::ImageLayout::eColorAttachmentOptimal)
+                    .setNewLayout(vk::ImageLayout::eColorAttachmentOptimal)
+                    .setImage(colorImage)
+                    .setSubresourceRange(vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1))
+    };
+
+    dependencyInfo.setImageMemoryBarrierCount(static_cast<uint32_t>(attachmentBarriers.size()))
+            .setPImageMemoryBarriers(attachmentBarriers.data());
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+}
+
+void Application::collectOcclusionStatistics(uint32_t frameIndex) {
+    // The slot's previous frame has completed, so its counters and timestamps are final
+    if (gpuTimer.collect(logicalDevice, frameIndex)) {
+        frameGpuTime = std::chrono::duration<double, std::milli>(gpuTimer.getLastFrameMilliseconds());
+    }
+
+    const auto *counters = static_cast<const OcclusionCounters *>(occlusionStatisticsBuffersMapped[frameIndex]);
+    occlusionTestedObjects += occlusionSubmittedObjectCounts[frameIndex];
+    occlusionRejectedEarly += counters->retestCount;
+    occlusionRecoveredLate += counters->lateVisibleCount;
+}
+
+std::string Application::buildOcclusionReport() {
+    auto percentage = [&](uint64_t count) {
+        return occlusionTestedObjects > 0 ? 100.0 * static_cast<double>(count) / occlusionTestedObjects : 0.0;
+    };
+
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "Occlusion culling%s: %.1f%% of frustum-visible objects occluded | %.1f%% rejected early, "
+                  "%.1f%% of those drawn late",
+                  occlusionTestEnabled ? "" : " (test off)",
+                  percentage(occlusionRejectedEarly - occlusionRecoveredLate), percentage(occlusionRejectedEarly),
+                  occlusionRejectedEarly > 0 ? 100.0 * occlusionRecoveredLate / occlusionRejectedEarly : 0.0);
+
+    occlusionTestedObjects = 0;
+    occlusionRejectedEarly = 0;
+    occlusionRecoveredLate = 0;
+
+    return line;
+}
+
+void Application::applyBenchmarkStep() {
+    if (settings.benchmark == "instances") {
+        setInstanceCount(static_cast<uint32_t>(benchmark->getCurrentStep()));
+    } else if (settings.benchmark == "draws") {
+        // Instancing and culling are off, so every instance of every mesh is one draw. The step is rounded to a
+        // whole number of instances, and the table reports the draws actually recorded
+        uint64_t meshCount = drawCommands.size();
+        uint32_t count = static_cast<uint32_t>(std::max<uint64_t>(benchmark->getCurrentStep() / meshCount, 1));
+        setInstanceCount(count);
+        benchmark->setAppliedValue(meshCount * count);
+    } else if (settings.benchmark == "occlusion") {
+        // The test is a push constant recorded into the command buffers
+        occlusionTestEnabled = benchmark->getCurrentStep() != 0;
+        invalidateCommandBuffers();
+    } else if (settings.benchmark == "prepass") {
+        // Only recorded state changes: the pre-pass draws, and the shading pass's depth test
+        depthPrepassEnabled = benchmark->getCurrentStep() != 0;
+        invalidateCommandBuffers();
+    } else if (settings.benchmark == "lights") {
+        setLightCount(static_cast<uint32_t>(benchmark->getCurrentStep()));
+    }
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "benchmark.hpp"
+
+#include <cstdio>
+
+Benchmark::Benchmark(std::string parameterName, std::vector<uint64_t> steps,
+                     std::chrono::duration<double> stepDuration, std::chrono::duration<double> warmUpDuration)
+        : parameterName(std::move(parameterName)), steps(std::move(steps)), stepDuration(stepDuration),
+          warmUpDuration(warmUpDuration) {
+}
+
+bool Benchmark::isFinished() const {
+    return currentStep >= steps.size();
+}
+
+uint64_t Benchmark::getCurrentStep() const {
+    return isFinished() ? steps.back() : steps[currentStep];
+}
+
+void Benchmark::setAppliedValue(uint64_t value) {
+    appliedValue = value;
+    currentResult.value = value;
+}
+
+bool Benchmark::recordFrame(Clock::time_point now, std::chrono::duration<double> cpuTime,
+                            std::chrono::duration<double> gpuTime) {
+    if (isFinished()) {
+        return false;
+    }
+
+    if (!started) {
+        started = true;
+        stepStart = now;
+        measureStart = now + std::chrono::duration_cast<Clock::duration>(warmUpDuration);
+        currentResult = {appliedValue.value_or(steps[currentStep]), 0, 0.0, 0.0, 0.0};
+        return false;
+    }
+
+    // Frames during the warm-up still drain work queued with the previous value
+    if (now < measureStart) {
+        return false;
+    }
+
+    currentResult.frameCount++;
+    currentResult.cpuSeconds += cpuTime.count();
+    currentResult.gpuSeconds += gpuTime.count();
+    currentResult.totalSeconds = std::chrono::duration<double>(now - measureStart).count();
+
+    if (now - stepStart < warmUpDuration + stepDuration) {
+        return false;
+    }
+
+    results.push_back(currentResult);
+    currentStep++;
+
+    if (isFinished()) {
+        return false;
+    }
+
+    stepStart = now;
+    measureStart = now + std::chrono::duration_cast<Clock::duration>(warmUpDuration);
+    currentResult = {steps[currentStep], 0, 0.0, 0.0, 0.0};
+    appliedValue.reset();
+
+    return true;
+}
+
+std::string Benchmark::buildReport() const {
+    char line[256];
+    std::snprintf(line, sizeof(line), "%12s | %10s | %13s | %11s | %11s | %16s\n", parameterName.c_str(), "fps",
+                  "frame time ms", "cpu time ms", "gpu time ms", (parameterName + "/s").c_str());
+    std::string report = line;
+
+    for (const auto &result: results) {
+        double frameSeconds = result.frameCount > 0 ? result.totalSeconds / result.frameCount : 0.0;
+        double cpuSeconds = result.frameCount > 0 ? result.cpuSeconds / result.frameCount : 0.0;
+        double gpuSeconds = result.frameCount > 0 ? result.gpuSeconds / result.frameCount : 0.0;
+        double framesPerSecond = frameSeconds > 0.0 ? 1.0 / frameSeconds : 0.0;
+
+        std::snprintf(line, sizeof(line), "%12llu | %10.1f | %13.3f | %11.3f | %11.3f | %16.4g\n",
+                      static_cast<unsigned long long>(result.value), framesPerSecond, frameSeconds * 1000.0,
+                      cpuSeconds * 1000.0, gpuSeconds * 1000.0, framesPerSecond * static_cast<double>(result.value));
+        report += line;
+    }
+
+    return report;
+}
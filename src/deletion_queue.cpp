@@ -0,0 +1,62 @@
+#include "deletion_queue.hpp"
+
+#include <algorithm>
+
+void DeletionQueue::push(uint64_t timelineValue, vk::Buffer buffer) {
+    push(timelineValue, [buffer](vk::Device device) { device.destroyBuffer(buffer); });
+}
+
+void DeletionQueue::push(uint64_t timelineValue, vk::Image image) {
+    push(timelineValue, [image](vk::Device device) { device.destroyImage(image); });
+}
+
+void DeletionQueue::push(uint64_t timelineValue, vk::ImageView imageView) {
+    push(timelineValue, [imageView](vk::Device device) { device.destroyImageView(imageView); });
+}
+
+void DeletionQueue::push(uint64_t timelineValue, vk::Framebuffer framebuffer) {
+    push(timelineValue, [framebuffer](vk::Device device) { device.destroyFramebuffer(framebuffer); });
+}
+
+void DeletionQueue::push(uint64_t timelineValue, vk::Pipeline pipeline) {
+    push(timelineValue, [pipeline](vk::Device device) { device.destroyPipeline(pipeline); });
+}
+
+void DeletionQueue::push(uint64_t timelineValue, vk::Sampler sampler) {
+    push(timelineValue, [sampler](vk::Device device) { device.destroySampler(sampler); });
+}
+
+void DeletionQueue::push(uint64_t timelineValue, vk::CommandPool commandPool, vk::CommandBuffer commandBuffer) {
+    push(timelineValue, [commandPool, commandBuffer](vk::Device device) {
+        device.freeCommandBuffers(commandPool, 1, &commandBuffer);
+    });
+}
+
+void DeletionQueue::push(uint64_t timelineValue, std::function<void(vk::Device)> destroy) {
+    // An entry tagged with an older value than the last one simply waits a little longer, which keeps the queue
+    // ordered and objects destroyed in the order they were pushed
+    if (!entries.empty()) {
+        timelineValue = std::max(timelineValue, entries.back().timelineValue);
+    }
+
+    entries.push_back({timelineValue, std::move(destroy)});
+}
+
+void DeletionQueue::flush(vk::Device device, uint64_t completedTimelineValue) {
+    while (!entries.empty() && entries.front().timelineValue <= completedTimelineValue) {
+        entries.front().destroy(device);
+        entries.pop_front();
+    }
+}
+
+void DeletionQueue::flushAll(vk::Device device) {
+    for (auto &entry: entries) {
+        entry.destroy(device);
+    }
+
+    entries.clear();
+}
+
+size_t DeletionQueue::size() const {
+    return entries.size();
+}
@@ -0,0 +1,148 @@
+#include "draw_sorter.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+    // Below this many draws splitting a pass costs more than it saves
+    constexpr uint32_t PARALLEL_THRESHOLD = 16384;
+
+    constexpr uint32_t DEPTH_SHIFT = 0;
+    constexpr uint32_t MESH_SHIFT = DEPTH_SHIFT + DrawSorter::DEPTH_BITS;
+    constexpr uint32_t MATERIAL_SHIFT = MESH_SHIFT + DrawSorter::MESH_BITS;
+    constexpr uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + DrawSorter::MATERIAL_BITS;
+    constexpr uint32_t PASS_SHIFT = PIPELINE_SHIFT + DrawSorter::PIPELINE_BITS;
+    static_assert(PASS_SHIFT + DrawSorter::PASS_BITS == 64, "Sort key fields have to fill 64 bits");
+
+    constexpr uint64_t fieldMask(uint32_t bits) {
+        return (uint64_t(1) << bits) - 1;
+    }
+}
+
+uint64_t DrawSorter::makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, uint32_t mesh,
+                             uint32_t depthBucket) {
+    return (uint64_t(pass) & fieldMask(PASS_BITS)) << PASS_SHIFT |
+           (uint64_t(pipeline) & fieldMask(PIPELINE_BITS)) << PIPELINE_SHIFT |
+           (uint64_t(material) & fieldMask(MATERIAL_BITS)) << MATERIAL_SHIFT |
+           (uint64_t(mesh) & fieldMask(MESH_BITS)) << MESH_SHIFT |
+           (uint64_t(depthBucket) & fieldMask(DEPTH_BITS)) << DEPTH_SHIFT;
+}
+
+uint32_t DrawSorter::getPass(uint64_t key) {
+    return static_cast<uint32_t>(key >> PASS_SHIFT & fieldMask(PASS_BITS));
+}
+
+uint32_t DrawSorter::getPipeline(uint64_t key) {
+    return static_cast<uint32_t>(key >> PIPELINE_SHIFT & fieldMask(PIPELINE_BITS));
+}
+
+uint32_t DrawSorter::getMaterial(uint64_t key) {
+    return static_cast<uint32_t>(key >> MATERIAL_SHIFT & fieldMask(MATERIAL_BITS));
+}
+
+uint64_t DrawSorter::getState(uint64_t key) {
+    return key >> MATERIAL_SHIFT;
+}
+
+void DrawSorter::sort(std::vector<Entry> &entries, ThreadPool &threadPool) {
+    auto startTime = Clock::now();
+
+    auto count = static_cast<uint32_t>(entries.size());
+    uint64_t unsortedStateChanges = countStateChanges(entries);
+
+    // A digit every key agrees on can't reorder anything. Most of the high fields are the same for every draw, so
+    // usually only a few of the eight passes run
+    uint64_t commonOnes = ~uint64_t(0);
+    uint64_t anyOnes = 0;
+    for (const Entry &entry: entries) {
+        commonOnes &= entry.key;
+        anyOnes |= entry.key;
+    }
+    uint64_t varyingBits = commonOnes ^ anyOnes;
+
+    uint32_t rangeCount = count < PARALLEL_THRESHOLD ? 1 : threadPool.getThreadCount() * 4;
+    rangeOffsets.resize(rangeCount);
+    scratch.resize(count);
+
+    auto rangeStart = [&](uint32_t rangeIndex) {
+        return static_cast<uint32_t>(uint64_t(count) * rangeIndex / rangeCount);
+    };
+
+    Entry *source = entries.data();
+    Entry *destination = scratch.data();
+
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        if ((varyingBits >> shift & 0xFF) == 0) {
+            continue;
+        }
+
+        threadPool.parallelFor(rangeCount, [&](uint32_t rangeIndex) {
+            std::array<uint32_t, 256> &counts = rangeOffsets[rangeIndex];
+            counts.fill(0);
+            for (uint32_t i = rangeStart(rangeIndex); i < rangeStart(rangeIndex + 1); i++) {
+                counts[source[i].key >> shift & 0xFF]++;
+            }
+        });
+
+        // Every digit's entries go after all smaller digits, and within a digit range by range, which keeps the
+        // sort stable
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < 256; digit++) {
+            for (uint32_t rangeIndex = 0; rangeIndex < rangeCount; rangeIndex++) {
+                uint32_t digitCount = rangeOffsets[rangeIndex][digit];
+                rangeOffsets[rangeIndex][digit] = offset;
+                offset += digitCount;
+            }
+        }
+
+        threadPool.parallelFor(rangeCount, [&](uint32_t rangeIndex) {
+            std::array<uint32_t, 256> &offsets = rangeOffsets[rangeIndex];
+            for (uint32_t i = rangeStart(rangeIndex); i < rangeStart(rangeIndex + 1); i++) {
+                destination[offsets[source[i].key >> shift & 0xFF]++] = source[i];
+            }
+        });
+
+        std::swap(source, destination);
+    }
+
+    if (source != entries.data()) {
+        std::copy(source, source + count, entries.data());
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - startTime).count();
+    lastDrawCount = count;
+    windowSortCount++;
+    windowUnsortedStateChanges += unsortedStateChanges;
+    windowSortedStateChanges += countStateChanges(entries);
+    windowSortSeconds += seconds;
+    windowMaxSortSeconds = std::max(windowMaxSortSeconds, seconds);
+}
+
+std::string DrawSorter::buildReport() {
+    double sortCount = windowSortCount > 0 ? static_cast<double>(windowSortCount) : 1.0;
+
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "Draw sorting: %u draws | %.1f state changes per frame unsorted, %.1f sorted | %.3f ms avg, "
+                  "%.3f ms max",
+                  lastDrawCount, static_cast<double>(windowUnsortedStateChanges) / sortCount,
+                  static_cast<double>(windowSortedStateChanges) / sortCount,
+                  1000.0 * windowSortSeconds / sortCount, 1000.0 * windowMaxSortSeconds);
+
+    windowSortCount = 0;
+    windowUnsortedStateChanges = 0;
+    windowSortedStateChanges = 0;
+    windowSortSeconds = 0.0;
+    windowMaxSortSeconds = 0.0;
+
+    return line;
+}
+
+uint64_t DrawSorter::countStateChanges(const std::vector<Entry> &entries) {
+    // The first draw always sets its state
+    uint64_t changes = entries.empty() ? 0 : 1;
+    for (size_t i = 1; i < entries.size(); i++) {
+        changes += getState(entries[i].key) != getState(entries[i - 1].key) ? 1 : 0;
+    }
+    return changes;
+}
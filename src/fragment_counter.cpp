@@ -0,0 +1,117 @@
+#include "fragment_counter.hpp"
+
+#include <cstdio>
+#include <stdexcept>
+
+void FragmentCounter::initialize(vk::Device device, bool pipelineStatisticsEnabled, uint32_t frameCount) {
+    if (!pipelineStatisticsEnabled) {
+        return;
+    }
+
+    vk::QueryPoolCreateInfo queryPoolCreateInfo = vk::QueryPoolCreateInfo()
+            .setQueryType(vk::QueryType::ePipelineStatistics)
+            .setQueryCount(1)
+            .setPipelineStatistics(vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations);
+
+    queryPools.resize(frameCount);
+    queryPoolsRecorded.assign(frameCount, false);
+    queryPoolsDepthPrepass.assign(frameCount, false);
+
+    for (auto &queryPool: queryPools) {
+        vk::Result result = device.createQueryPool(&queryPoolCreateInfo, nullptr, &queryPool);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error(
+                    "Failed to create pipeline statistics query pool! Error Code: " + vk::to_string(result));
+        }
+    }
+}
+
+void FragmentCounter::destroy(vk::Device device) {
+    for (auto queryPool: queryPools) {
+        device.destroyQueryPool(queryPool);
+    }
+    queryPools.clear();
+}
+
+bool FragmentCounter::isSupported() const {
+    return !queryPools.empty();
+}
+
+void FragmentCounter::begin(vk::CommandBuffer commandBuffer, uint32_t frameIndex, bool depthPrepass) {
+    if (!isSupported()) {
+        return;
+    }
+
+    commandBuffer.resetQueryPool(queryPools[frameIndex], 0, 1);
+    commandBuffer.beginQuery(queryPools[frameIndex], 0, {});
+
+    // Any change of mode re-records the command buffers, so whatever the slot submits next was recorded in this mode
+    queryPoolsRecorded[frameIndex] = true;
+    queryPoolsDepthPrepass[frameIndex] = depthPrepass;
+}
+
+void FragmentCounter::end(vk::CommandBuffer commandBuffer, uint32_t frameIndex) {
+    if (!isSupported()) {
+        return;
+    }
+
+    commandBuffer.endQuery(queryPools[frameIndex], 0);
+}
+
+bool FragmentCounter::collect(vk::Device device, uint32_t frameIndex) {
+    if (!isSupported() || !queryPoolsRecorded[frameIndex]) {
+        return false;
+    }
+
+    uint64_t invocations = 0;
+    vk::Result result = device.getQueryPoolResults(queryPools[frameIndex], 0, 1, sizeof(invocations), &invocations,
+                                                   sizeof(invocations), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+        return false;
+    }
+
+    size_t mode = queryPoolsDepthPrepass[frameIndex] ? 1 : 0;
+    windowInvocations[mode] += invocations;
+    windowFrameCounts[mode]++;
+
+    return true;
+}
+
+std::string FragmentCounter::buildReport() {
+    if (!isSupported()) {
+        return "Fragment shading unavailable: the device has no pipeline statistics queries";
+    }
+
+    for (size_t mode = 0; mode < 2; mode++) {
+        if (windowFrameCounts[mode] > 0) {
+            averageInvocations[mode] = static_cast<double>(windowInvocations[mode]) / windowFrameCounts[mode];
+            measured[mode] = true;
+        }
+        windowInvocations[mode] = 0;
+        windowFrameCounts[mode] = 0;
+    }
+
+    auto describe = [&](size_t mode) {
+        char text[64];
+        if (measured[mode]) {
+            std::snprintf(text, sizeof(text), "%.0f", averageInvocations[mode]);
+        } else {
+            std::snprintf(text, sizeof(text), "not measured");
+        }
+        return std::string(text);
+    };
+
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "Fragment shading: %s invocations per frame without the depth pre-pass, %s with it",
+                  describe(0).c_str(), describe(1).c_str());
+    std::string report = line;
+
+    if (measured[0] && measured[1] && averageInvocations[0] > 0.0) {
+        std::snprintf(line, sizeof(line), " | %.1f%% saved",
+                      100.0 * (1.0 - averageInvocations[1] / averageInvocations[0]));
+        report += line;
+    }
+
+    return report;
+}
@@ -0,0 +1,85 @@
+#include "frame_pacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+
+namespace {
+    constexpr std::chrono::duration<double> MINIMUM_SAFETY_MARGIN = std::chrono::duration<double>(0.001);
+    constexpr std::chrono::duration<double> MAXIMUM_SAFETY_MARGIN = std::chrono::duration<double>(0.008);
+    constexpr double SMOOTHING = 0.1;
+}
+
+FramePacer::FramePacer(std::chrono::duration<double> refreshInterval)
+        : refreshInterval(refreshInterval), safetyMargin(MINIMUM_SAFETY_MARGIN) {}
+
+void FramePacer::setRefreshInterval(std::chrono::duration<double> interval) {
+    refreshInterval = interval;
+}
+
+void FramePacer::recordFrameWork(Clock::duration work) {
+    std::chrono::duration<double> workSeconds = work;
+    predictedWork += (workSeconds - predictedWork) * SMOOTHING;
+}
+
+void FramePacer::recordPresent(Clock::time_point presentTime) {
+    if (hasPresented) {
+        std::chrono::duration<double> interval = presentTime - lastPresentTime;
+        presentIntervals.push_back(interval.count() * 1000.0);
+
+        double refreshes = interval / refreshInterval;
+
+        if (refreshes > 1.5) {
+            // Landed one or more vblanks late: start frames earlier from now on
+            missedIntervals++;
+            safetyMargin = std::min(safetyMargin * 2.0, MAXIMUM_SAFETY_MARGIN);
+        } else {
+            safetyMargin = std::max(safetyMargin * 0.99, MINIMUM_SAFETY_MARGIN);
+
+            // Refine the refresh estimate only from intervals that plausibly span a single vblank
+            if (refreshes > 0.75) {
+                refreshInterval += (interval - refreshInterval) * SMOOTHING;
+            }
+        }
+    }
+
+    hasPresented = true;
+    lastPresentTime = presentTime;
+}
+
+FramePacer::Clock::time_point FramePacer::getNextFrameStart() const {
+    if (!hasPresented) {
+        return Clock::now();
+    }
+
+    auto lead = std::chrono::duration_cast<Clock::duration>(refreshInterval - predictedWork - safetyMargin);
+    return lastPresentTime + std::max(lead, Clock::duration::zero());
+}
+
+std::string FramePacer::buildReport() {
+    double mean = 0.0;
+    double jitter = 0.0;
+
+    if (!presentIntervals.empty()) {
+        mean = std::accumulate(presentIntervals.begin(), presentIntervals.end(), 0.0) /
+               static_cast<double>(presentIntervals.size());
+
+        double variance = 0.0;
+        for (double interval: presentIntervals) {
+            variance += (interval - mean) * (interval - mean);
+        }
+        jitter = std::sqrt(variance / static_cast<double>(presentIntervals.size()));
+    }
+
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "pacing: refresh %.2f ms | interval %.2f ms avg, %.2f ms jitter | %u missed of %zu | margin %.2f ms",
+                  refreshInterval.count() * 1000.0, mean, jitter, missedIntervals, presentIntervals.size(),
+                  safetyMargin.count() * 1000.0);
+
+    presentIntervals.clear();
+    missedIntervals = 0;
+
+    return line;
+}
@@ -0,0 +1,124 @@
+#include "frame_statistics.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+
+namespace {
+    double toMilliseconds(FrameStatistics::Clock::duration duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    double average(const std::vector<double> &values) {
+        if (values.empty()) {
+            return 0.0;
+        }
+
+        return std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(values.size());
+    }
+
+    double percentile(std::vector<double> values, double fraction) {
+        if (values.empty()) {
+            return 0.0;
+        }
+
+        auto nth = values.begin() + static_cast<std::ptrdiff_t>(fraction * static_cast<double>(values.size() - 1));
+        std::nth_element(values.begin(), nth, values.end());
+
+        return *nth;
+    }
+}
+
+FrameStatistics::FrameStatistics(std::chrono::duration<double> reportInterval) : reportInterval(reportInterval) {
+    resetWindow(Clock::now());
+}
+
+void FrameStatistics::setConfiguration(const std::string &label) {
+    if (label == configuration) {
+        return;
+    }
+
+    configuration = label;
+    resetWindow(Clock::now());
+}
+
+void FrameStatistics::setCompletionEvent(const std::string &name) {
+    completionEvent = name;
+}
+
+void FrameStatistics::recordInput(Clock::time_point time) {
+    if (!pendingInputTime) {
+        pendingInputTime = time;
+    }
+}
+
+void FrameStatistics::beginFrame(Clock::time_point time) {
+    if (lastFrameStart) {
+        frameTimes.push_back(toMilliseconds(time - *lastFrameStart));
+    }
+    lastFrameStart = time;
+
+    // A frame that began but was never submitted (e.g. the swapchain went out of date) hands its input on
+    std::optional<Clock::time_point> inputTime = currentFrame ? currentFrame->inputTime : std::nullopt;
+    if (!inputTime) {
+        inputTime = pendingInputTime;
+    }
+    pendingInputTime.reset();
+
+    currentFrame = FrameRecord{0, time, inputTime};
+}
+
+void FrameStatistics::submitFrame(uint64_t frameId) {
+    if (!currentFrame) {
+        return;
+    }
+
+    currentFrame->frameId = frameId;
+    submittedFrames.push_back(*currentFrame);
+    currentFrame.reset();
+}
+
+void FrameStatistics::completeFrames(uint64_t frameId, Clock::time_point time) {
+    while (!submittedFrames.empty() && submittedFrames.front().frameId <= frameId) {
+        const FrameRecord &frame = submittedFrames.front();
+
+        completionLatencies.push_back(toMilliseconds(time - frame.startTime));
+        if (frame.inputTime) {
+            inputLatencies.push_back(toMilliseconds(time - *frame.inputTime));
+        }
+
+        windowFrameCount++;
+        submittedFrames.pop_front();
+    }
+}
+
+bool FrameStatistics::isReportDue(Clock::time_point time) const {
+    return time - windowStart >= reportInterval;
+}
+
+std::string FrameStatistics::buildReport(Clock::time_point time) {
+    double windowSeconds = std::chrono::duration<double>(time - windowStart).count();
+    double framesPerSecond = windowSeconds > 0.0 ? static_cast<double>(windowFrameCount) / windowSeconds : 0.0;
+
+    char line[512];
+    std::snprintf(line, sizeof(line),
+                  "[%s] %.1f fps | frame %.2f ms avg, %.2f ms p99 | start-to-%s %.2f ms avg, %.2f ms p99 | "
+                  "input-to-%s %.2f ms avg, %.2f ms p99 (%zu samples)",
+                  configuration.c_str(), framesPerSecond,
+                  average(frameTimes), percentile(frameTimes, 0.99),
+                  completionEvent.c_str(), average(completionLatencies), percentile(completionLatencies, 0.99),
+                  completionEvent.c_str(),
+                  average(inputLatencies), percentile(inputLatencies, 0.99), inputLatencies.size());
+
+    resetWindow(time);
+
+    return line;
+}
+
+void FrameStatistics::resetWindow(Clock::time_point time) {
+    windowStart = time;
+    windowFrameCount = 0;
+    frameTimes.clear();
+    completionLatencies.clear();
+    inputLatencies.clear();
+}
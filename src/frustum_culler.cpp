@@ -0,0 +1,287 @@
+#include "frustum_culler.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define FRUSTUM_CULLER_AVX2
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define FRUSTUM_CULLER_NEON
+#endif
+
+// The AVX2 kernel is compiled for AVX2 on its own and only selected when the CPU supports it, so the rest of the
+// program keeps the baseline instruction set
+#if defined(FRUSTUM_CULLER_AVX2) && (defined(__GNUC__) || defined(__clang__))
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#else
+#define AVX2_TARGET
+#endif
+
+namespace {
+    // Below this many objects splitting the table costs more than it saves
+    constexpr uint32_t PARALLEL_THRESHOLD = 16384;
+
+    struct SphereTable
+    {
+        const float *x;
+        const float *y;
+        const float *z;
+        const float *radius;
+    };
+
+    using CullKernel = uint32_t (*)(const SphereTable &, uint32_t, uint32_t, const FrustumCuller::Frustum &,
+                                    uint32_t *);
+
+    // Each kernel writes the indices of the visible objects in [first, last) to output and returns their count
+    uint32_t cullScalar(const SphereTable &table, uint32_t first, uint32_t last, const FrustumCuller::Frustum &frustum,
+                        uint32_t *output) {
+        uint32_t visibleCount = 0;
+
+        for (uint32_t i = first; i < last; i++) {
+            bool inside = true;
+            for (const auto &plane: frustum) {
+                float distance = plane.a * table.x[i] + plane.b * table.y[i] + plane.c * table.z[i] + plane.d;
+                inside &= distance >= -table.radius[i];
+            }
+
+            output[visibleCount] = i;
+            visibleCount += inside ? 1 : 0;
+        }
+
+        return visibleCount;
+    }
+
+#ifdef FRUSTUM_CULLER_AVX2
+    AVX2_TARGET uint32_t cullAvx2(const SphereTable &table, uint32_t first, uint32_t last,
+                                  const FrustumCuller::Frustum &frustum, uint32_t *output) {
+        __m256 planeA[6], planeB[6], planeC[6], planeD[6];
+        for (size_t p = 0; p < frustum.size(); p++) {
+            planeA[p] = _mm256_set1_ps(frustum[p].a);
+            planeB[p] = _mm256_set1_ps(frustum[p].b);
+            planeC[p] = _mm256_set1_ps(frustum[p].c);
+            planeD[p] = _mm256_set1_ps(frustum[p].d);
+        }
+
+        uint32_t visibleCount = 0;
+        uint32_t i = first;
+
+        for (; i + 8 <= last; i += 8) {
+            __m256 x = _mm256_loadu_ps(table.x + i);
+            __m256 y = _mm256_loadu_ps(table.y + i);
+            __m256 z = _mm256_loadu_ps(table.z + i);
+            __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(table.radius + i));
+
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (size_t p = 0; p < frustum.size(); p++) {
+                __m256 distance = _mm256_fmadd_ps(planeA[p], x,
+                                                  _mm256_fmadd_ps(planeB[p], y,
+                                                                  _mm256_fmadd_ps(planeC[p], z, planeD[p])));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+            }
+
+            auto mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+            while (mask != 0) {
+                output[visibleCount++] = i + static_cast<uint32_t>(std::countr_zero(mask));
+                mask &= mask - 1;
+            }
+        }
+
+        return visibleCount + cullScalar(table, i, last, frustum, output + visibleCount);
+    }
+
+    bool supportsAvx2() {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#elif defined(__AVX2__)
+        return true;
+#else
+        return false;
+#endif
+    }
+#endif
+
+#ifdef FRUSTUM_CULLER_NEON
+    uint32_t cullNeon(const SphereTable &table, uint32_t first, uint32_t last, const FrustumCuller::Frustum &frustum,
+                      uint32_t *output) {
+        const uint32_t laneBitValues[4] = {1, 2, 4, 8};
+        uint32x4_t laneBits = vld1q_u32(laneBitValues);
+
+        uint32_t visibleCount = 0;
+        uint32_t i = first;
+
+        for (; i + 4 <= last; i += 4) {
+            float32x4_t x = vld1q_f32(table.x + i);
+            float32x4_t y = vld1q_f32(table.y + i);
+            float32x4_t z = vld1q_f32(table.z + i);
+            float32x4_t negativeRadius = vnegq_f32(vld1q_f32(table.radius + i));
+
+            uint32x4_t inside = vdupq_n_u32(0xFFFFFFFF);
+            for (const auto &plane: frustum) {
+                float32x4_t distance = vfmaq_n_f32(vfmaq_n_f32(vfmaq_n_f32(vdupq_n_f32(plane.d), z, plane.c),
+                                                               y, plane.b), x, plane.a);
+                inside = vandq_u32(inside, vcgeq_f32(distance, negativeRadius));
+            }
+
+            uint32_t mask = vaddvq_u32(vandq_u32(inside, laneBits));
+            while (mask != 0) {
+                output[visibleCount++] = i + static_cast<uint32_t>(std::countr_zero(mask));
+                mask &= mask - 1;
+            }
+        }
+
+        return visibleCount + cullScalar(table, i, last, frustum, output + visibleCount);
+    }
+#endif
+
+    struct KernelSelection
+    {
+        CullKernel kernel;
+        const char *name;
+    };
+
+    KernelSelection selectKernel() {
+#ifdef FRUSTUM_CULLER_AVX2
+        if (supportsAvx2()) {
+            return {cullAvx2, "AVX2"};
+        }
+#endif
+#ifdef FRUSTUM_CULLER_NEON
+        return {cullNeon, "NEON"};
+#else
+        return {cullScalar, "scalar"};
+#endif
+    }
+
+    const KernelSelection &getKernelSelection() {
+        static const KernelSelection selection = selectKernel();
+        return selection;
+    }
+}
+
+FrustumCuller::Frustum FrustumCuller::extractFrustum(const float *viewProjection) {
+    // Row r of the column-major matrix is (m[r], m[4 + r], m[8 + r], m[12 + r])
+    auto row = [viewProjection](int r) {
+        return std::array<float, 4>{viewProjection[r], viewProjection[4 + r], viewProjection[8 + r],
+                                    viewProjection[12 + r]};
+    };
+
+    std::array<float, 4> x = row(0), y = row(1), z = row(2), w = row(3);
+
+    auto makePlane = [](const std::array<float, 4> &first, const std::array<float, 4> &second, float sign) {
+        Plane plane{first[0] + sign * second[0], first[1] + sign * second[1], first[2] + sign * second[2],
+                    first[3] + sign * second[3]};
+
+        float length = std::sqrt(plane.a * plane.a + plane.b * plane.b + plane.c * plane.c);
+        return Plane{plane.a / length, plane.b / length, plane.c / length, plane.d / length};
+    };
+
+    // With depth in [0, 1] the near plane is z >= 0 rather than z >= -w
+    return {makePlane(w, x, 1.0f), makePlane(w, x, -1.0f),
+            makePlane(w, y, 1.0f), makePlane(w, y, -1.0f),
+            makePlane(z, z, 0.0f), makePlane(w, z, -1.0f)};
+}
+
+const char *FrustumCuller::getKernelName() {
+    return getKernelSelection().name;
+}
+
+void FrustumCuller::resize(uint32_t objectCount) {
+    centerX.resize(objectCount);
+    centerY.resize(objectCount);
+    centerZ.resize(objectCount);
+    radii.resize(objectCount);
+}
+
+uint32_t FrustumCuller::getObjectCount() const {
+    return static_cast<uint32_t>(radii.size());
+}
+
+void FrustumCuller::setSphere(uint32_t objectIndex, float x, float y, float z, float radius) {
+    centerX[objectIndex] = x;
+    centerY[objectIndex] = y;
+    centerZ[objectIndex] = z;
+    radii[objectIndex] = radius;
+}
+
+void FrustumCuller::cull(const Frustum &frustum, ThreadPool &threadPool) {
+    auto startTime = Clock::now();
+
+    uint32_t objectCount = getObjectCount();
+    CullKernel kernel = getKernelSelection().kernel;
+    SphereTable table{centerX.data(), centerY.data(), centerZ.data(), radii.data()};
+
+    uint32_t rangeCount = objectCount < PARALLEL_THRESHOLD ? 1 : threadPool.getThreadCount() * 4;
+    if (rangeVisibleObjects.size() < rangeCount) {
+        rangeVisibleObjects.resize(rangeCount);
+    }
+
+    // Range boundaries are kept on 8-object blocks so only the last range has a scalar tail
+    auto rangeStart = [&](uint32_t rangeIndex) {
+        if (rangeIndex == rangeCount) {
+            return objectCount;
+        }
+        return static_cast<uint32_t>(uint64_t(objectCount) * rangeIndex / rangeCount) & ~7u;
+    };
+
+    threadPool.parallelFor(rangeCount, [&](uint32_t rangeIndex) {
+        uint32_t first = rangeStart(rangeIndex);
+        uint32_t last = rangeStart(rangeIndex + 1);
+
+        std::vector<uint32_t> &output = rangeVisibleObjects[rangeIndex];
+        output.resize(last - first);
+        output.resize(kernel(table, first, last, frustum, output.data()));
+    });
+
+    visibleObjects.clear();
+    for (uint32_t rangeIndex = 0; rangeIndex < rangeCount; rangeIndex++) {
+        visibleObjects.insert(visibleObjects.end(), rangeVisibleObjects[rangeIndex].begin(),
+                              rangeVisibleObjects[rangeIndex].end());
+    }
+
+    recordCullTime(Clock::now() - startTime);
+}
+
+void FrustumCuller::cullNone() {
+    uint32_t objectCount = getObjectCount();
+    if (visibleObjects.size() == objectCount) {
+        return;
+    }
+
+    visibleObjects.resize(objectCount);
+    for (uint32_t i = 0; i < objectCount; i++) {
+        visibleObjects[i] = i;
+    }
+}
+
+const std::vector<uint32_t> &FrustumCuller::getVisibleObjects() const {
+    return visibleObjects;
+}
+
+std::string FrustumCuller::buildReport() {
+    double averageMilliseconds = windowCullCount > 0 ? 1000.0 * windowCullSeconds / windowCullCount : 0.0;
+
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "Culling (%s): %zu visible, %zu culled of %u objects | %.3f ms avg, %.3f ms max",
+                  getKernelName(), visibleObjects.size(), getObjectCount() - visibleObjects.size(), getObjectCount(),
+                  averageMilliseconds, 1000.0 * windowMaxCullSeconds);
+
+    windowCullCount = 0;
+    windowCullSeconds = 0.0;
+    windowMaxCullSeconds = 0.0;
+
+    return line;
+}
+
+void FrustumCuller::recordCullTime(std::chrono::duration<double> time) {
+    windowCullCount++;
+    windowCullSeconds += time.count();
+    windowMaxCullSeconds = std::max(windowMaxCullSeconds, time.count());
+}
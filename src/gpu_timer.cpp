@@ -0,0 +1,120 @@
+#include "gpu_timer.hpp"
+
+#include <cstdio>
+#include <stdexcept>
+
+void GpuTimer::initialize(vk::Device device, vk::PhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+                          uint32_t frameCount, std::vector<std::string> names) {
+    sectionNames = std::move(names);
+    windowSectionMilliseconds.assign(sectionNames.size(), 0.0);
+    timestamps.resize(sectionNames.size() + 1);
+
+    uint32_t validBits = physicalDevice.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits;
+    if (validBits == 0) {
+        return;
+    }
+
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    timestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+
+    vk::QueryPoolCreateInfo queryPoolCreateInfo = vk::QueryPoolCreateInfo()
+            .setQueryType(vk::QueryType::eTimestamp)
+            .setQueryCount(static_cast<uint32_t>(timestamps.size()));
+
+    queryPools.resize(frameCount);
+    queryPoolsRecorded.assign(frameCount, false);
+
+    for (auto &queryPool: queryPools) {
+        vk::Result result = device.createQueryPool(&queryPoolCreateInfo, nullptr, &queryPool);
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Failed to create timestamp query pool! Error Code: " + vk::to_string(result));
+        }
+    }
+}
+
+void GpuTimer::destroy(vk::Device device) {
+    for (auto queryPool: queryPools) {
+        device.destroyQueryPool(queryPool);
+    }
+    queryPools.clear();
+}
+
+bool GpuTimer::isSupported() const {
+    return !queryPools.empty();
+}
+
+void GpuTimer::reset(vk::CommandBuffer commandBuffer, uint32_t frameIndex) {
+    if (!isSupported()) {
+        return;
+    }
+
+    commandBuffer.resetQueryPool(queryPools[frameIndex], 0, static_cast<uint32_t>(timestamps.size()));
+    // Recorded buffers are always submitted, so by the time the slot comes around again the queries are valid
+    queryPoolsRecorded[frameIndex] = true;
+}
+
+void GpuTimer::writeTimestamp(vk::CommandBuffer commandBuffer, uint32_t frameIndex, uint32_t timestampIndex,
+                              vk::PipelineStageFlags2 stage) {
+    if (!isSupported()) {
+        return;
+    }
+
+    commandBuffer.writeTimestamp2(stage, queryPools[frameIndex], timestampIndex);
+}
+
+bool GpuTimer::collect(vk::Device device, uint32_t frameIndex) {
+    if (!isSupported() || !queryPoolsRecorded[frameIndex]) {
+        return false;
+    }
+
+    // No wait flag: the caller has already waited for the submission, and a slot whose last buffer wrote no
+    // timestamps reports not ready instead of blocking
+    vk::Result result = device.getQueryPoolResults(queryPools[frameIndex], 0, static_cast<uint32_t>(timestamps.size()),
+                                                   timestamps.size() * sizeof(uint64_t), timestamps.data(),
+                                                   sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+        return false;
+    }
+
+    lastFrameMilliseconds = 0.0;
+    for (size_t i = 0; i < sectionNames.size(); i++) {
+        uint64_t ticks = (timestamps[i + 1] - timestamps[i]) & timestampMask;
+        double milliseconds = static_cast<double>(ticks) * timestampPeriod / 1'000'000.0;
+
+        windowSectionMilliseconds[i] += milliseconds;
+        lastFrameMilliseconds += milliseconds;
+    }
+    windowFrameCount++;
+
+    return true;
+}
+
+double GpuTimer::getLastFrameMilliseconds() const {
+    return lastFrameMilliseconds;
+}
+
+std::string GpuTimer::buildReport() {
+    if (!isSupported()) {
+        return "GPU timings unavailable: the graphics queue has no timestamp support";
+    }
+
+    std::string report = "GPU";
+    double total = 0.0;
+    char section[128];
+
+    for (size_t i = 0; i < sectionNames.size(); i++) {
+        double average = windowFrameCount > 0 ? windowSectionMilliseconds[i] / windowFrameCount : 0.0;
+        total += average;
+
+        std::snprintf(section, sizeof(section), "%s %s %.3f ms", i == 0 ? ":" : " |", sectionNames[i].c_str(),
+                      average);
+        report += section;
+        windowSectionMilliseconds[i] = 0.0;
+    }
+
+    std::snprintf(section, sizeof(section), " | total %.3f ms", total);
+    report += section;
+    windowFrameCount = 0;
+
+    return report;
+}
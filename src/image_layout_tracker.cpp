@@ -0,0 +1,216 @@
+#include "image_layout_tracker.hpp"
+
+#include <stdexcept>
+
+namespace {
+    constexpr vk::AccessFlags2 WRITE_ACCESS_MASK =
+            vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eShaderStorageWrite |
+            vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+            vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eHostWrite | vk::AccessFlagBits2::eMemoryWrite;
+
+    bool isWriteAccess(vk::AccessFlags2 accessMask) {
+        return static_cast<bool>(accessMask & WRITE_ACCESS_MASK);
+    }
+
+    bool operator==(const ImageLayoutTracker::SubresourceState &left,
+                    const ImageLayoutTracker::SubresourceState &right) {
+        return left.layout == right.layout && left.stageMask == right.stageMask &&
+               left.accessMask == right.accessMask;
+    }
+}
+
+void ImageLayoutTracker::registerImage(vk::Image image, vk::ImageAspectFlags aspectMask, uint32_t mipLevels,
+                                       uint32_t arrayLayers, vk::ImageLayout initialLayout) {
+    TrackedImage trackedImage{};
+    trackedImage.aspectMask = aspectMask;
+    trackedImage.mipLevels = mipLevels;
+    trackedImage.arrayLayers = arrayLayers;
+
+    SubresourceState initialState{};
+    initialState.layout = initialLayout;
+
+    trackedImage.subresources.assign(mipLevels * arrayLayers, initialState);
+    trackedImage.pending.assign(mipLevels * arrayLayers, false);
+
+    images[static_cast<VkImage>(image)] = std::move(trackedImage);
+}
+
+void ImageLayoutTracker::unregisterImage(vk::Image image) {
+    images.erase(static_cast<VkImage>(image));
+}
+
+ImageLayoutTracker::TrackedImage &ImageLayoutTracker::getTrackedImage(vk::Image image) {
+    auto trackedImage = images.find(static_cast<VkImage>(image));
+    if (trackedImage == images.end()) {
+        throw std::invalid_argument("Image is not registered with the layout tracker!");
+    }
+
+    return trackedImage->second;
+}
+
+void ImageLayoutTracker::transition(vk::CommandBuffer commandBuffer, vk::Image image,
+                                    const vk::ImageSubresourceRange &range, vk::ImageLayout newLayout,
+                                    vk::PipelineStageFlags2 stageMask, vk::AccessFlags2 accessMask) {
+    TrackedImage &trackedImage = getTrackedImage(image);
+
+    uint32_t levelCount = range.levelCount == vk::RemainingMipLevels ? trackedImage.mipLevels - range.baseMipLevel
+                                                                     : range.levelCount;
+    uint32_t layerCount = range.layerCount == vk::RemainingArrayLayers ? trackedImage.arrayLayers -
+                                                                         range.baseArrayLayer : range.layerCount;
+
+    for (uint32_t layer = range.baseArrayLayer; layer < range.baseArrayLayer + layerCount; layer++) {
+        for (uint32_t level = range.baseMipLevel; level < range.baseMipLevel + levelCount; level++) {
+            if (trackedImage.pending[layer * trackedImage.mipLevels + level]) {
+                flush(commandBuffer);
+                break;
+            }
+        }
+    }
+
+    for (uint32_t layer = range.baseArrayLayer; layer < range.baseArrayLayer + layerCount; layer++) {
+        uint32_t level = range.baseMipLevel;
+
+        while (level < range.baseMipLevel + levelCount) {
+            // Consecutive mip levels in the same state share one barrier
+            size_t firstIndex = layer * trackedImage.mipLevels + level;
+            SubresourceState oldState = trackedImage.subresources[firstIndex];
+
+            uint32_t runLength = 1;
+            while (level + runLength < range.baseMipLevel + levelCount &&
+                   trackedImage.subresources[firstIndex + runLength] == oldState) {
+                runLength++;
+            }
+
+            bool layoutChanges = oldState.layout != newLayout || newLayout == vk::ImageLayout::eUndefined;
+            bool hazard = isWriteAccess(oldState.accessMask) || isWriteAccess(accessMask);
+            // Without a layout change there is nothing to wait for if no earlier use was declared
+            bool needsBarrier = layoutChanges || (hazard && oldState.stageMask != vk::PipelineStageFlagBits2::eNone);
+
+            for (uint32_t i = 0; i < runLength; i++) {
+                SubresourceState &state = trackedImage.subresources[firstIndex + i];
+
+                if (needsBarrier) {
+                    state = SubresourceState{newLayout, stageMask, accessMask};
+                    trackedImage.pending[firstIndex + i] = true;
+                    pendingSubresources.emplace_back(static_cast<VkImage>(image), firstIndex + i);
+                } else if (hazard) {
+                    state = SubresourceState{newLayout, stageMask, accessMask};
+                } else {
+                    // Read after read in the same layout: later writers have to wait for these readers too
+                    state.stageMask |= stageMask;
+                    state.accessMask |= accessMask;
+                }
+            }
+
+            if (needsBarrier) {
+                pendingBarriers.push_back(vk::ImageMemoryBarrier2()
+                                                  .setSrcStageMask(oldState.stageMask)
+                                                  .setSrcAccessMask(oldState.accessMask)
+                                                  .setDstStageMask(stageMask)
+                                                  .setDstAccessMask(accessMask)
+                                                  .setOldLayout(oldState.layout)
+                                                  .setNewLayout(newLayout)
+                                                  .setSrcQueueFamilyIndex(vk::QueueFamilyIgnored)
+                                                  .setDstQueueFamilyIndex(vk::QueueFamilyIgnored)
+                                                  .setImage(image)
+                                                  .setSubresourceRange(vk::ImageSubresourceRange(
+                                                          trackedImage.aspectMask, level, runLength, layer, 1)));
+            } else {
+                skippedTransitionCount++;
+            }
+
+            level += runLength;
+        }
+    }
+}
+
+void ImageLayoutTracker::transition(vk::CommandBuffer commandBuffer, vk::Image image,
+                                    const vk::ImageSubresourceRange &range, vk::ImageLayout newLayout) {
+    SubresourceState state = getDefaultState(newLayout);
+    transition(commandBuffer, image, range, newLayout, state.stageMask, state.accessMask);
+}
+
+void ImageLayoutTracker::setState(vk::Image image, const vk::ImageSubresourceRange &range,
+                                  const SubresourceState &state) {
+    TrackedImage &trackedImage = getTrackedImage(image);
+
+    uint32_t levelCount = range.levelCount == vk::RemainingMipLevels ? trackedImage.mipLevels - range.baseMipLevel
+                                                                     : range.levelCount;
+    uint32_t layerCount = range.layerCount == vk::RemainingArrayLayers ? trackedImage.arrayLayers -
+                                                                         range.baseArrayLayer : range.layerCount;
+
+    for (uint32_t layer = range.baseArrayLayer; layer < range.baseArrayLayer + layerCount; layer++) {
+        for (uint32_t level = range.baseMipLevel; level < range.baseMipLevel + levelCount; level++) {
+            trackedImage.subresources[layer * trackedImage.mipLevels + level] = state;
+        }
+    }
+}
+
+ImageLayoutTracker::SubresourceState ImageLayoutTracker::getState(vk::Image image, uint32_t mipLevel,
+                                                                  uint32_t arrayLayer) const {
+    auto trackedImage = images.find(static_cast<VkImage>(image));
+    if (trackedImage == images.end()) {
+        throw std::invalid_argument("Image is not registered with the layout tracker!");
+    }
+
+    return trackedImage->second.subresources[arrayLayer * trackedImage->second.mipLevels + mipLevel];
+}
+
+void ImageLayoutTracker::flush(vk::CommandBuffer commandBuffer) {
+    if (pendingBarriers.empty()) {
+        return;
+    }
+
+    vk::DependencyInfo dependencyInfo = vk::DependencyInfo()
+            .setImageMemoryBarrierCount(static_cast<uint32_t>(pendingBarriers.size()))
+            .setPImageMemoryBarriers(pendingBarriers.data());
+
+    commandBuffer.pipelineBarrier2(&dependencyInfo);
+
+    flushedBarrierCount += static_cast<uint32_t>(pendingBarriers.size());
+    pendingBarriers.clear();
+
+    for (const auto &[image, index]: pendingSubresources) {
+        auto trackedImage = images.find(image);
+        if (trackedImage != images.end()) {
+            trackedImage->second.pending[index] = false;
+        }
+    }
+    pendingSubresources.clear();
+}
+
+uint32_t ImageLayoutTracker::getFlushedBarrierCount() const {
+    return flushedBarrierCount;
+}
+
+uint32_t ImageLayoutTracker::getSkippedTransitionCount() const {
+    return skippedTransitionCount;
+}
+
+ImageLayoutTracker::SubresourceState ImageLayoutTracker::getDefaultState(vk::ImageLayout layout) {
+    switch (layout) {
+        case vk::ImageLayout::eTransferDstOptimal:
+            return {layout, vk::PipelineStageFlagBits2::eCopy | vk::PipelineStageFlagBits2::eBlit,
+                    vk::AccessFlagBits2::eTransferWrite};
+        case vk::ImageLayout::eTransferSrcOptimal:
+            return {layout, vk::PipelineStageFlagBits2::eCopy | vk::PipelineStageFlagBits2::eBlit,
+                    vk::AccessFlagBits2::eTransferRead};
+        case vk::ImageLayout::eShaderReadOnlyOptimal:
+            return {layout, vk::PipelineStageFlagBits2::eFragmentShader, vk::AccessFlagBits2::eShaderSampledRead};
+        case vk::ImageLayout::eColorAttachmentOptimal:
+            return {layout, vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                    vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite};
+        case vk::ImageLayout::eDepthAttachmentOptimal:
+        case vk::ImageLayout::eDepthStencilAttachmentOptimal:
+            return {layout,
+                    vk::PipelineStageFlagBits2::eEarlyFragmentTests | vk::PipelineStageFlagBits2::eLateFragmentTests,
+                    vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+                    vk::AccessFlagBits2::eDepthStencilAttachmentWrite};
+        case vk::ImageLayout::ePresentSrcKHR:
+            // Presentation is synchronised by the present semaphore, not by the barrier
+            return {layout, vk::PipelineStageFlagBits2::eNone, vk::AccessFlagBits2::eNone};
+        default:
+            return {layout, vk::PipelineStageFlagBits2::eAllCommands,
+                    vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite};
+    }
+}
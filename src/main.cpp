@@ -1,10 +1,10 @@
 #include "application.hpp"
 
-int main()
+int main(int argc, char **argv)
 {
-    Application app;
     try
     {
+        Application app(Settings::fromCommandLine(argc, argv));
         app.Run();
     }
     catch(const std::exception& e)
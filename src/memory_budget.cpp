@@ -0,0 +1,147 @@
+#include "memory_budget.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+    // Share of a heap assumed to be available to the application when the driver reports no budget
+    constexpr double FALLBACK_BUDGET_SHARE = 0.8;
+
+    double toMebibytes(vk::DeviceSize size) {
+        return static_cast<double>(size) / (1024.0 * 1024.0);
+    }
+}
+
+void MemoryBudget::initialize(vk::PhysicalDevice device, bool extensionEnabled, vk::DeviceSize budgetLimit) {
+    physicalDevice = device;
+    budgetExtensionEnabled = extensionEnabled;
+    deviceLocalBudgetLimit = budgetLimit;
+
+    physicalDevice.getMemoryProperties(&memoryProperties);
+
+    heapBudgets.assign(memoryProperties.memoryHeapCount, 0);
+    heapUsages.assign(memoryProperties.memoryHeapCount, 0);
+    trackedHeapUsages.assign(memoryProperties.memoryHeapCount, 0);
+
+    update();
+}
+
+void MemoryBudget::update() {
+    vk::PhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties;
+    if (budgetExtensionEnabled) {
+        vk::PhysicalDeviceMemoryProperties2 memoryProperties2 = vk::PhysicalDeviceMemoryProperties2()
+                .setPNext(&budgetProperties);
+        physicalDevice.getMemoryProperties2(&memoryProperties2);
+    }
+
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        if (budgetExtensionEnabled) {
+            heapBudgets[i] = budgetProperties.heapBudget[i];
+            heapUsages[i] = budgetProperties.heapUsage[i];
+        } else {
+            heapBudgets[i] = static_cast<vk::DeviceSize>(
+                    static_cast<double>(memoryProperties.memoryHeaps[i].size) * FALLBACK_BUDGET_SHARE);
+            heapUsages[i] = trackedHeapUsages[i];
+        }
+
+        if (deviceLocalBudgetLimit != 0 && isDeviceLocalHeap(i)) {
+            heapBudgets[i] = std::min(heapBudgets[i], deviceLocalBudgetLimit);
+        }
+    }
+}
+
+void MemoryBudget::trackAllocation(vk::DeviceMemory memory, MemoryCategory category, uint32_t memoryTypeIndex,
+                                   vk::DeviceSize size) {
+    uint32_t heapIndex = getHeapIndex(memoryTypeIndex);
+
+    allocations[memory] = {category, heapIndex, size};
+    trackedHeapUsages[heapIndex] += size;
+    categoryUsages[static_cast<size_t>(category)] += size;
+}
+
+void MemoryBudget::trackFree(vk::DeviceMemory memory) {
+    auto allocation = allocations.find(memory);
+    if (allocation == allocations.end()) {
+        return;
+    }
+
+    trackedHeapUsages[allocation->second.heapIndex] -= allocation->second.size;
+    categoryUsages[static_cast<size_t>(allocation->second.category)] -= allocation->second.size;
+    allocations.erase(allocation);
+}
+
+uint32_t MemoryBudget::getHeapCount() const {
+    return memoryProperties.memoryHeapCount;
+}
+
+uint32_t MemoryBudget::getHeapIndex(uint32_t memoryTypeIndex) const {
+    return memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+}
+
+bool MemoryBudget::isDeviceLocalHeap(uint32_t heapIndex) const {
+    return static_cast<bool>(memoryProperties.memoryHeaps[heapIndex].flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+}
+
+vk::DeviceSize MemoryBudget::getHeapBudget(uint32_t heapIndex) const {
+    return heapBudgets[heapIndex];
+}
+
+vk::DeviceSize MemoryBudget::getHeapUsage(uint32_t heapIndex) const {
+    // The driver's figure lags behind allocations made since the last update, so never report less than was tracked
+    return std::max(heapUsages[heapIndex], trackedHeapUsages[heapIndex]);
+}
+
+vk::DeviceSize MemoryBudget::getCategoryUsage(MemoryCategory category) const {
+    return categoryUsages[static_cast<size_t>(category)];
+}
+
+vk::DeviceSize MemoryBudget::getDeviceLocalOverBudget() const {
+    vk::DeviceSize overBudget = 0;
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        if (isDeviceLocalHeap(i) && getHeapUsage(i) > heapBudgets[i]) {
+            overBudget += getHeapUsage(i) - heapBudgets[i];
+        }
+    }
+
+    return overBudget;
+}
+
+std::string MemoryBudget::buildReport() const {
+    std::string report = "memory:";
+
+    char line[160];
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        std::snprintf(line, sizeof(line), " heap %u%s %.1f / %.1f MiB |", i, isDeviceLocalHeap(i) ? " (local)" : "",
+                      toMebibytes(getHeapUsage(i)), toMebibytes(heapBudgets[i]));
+        report += line;
+    }
+
+    for (size_t i = 0; i < categoryUsages.size(); i++) {
+        std::snprintf(line, sizeof(line), " %s %.1f MiB", getCategoryName(static_cast<MemoryCategory>(i)),
+                      toMebibytes(categoryUsages[i]));
+        report += line;
+    }
+
+    return report;
+}
+
+const char *MemoryBudget::getCategoryName(MemoryCategory category) {
+    switch (category) {
+        case MemoryCategory::Geometry:
+            return "geometry";
+        case MemoryCategory::Textures:
+            return "textures";
+        case MemoryCategory::RenderTargets:
+            return "render targets";
+        case MemoryCategory::Staging:
+            return "staging";
+        case MemoryCategory::Uniforms:
+            return "uniforms";
+        case MemoryCategory::Instances:
+            return "instances";
+        case MemoryCategory::Lights:
+            return "lights";
+        default:
+            return "unknown";
+    }
+}
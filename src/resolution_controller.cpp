@@ -0,0 +1,133 @@
+#include "resolution_controller.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace {
+    // Scales are multiples of this, so small swings in GPU time don't re-record the command buffers
+    constexpr float SCALE_STEP = 1.0f / 16.0f;
+    // Weight of the newest frame in the smoothed GPU time
+    constexpr double SMOOTHING = 0.1;
+    // Frames still in flight after a change were recorded at the old scale, so its effect is only judged after these
+    constexpr uint32_t SETTLE_FRAMES = 8;
+    // A new scale aims this far below the target, so it doesn't land right at it
+    constexpr double AIM = 0.9;
+    // Scaling up waits for this many frames under this fraction of the target, and rises at most two steps
+    constexpr double HEADROOM = 0.8;
+    constexpr uint32_t HEADROOM_FRAMES = 30;
+    constexpr float MAXIMUM_INCREASE = 2.0f * SCALE_STEP;
+    // Frames over the target at the minimum scale before fewer samples are requested
+    constexpr uint32_t PRESSURE_FRAMES = 30;
+}
+
+void ResolutionController::configure(double target, float minimum) {
+    targetMilliseconds = target;
+    minimumScale = std::clamp(std::ceil(minimum / SCALE_STEP) * SCALE_STEP, SCALE_STEP, 1.0f);
+    scale = 1.0f;
+    restartMeasurement();
+}
+
+bool ResolutionController::recordFrame(double gpuMilliseconds) {
+    windowFrameCount++;
+    if (gpuMilliseconds > targetMilliseconds) {
+        windowOverTargetFrames++;
+    }
+    windowMinimumScale = std::min(windowMinimumScale, scale);
+    windowMaximumScale = std::max(windowMaximumScale, scale);
+
+    smoothedMilliseconds = hasMeasurement ? smoothedMilliseconds + SMOOTHING * (gpuMilliseconds - smoothedMilliseconds)
+                                          : gpuMilliseconds;
+    hasMeasurement = true;
+
+    if (++framesSinceChange < SETTLE_FRAMES || smoothedMilliseconds <= 0.0) {
+        return false;
+    }
+
+    // The largest step whose predicted time stays below the aim
+    float fittingScale = scale * static_cast<float>(std::sqrt(AIM * targetMilliseconds / smoothedMilliseconds));
+    fittingScale = std::floor(fittingScale / SCALE_STEP) * SCALE_STEP;
+
+    if (smoothedMilliseconds > targetMilliseconds) {
+        headroomFrames = 0;
+
+        float lowerScale = std::max(fittingScale, minimumScale);
+        if (lowerScale < scale) {
+            return applyScale(lowerScale);
+        }
+
+        if (++pressureFrames >= PRESSURE_FRAMES) {
+            sampleRequest = SampleRequest::Fewer;
+            pressureFrames = 0;
+        }
+        return false;
+    }
+
+    pressureFrames = 0;
+    if (smoothedMilliseconds > HEADROOM * targetMilliseconds) {
+        headroomFrames = 0;
+        return false;
+    }
+
+    if (++headroomFrames < HEADROOM_FRAMES) {
+        return false;
+    }
+    headroomFrames = 0;
+
+    if (scale < 1.0f) {
+        float higherScale = std::min({fittingScale, scale + MAXIMUM_INCREASE, 1.0f});
+        return higherScale > scale && applyScale(higherScale);
+    }
+
+    sampleRequest = SampleRequest::More;
+    return false;
+}
+
+bool ResolutionController::applyScale(float newScale) {
+    // Predict the time at the new scale, so the frames still in flight at the old one don't trigger another change
+    smoothedMilliseconds *= static_cast<double>(newScale * newScale) / (scale * scale);
+    scale = newScale;
+    framesSinceChange = 0;
+    windowScaleChanges++;
+
+    return true;
+}
+
+float ResolutionController::getScale() const {
+    return scale;
+}
+
+ResolutionController::SampleRequest ResolutionController::takeSampleRequest() {
+    SampleRequest request = sampleRequest;
+    sampleRequest = SampleRequest::None;
+
+    return request;
+}
+
+void ResolutionController::restartMeasurement() {
+    hasMeasurement = false;
+    framesSinceChange = 0;
+    pressureFrames = 0;
+    headroomFrames = 0;
+    sampleRequest = SampleRequest::None;
+}
+
+std::string ResolutionController::buildReport(uint32_t sampleCount) {
+    double overTarget = windowFrameCount > 0 ? 100.0 * windowOverTargetFrames / windowFrameCount : 0.0;
+
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "Resolution: %.0f%% scale (%.0f%%-%.0f%%), %llu changes | %ux MSAA | GPU %.3f ms smoothed, "
+                  "target %.3f ms, %.1f%% of frames over",
+                  100.0 * scale, 100.0 * std::min(windowMinimumScale, scale),
+                  100.0 * std::max(windowMaximumScale, scale), static_cast<unsigned long long>(windowScaleChanges),
+                  sampleCount, smoothedMilliseconds, targetMilliseconds, overTarget);
+
+    windowFrameCount = 0;
+    windowOverTargetFrames = 0;
+    windowScaleChanges = 0;
+    windowMinimumScale = 1.0f;
+    windowMaximumScale = 0.0f;
+
+    return line;
+}
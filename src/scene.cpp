@@ -0,0 +1,440 @@
+#include "scene.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "stb_image/stb_image.h"
+
+namespace {
+    // Followed by the mesh, texture, material and instance counts, then the paths as a length and the bytes, the
+    // materials and the instances. Counts, lengths and structs are stored as they are in memory, so a binary scene is
+    // only readable on machines with the byte order and struct layout of the one that saved it
+    constexpr char BINARY_MAGIC[8] = {'V', 'K', 'S', 'C', 'E', 'N', 'E', '1'};
+
+    std::string readFile(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open " + path + "!");
+        }
+
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    // FNV-1a, to find files with the same contents under different paths
+    uint64_t hashContents(const std::string &contents) {
+        uint64_t hash = 14695981039346656037ull;
+        for (char byte: contents) {
+            hash = (hash ^ static_cast<unsigned char>(byte)) * 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    std::string resolvePath(const std::filesystem::path &directory, const std::string &path) {
+        return (directory / path).lexically_normal().string();
+    }
+
+    // Reads fixed-size values from a binary scene, failing on truncated files
+    class BinaryReader
+    {
+    public:
+        BinaryReader(const std::string &path, const std::string &data) : path(path), data(data) {}
+
+        void read(void *destination, size_t size) {
+            if (data.size() - offset < size) {
+                throw std::runtime_error("Scene " + path + " is truncated!");
+            }
+
+            memcpy(destination, data.data() + offset, size);
+            offset += size;
+        }
+
+        uint32_t readUnsigned() {
+            uint32_t value;
+            read(&value, sizeof(value));
+            return value;
+        }
+
+        std::string readString() {
+            // The length is checked before the string is allocated for it
+            uint32_t length = readUnsigned();
+            if (length > data.size() - offset) {
+                throw std::runtime_error("Scene " + path + " is truncated!");
+            }
+
+            std::string value(length, '\0');
+            read(value.data(), value.size());
+            return value;
+        }
+
+    private:
+        const std::string &path;
+        const std::string &data;
+        size_t offset = 0;
+    };
+
+    void writeUnsigned(std::ofstream &file, uint32_t value) {
+        file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void writeString(std::ofstream &file, const std::string &value) {
+        writeUnsigned(file, static_cast<uint32_t>(value.size()));
+        file.write(value.data(), static_cast<std::streamsize>(value.size()));
+    }
+}
+
+SceneDescription SceneDescription::load(const std::string &path) {
+    std::string data = readFile(path);
+
+    SceneDescription scene = data.size() >= sizeof(BINARY_MAGIC) &&
+                             memcmp(data.data(), BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0
+                             ? parseBinary(path, data) : parseText(path, data);
+    scene.validate(path);
+
+    return scene;
+}
+
+SceneDescription SceneDescription::parseText(const std::string &path, const std::string &text) {
+    SceneDescription scene;
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+    std::unordered_map<std::string, uint32_t> meshNames;
+    std::unordered_map<std::string, uint32_t> textureNames;
+    std::unordered_map<std::string, uint32_t> materialNames;
+
+    std::istringstream lines(text);
+    std::string line;
+    uint32_t lineNumber = 0;
+
+    while (std::getline(lines, line)) {
+        lineNumber++;
+        auto fail = [&](const std::string &message) {
+            throw std::runtime_error("Scene " + path + " line " + std::to_string(lineNumber) + ": " + message);
+        };
+
+        std::istringstream tokens(line.substr(0, line.find('#')));
+        std::string directive;
+        if (!(tokens >> directive)) {
+            continue;
+        }
+
+        // Trailing tokens are an error rather than ignored, so a mistyped line doesn't quietly load as something else
+        auto expectEnd = [&]() {
+            std::string extra;
+            if (tokens >> extra) {
+                fail("unexpected '" + extra + "' after " + directive);
+            }
+        };
+
+        auto lookUp = [&](const std::unordered_map<std::string, uint32_t> &names, const std::string &name) {
+            auto found = names.find(name);
+            if (found == names.end()) {
+                fail("unknown name '" + name + "'");
+            }
+            return found->second;
+        };
+
+        if (directive == "mesh" || directive == "texture") {
+            std::string name, assetPath;
+            if (!(tokens >> name >> assetPath)) {
+                fail("expected " + directive + " <name> <path>");
+            }
+
+            std::vector<std::string> &paths = directive == "mesh" ? scene.meshPaths : scene.texturePaths;
+            auto &names = directive == "mesh" ? meshNames : textureNames;
+            if (!names.emplace(name, static_cast<uint32_t>(paths.size())).second) {
+                fail(directive + " '" + name + "' is already defined");
+            }
+            expectEnd();
+            paths.push_back(resolvePath(directory, assetPath));
+        } else if (directive == "material") {
+            std::string name, texture;
+            if (!(tokens >> name >> texture)) {
+                fail("expected material <name> <texture>");
+            }
+
+            if (!materialNames.emplace(name, static_cast<uint32_t>(scene.materials.size())).second) {
+                fail("material '" + name + "' is already defined");
+            }
+            expectEnd();
+            scene.materials.push_back({lookUp(textureNames, texture)});
+        } else if (directive == "instance") {
+            const char *usage = "expected instance <mesh> <material> <x> <y> <z> [<angle> [<scale>]]";
+            std::string mesh, material;
+            Instance instance{};
+            if (!(tokens >> mesh >> material >> instance.translation[0] >> instance.translation[1] >>
+                         instance.translation[2])) {
+                fail(usage);
+            }
+
+            // The optional values are only read when there is something left, so one that doesn't parse fails
+            float angle = 0.0f;
+            instance.scale = 1.0f;
+            if (!(tokens >> std::ws).eof() && !(tokens >> angle)) {
+                fail(usage);
+            }
+            if (!(tokens >> std::ws).eof() && !(tokens >> instance.scale)) {
+                fail(usage);
+            }
+            expectEnd();
+
+            float halfAngle = 0.5f * angle * 3.14159265f / 180.0f;
+            instance.mesh = lookUp(meshNames, mesh);
+            instance.material = lookUp(materialNames, material);
+            instance.rotation[2] = std::sin(halfAngle);
+            instance.rotation[3] = std::cos(halfAngle);
+            scene.instances.push_back(instance);
+        } else if (directive == "grid") {
+            std::string mesh, material;
+            uint32_t columns = 0, rows = 0;
+            float spacing = 0.0f;
+            if (!(tokens >> mesh >> material >> columns >> rows >> spacing)) {
+                fail("expected grid <mesh> <material> <columns> <rows> <spacing>");
+            }
+            expectEnd();
+
+            Instance instance{};
+            instance.mesh = lookUp(meshNames, mesh);
+            instance.material = lookUp(materialNames, material);
+            instance.rotation[3] = 1.0f;
+            instance.scale = 1.0f;
+
+            for (uint32_t row = 0; row < rows; row++) {
+                for (uint32_t column = 0; column < columns; column++) {
+                    instance.translation[0] = spacing * (static_cast<float>(column) - 0.5f * (columns - 1.0f));
+                    instance.translation[1] = spacing * (static_cast<float>(row) - 0.5f * (rows - 1.0f));
+                    scene.instances.push_back(instance);
+                }
+            }
+        } else {
+            fail("unknown directive '" + directive + "'");
+        }
+    }
+
+    return scene;
+}
+
+SceneDescription SceneDescription::parseBinary(const std::string &path, const std::string &data) {
+    SceneDescription scene;
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+
+    BinaryReader reader(path, data);
+    char magic[sizeof(BINARY_MAGIC)];
+    reader.read(magic, sizeof(magic));
+
+    uint32_t meshCount = reader.readUnsigned();
+    uint32_t textureCount = reader.readUnsigned();
+    uint32_t materialCount = reader.readUnsigned();
+    uint32_t instanceCount = reader.readUnsigned();
+
+    // Counts are checked against the file size before anything is allocated for them
+    if (static_cast<uint64_t>(materialCount) * sizeof(Material) + uint64_t(instanceCount) * sizeof(Instance) >
+        data.size()) {
+        throw std::runtime_error("Scene " + path + " is truncated!");
+    }
+
+    for (uint32_t i = 0; i < meshCount; i++) {
+        scene.meshPaths.push_back(resolvePath(directory, reader.readString()));
+    }
+    for (uint32_t i = 0; i < textureCount; i++) {
+        scene.texturePaths.push_back(resolvePath(directory, reader.readString()));
+    }
+
+    scene.materials.resize(materialCount);
+    reader.read(scene.materials.data(), sizeof(Material) * materialCount);
+    scene.instances.resize(instanceCount);
+    reader.read(scene.instances.data(), sizeof(Instance) * instanceCount);
+
+    return scene;
+}
+
+void SceneDescription::validate(const std::string &path) const {
+    for (const Material &material: materials) {
+        if (material.texture >= texturePaths.size()) {
+            throw std::runtime_error("Scene " + path + " has a material with an invalid texture!");
+        }
+    }
+
+    for (const Instance &instance: instances) {
+        if (instance.mesh >= meshPaths.size() || instance.material >= materials.size()) {
+            throw std::runtime_error("Scene " + path + " has an instance with an invalid mesh or material!");
+        }
+        // Also rejects NaN. A zero scale collapses the instance and a negative one mirrors it, flipping its winding
+        if (!(instance.scale > 0.0f)) {
+            throw std::runtime_error("Scene " + path + " has an instance with a scale that isn't positive!");
+        }
+    }
+
+    if (instances.empty()) {
+        throw std::runtime_error("Scene " + path + " has no instances!");
+    }
+}
+
+void SceneDescription::saveBinary(const std::string &path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open " + path + " for writing!");
+    }
+
+    // Paths are stored relative to the binary scene, like the text scene's are to it
+    std::filesystem::path directory = std::filesystem::absolute(path).parent_path();
+    auto relativePath = [&](const std::string &assetPath) {
+        return std::filesystem::absolute(assetPath).lexically_relative(directory).generic_string();
+    };
+
+    file.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    writeUnsigned(file, static_cast<uint32_t>(meshPaths.size()));
+    writeUnsigned(file, static_cast<uint32_t>(texturePaths.size()));
+    writeUnsigned(file, static_cast<uint32_t>(materials.size()));
+    writeUnsigned(file, static_cast<uint32_t>(instances.size()));
+
+    for (const std::string &meshPath: meshPaths) {
+        writeString(file, relativePath(meshPath));
+    }
+    for (const std::string &texturePath: texturePaths) {
+        writeString(file, relativePath(texturePath));
+    }
+
+    file.write(reinterpret_cast<const char *>(materials.data()),
+               static_cast<std::streamsize>(sizeof(Material) * materials.size()));
+    file.write(reinterpret_cast<const char *>(instances.data()),
+               static_cast<std::streamsize>(sizeof(Instance) * instances.size()));
+
+    if (!file) {
+        throw std::runtime_error("Failed to write " + path + "!");
+    }
+}
+
+SceneAssets SceneAssets::fetch(const SceneDescription &scene, ThreadPool &threadPool) {
+    auto startTime = Clock::now();
+    SceneAssets assets;
+
+    // Paths that name the same file are read once. Meshes and textures are kept apart, as they decode differently
+    std::vector<std::string> filePaths;
+    std::vector<bool> fileIsModel;
+    std::unordered_map<std::string, uint32_t> fileIndices;
+
+    auto addFile = [&](const std::string &path, bool isModel) {
+        std::error_code error;
+        std::string key = std::filesystem::weakly_canonical(path, error).string();
+        if (error) {
+            key = path;
+        }
+        key += isModel ? "|model" : "|image";
+
+        auto [found, inserted] = fileIndices.emplace(key, static_cast<uint32_t>(filePaths.size()));
+        if (inserted) {
+            filePaths.push_back(path);
+            fileIsModel.push_back(isModel);
+        }
+        return found->second;
+    };
+
+    std::vector<uint32_t> meshFiles;
+    for (const std::string &path: scene.meshPaths) {
+        meshFiles.push_back(addFile(path, true));
+    }
+    std::vector<uint32_t> textureFiles;
+    for (const std::string &path: scene.texturePaths) {
+        textureFiles.push_back(addFile(path, false));
+    }
+
+    auto fileCount = static_cast<uint32_t>(filePaths.size());
+    std::vector<std::string> contents(fileCount);
+    std::vector<uint64_t> hashes(fileCount);
+
+    threadPool.parallelFor(fileCount, [&](uint32_t file) {
+        contents[file] = readFile(filePaths[file]);
+        hashes[file] = hashContents(contents[file]);
+    });
+
+    // Files with the same contents under different names share one asset. Equal hashes are confirmed byte for byte
+    std::vector<uint32_t> fileAssets(fileCount);
+    std::vector<uint32_t> decodedFiles;
+    std::unordered_multimap<uint64_t, uint32_t> filesByHash;
+
+    for (uint32_t file = 0; file < fileCount; file++) {
+        assets.bytesRead += contents[file].size();
+
+        bool duplicate = false;
+        auto [first, last] = filesByHash.equal_range(hashes[file]);
+        for (auto candidate = first; candidate != last && !duplicate; ++candidate) {
+            uint32_t other = candidate->second;
+            if (fileIsModel[other] == fileIsModel[file] && contents[other] == contents[file]) {
+                fileAssets[file] = fileAssets[other];
+                duplicate = true;
+            }
+        }
+
+        if (!duplicate) {
+            if (fileIsModel[file]) {
+                fileAssets[file] = static_cast<uint32_t>(assets.models.size());
+                assets.models.emplace_back();
+            } else {
+                fileAssets[file] = static_cast<uint32_t>(assets.images.size());
+                assets.images.emplace_back();
+            }
+            filesByHash.emplace(hashes[file], file);
+            decodedFiles.push_back(file);
+        }
+    }
+
+    threadPool.parallelFor(static_cast<uint32_t>(decodedFiles.size()), [&](uint32_t decodeIndex) {
+        uint32_t file = decodedFiles[decodeIndex];
+        const std::string &data = contents[file];
+
+        if (fileIsModel[file]) {
+            Model &model = assets.models[fileAssets[file]];
+            std::vector<tinyobj::material_t> materials;
+            std::string warning, error;
+            std::istringstream stream(data);
+
+            // Materials come from the scene, so the model's material library is not read
+            if (!tinyobj::LoadObj(&model.attrib, &model.shapes, &materials, &warning, &error, &stream)) {
+                throw std::runtime_error("Failed to load " + filePaths[file] + ": " + warning + error);
+            }
+            return;
+        }
+
+        int width, height, channels;
+        stbi_uc *pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc *>(data.data()),
+                                                static_cast<int>(data.size()), &width, &height, &channels,
+                                                STBI_rgb_alpha);
+        if (!pixels) {
+            throw std::runtime_error("Failed to load texture image " + filePaths[file] + "!");
+        }
+
+        Image &image = assets.images[fileAssets[file]];
+        image.width = static_cast<uint32_t>(width);
+        image.height = static_cast<uint32_t>(height);
+        image.pixels = {pixels, stbi_image_free};
+    });
+
+    for (uint32_t file: meshFiles) {
+        assets.meshModels.push_back(fileAssets[file]);
+    }
+    for (uint32_t file: textureFiles) {
+        assets.textureImages.push_back(fileAssets[file]);
+    }
+
+    assets.fetchSeconds = std::chrono::duration<double>(Clock::now() - startTime).count();
+    return assets;
+}
+
+std::string SceneAssets::buildReport() const {
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "Scene assets: %zu meshes (%zu unique), %zu textures (%zu unique) | %.1f MiB read | %.3f ms",
+                  meshModels.size(), models.size(), textureImages.size(), images.size(),
+                  static_cast<double>(bytesRead) / (1024.0 * 1024.0), 1000.0 * fetchSeconds);
+
+    return line;
+}
@@ -0,0 +1,165 @@
+#include "settings.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+    uint32_t parseUnsigned(const std::string &option, const std::string &value) {
+        try {
+            size_t parsedLength = 0;
+            unsigned long parsed = std::stoul(value, &parsedLength);
+            if (parsedLength == value.size()) {
+                return static_cast<uint32_t>(parsed);
+            }
+        }
+        catch (const std::exception &) {
+        }
+
+        throw std::invalid_argument("Invalid value '" + value + "' for option " + option);
+    }
+
+    bool parseBool(const std::string &option, const std::string &value) {
+        if (value.empty() || value == "1" || value == "true" || value == "on") {
+            return true;
+        }
+        if (value == "0" || value == "false" || value == "off") {
+            return false;
+        }
+
+        throw std::invalid_argument("Invalid value '" + value + "' for option " + option);
+    }
+}
+
+Settings Settings::fromCommandLine(int argc, char **argv) {
+    Settings settings;
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        size_t separator = argument.find('=');
+
+        std::string option = argument.substr(0, separator);
+        std::string value = separator == std::string::npos ? "" : argument.substr(separator + 1);
+
+        if (option == "--parallel-recording") {
+            settings.parallelRecording = parseBool(option, value);
+        } else if (option == "--frames-in-flight") {
+            settings.framesInFlight = parseUnsigned(option, value);
+        } else if (option == "--swapchain-images") {
+            settings.swapchainImageCount = parseUnsigned(option, value);
+        } else if (option == "--present-mode") {
+            if (value != "auto" && value != "fifo" && value != "fifo-relaxed" && value != "mailbox" &&
+                value != "immediate") {
+                throw std::invalid_argument("Invalid value '" + value + "' for option " + option);
+            }
+            settings.presentMode = value;
+        } else if (option == "--frame-pacing") {
+            settings.framePacing = parseBool(option, value);
+        } else if (option == "--frame-stats") {
+            settings.frameStatistics = parseBool(option, value);
+        } else if (option == "--cached-command-buffers") {
+            settings.cachedCommandBuffers = parseBool(option, value);
+        } else if (option == "--dynamic-rendering") {
+            settings.dynamicRendering = parseBool(option, value);
+        } else if (option == "--memory-budget") {
+            settings.memoryBudgetMiB = parseUnsigned(option, value);
+        } else if (option == "--gpu-driven") {
+            settings.gpuDriven = parseBool(option, value);
+        } else if (option == "--frustum-culling") {
+            settings.frustumCulling = parseBool(option, value);
+        } else if (option == "--occlusion-culling") {
+            settings.occlusionCulling = parseBool(option, value);
+        } else if (option == "--depth-prepass") {
+            settings.depthPrepass = parseBool(option, value);
+        } else if (option == "--dynamic-resolution") {
+            settings.dynamicResolution = parseBool(option, value);
+        } else if (option == "--gpu-frame-target") {
+            settings.gpuFrameTargetMicroseconds = parseUnsigned(option, value);
+        } else if (option == "--min-resolution-scale") {
+            settings.minimumResolutionScale = parseUnsigned(option, value);
+        } else if (option == "--dynamic-msaa") {
+            settings.dynamicMsaa = parseBool(option, value);
+        } else if (option == "--bindless-textures") {
+            settings.bindlessTextures = parseBool(option, value);
+        } else if (option == "--lights") {
+            settings.lightCount = parseUnsigned(option, value);
+        } else if (option == "--clustered-lighting") {
+            settings.clusteredLighting = parseBool(option, value);
+        } else if (option == "--views") {
+            settings.viewCount = parseUnsigned(option, value);
+        } else if (option == "--scene") {
+            settings.scene = value;
+        } else if (option == "--save-binary-scene") {
+            settings.saveBinaryScene = value;
+        } else if (option == "--instances") {
+            settings.instanceCount = parseUnsigned(option, value);
+        } else if (option == "--animate") {
+            settings.animate = parseBool(option, value);
+        } else if (option == "--instancing") {
+            settings.instancing = parseBool(option, value);
+        } else if (option == "--benchmark") {
+            if (value != "instances" && value != "draws" && value != "occlusion" &&
+                value != "prepass" && value != "lights") {
+                throw std::invalid_argument("Invalid value '" + value + "' for option " + option);
+            }
+            settings.benchmark = value;
+        } else if (option == "--threads") {
+            settings.workerThreads = parseUnsigned(option, value);
+        } else {
+            throw std::invalid_argument("Unknown command line option: " + option);
+        }
+    }
+
+    if (settings.framesInFlight == 0) {
+        throw std::invalid_argument("--frames-in-flight must be at least 1");
+    }
+
+    if (settings.instanceCount == 0) {
+        throw std::invalid_argument("--instances must be at least 1");
+    }
+
+    // Matches Application::MAX_VIEWS
+    if (settings.viewCount == 0 || settings.viewCount > 4) {
+        throw std::invalid_argument("--views must be between 1 and 4");
+    }
+
+    if (!settings.saveBinaryScene.empty() && settings.scene.empty()) {
+        throw std::invalid_argument("--save-binary-scene needs a --scene to convert");
+    }
+
+    // These benchmarks scale the instance grid, which a scene file replaces
+    if (!settings.scene.empty() && (settings.benchmark == "instances" || settings.benchmark == "draws")) {
+        throw std::invalid_argument("--scene can't be used with the " + settings.benchmark + " benchmark");
+    }
+
+    if (settings.gpuFrameTargetMicroseconds == 0) {
+        throw std::invalid_argument("--gpu-frame-target must be at least 1");
+    }
+
+    if (settings.minimumResolutionScale == 0 || settings.minimumResolutionScale > 100) {
+        throw std::invalid_argument("--min-resolution-scale must be between 1 and 100");
+    }
+
+    // The draw benchmark measures draws recorded by the CPU, one per object, with none culled
+    if (settings.benchmark == "draws") {
+        settings.gpuDriven = false;
+        settings.instancing = false;
+        settings.frustumCulling = false;
+    }
+
+    // The occlusion benchmark toggles the test inside the occlusion culling passes, so they have to be recorded
+    if (settings.benchmark == "occlusion") {
+        settings.occlusionCulling = true;
+    }
+
+    // The pre-pass is not used with occlusion culling
+    if (settings.benchmark == "prepass") {
+        settings.occlusionCulling = false;
+    }
+
+    if (settings.workerThreads == 0) {
+        settings.workerThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    return settings;
+}
@@ -0,0 +1,112 @@
+#include "thread_pool.hpp"
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    // The calling thread is counted as one of the threads
+    for (uint32_t i = 1; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+uint32_t ThreadPool::getThreadCount() const {
+    return static_cast<uint32_t>(workers.size()) + 1;
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t)> &task) {
+    if (count == 0) {
+        return;
+    }
+
+    if (workers.empty() || count == 1) {
+        for (uint32_t i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        currentTask = &task;
+        taskCount = count;
+        nextTask = 0;
+        remainingTasks = count;
+        firstError = nullptr;
+        generation = ++batchGeneration;
+    }
+    wakeCondition.notify_all();
+
+    executeTasks(generation);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this] { return remainingTasks == 0; });
+    currentTask = nullptr;
+
+    if (firstError) {
+        std::exception_ptr error = firstError;
+        firstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seenGeneration = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&] { return stopping || batchGeneration != seenGeneration; });
+
+            if (stopping) {
+                return;
+            }
+
+            seenGeneration = batchGeneration;
+        }
+
+        executeTasks(seenGeneration);
+    }
+}
+
+void ThreadPool::executeTasks(uint64_t generation) {
+    while (true) {
+        uint32_t taskIndex;
+        const std::function<void(uint32_t)> *task;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // A worker that woke late for an already finished batch must not pick up indices of the next one
+            if (generation != batchGeneration || nextTask >= taskCount) {
+                return;
+            }
+
+            taskIndex = nextTask++;
+            task = currentTask;
+        }
+
+        try {
+            (*task)(taskIndex);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!firstError) {
+                firstError = std::current_exception();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--remainingTasks == 0) {
+            doneCondition.notify_all();
+        }
+    }
+}
@@ -0,0 +1,289 @@
+#include "transform_hierarchy.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define TRANSFORM_HIERARCHY_SSE
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define TRANSFORM_HIERARCHY_NEON
+#endif
+
+namespace {
+    // Below this many nodes in a level, splitting it costs more than it saves
+    constexpr uint32_t PARALLEL_THRESHOLD = 16384;
+
+    struct LocalTransform
+    {
+        float translation[3];
+        // Columns of the rotation scaled by the node's scale
+        float axes[3][3];
+    };
+
+    // Writes parent * local, or local for a root. Local transforms are affine, so the product only needs the first
+    // three columns of the parent for the axes and all four for the translation
+    inline void composeWorldMatrix(const float *parent, const LocalTransform &local, float *world) {
+#if defined(TRANSFORM_HIERARCHY_SSE)
+        if (parent) {
+            __m128 parent0 = _mm_loadu_ps(parent);
+            __m128 parent1 = _mm_loadu_ps(parent + 4);
+            __m128 parent2 = _mm_loadu_ps(parent + 8);
+            __m128 parent3 = _mm_loadu_ps(parent + 12);
+
+            auto combine = [&](const float *weights) {
+                return _mm_add_ps(_mm_add_ps(_mm_mul_ps(parent0, _mm_set1_ps(weights[0])),
+                                             _mm_mul_ps(parent1, _mm_set1_ps(weights[1]))),
+                                  _mm_mul_ps(parent2, _mm_set1_ps(weights[2])));
+            };
+
+            _mm_storeu_ps(world, combine(local.axes[0]));
+            _mm_storeu_ps(world + 4, combine(local.axes[1]));
+            _mm_storeu_ps(world + 8, combine(local.axes[2]));
+            _mm_storeu_ps(world + 12, _mm_add_ps(combine(local.translation), parent3));
+            return;
+        }
+#elif defined(TRANSFORM_HIERARCHY_NEON)
+        if (parent) {
+            float32x4_t parent0 = vld1q_f32(parent);
+            float32x4_t parent1 = vld1q_f32(parent + 4);
+            float32x4_t parent2 = vld1q_f32(parent + 8);
+            float32x4_t parent3 = vld1q_f32(parent + 12);
+
+            auto combine = [&](const float *weights, float32x4_t base) {
+                return vfmaq_n_f32(vfmaq_n_f32(vfmaq_n_f32(base, parent0, weights[0]), parent1, weights[1]),
+                                   parent2, weights[2]);
+            };
+
+            vst1q_f32(world, combine(local.axes[0], vdupq_n_f32(0.0f)));
+            vst1q_f32(world + 4, combine(local.axes[1], vdupq_n_f32(0.0f)));
+            vst1q_f32(world + 8, combine(local.axes[2], vdupq_n_f32(0.0f)));
+            vst1q_f32(world + 12, combine(local.translation, parent3));
+            return;
+        }
+#else
+        if (parent) {
+            for (int column = 0; column < 4; column++) {
+                const float *weights = column < 3 ? local.axes[column] : local.translation;
+                for (int row = 0; row < 4; row++) {
+                    world[column * 4 + row] = parent[row] * weights[0] + parent[4 + row] * weights[1] +
+                                              parent[8 + row] * weights[2] + (column == 3 ? parent[12 + row] : 0.0f);
+                }
+            }
+            return;
+        }
+#endif
+
+        for (int column = 0; column < 3; column++) {
+            world[column * 4] = local.axes[column][0];
+            world[column * 4 + 1] = local.axes[column][1];
+            world[column * 4 + 2] = local.axes[column][2];
+            world[column * 4 + 3] = 0.0f;
+        }
+        world[12] = local.translation[0];
+        world[13] = local.translation[1];
+        world[14] = local.translation[2];
+        world[15] = 1.0f;
+    }
+
+    // Splits [first, last) into ranges for the thread pool, or a single range when it is small
+    template<typename Function>
+    void forEachRange(ThreadPool &threadPool, uint32_t first, uint32_t last, Function function) {
+        uint32_t count = last - first;
+        uint32_t rangeCount = count < PARALLEL_THRESHOLD ? 1 : threadPool.getThreadCount() * 4;
+
+        if (rangeCount == 1) {
+            function(0, first, last);
+            return;
+        }
+
+        threadPool.parallelFor(rangeCount, [&](uint32_t rangeIndex) {
+            function(rangeIndex, first + static_cast<uint32_t>(uint64_t(count) * rangeIndex / rangeCount),
+                     first + static_cast<uint32_t>(uint64_t(count) * (rangeIndex + 1) / rangeCount));
+        });
+    }
+}
+
+void TransformHierarchy::clear() {
+    parents.clear();
+    depths.clear();
+    levelStarts.clear();
+    translationX.clear();
+    translationY.clear();
+    translationZ.clear();
+    rotationX.clear();
+    rotationY.clear();
+    rotationZ.clear();
+    rotationW.clear();
+    scales.clear();
+    localDirty.clear();
+    worldMatrices.clear();
+    worldVersions.clear();
+}
+
+uint32_t TransformHierarchy::addNode(uint32_t parent) {
+    auto node = static_cast<uint32_t>(parents.size());
+
+    if (parent != NO_PARENT && parent >= node) {
+        throw std::invalid_argument("Transform parents have to be added before their children");
+    }
+
+    uint32_t depth = parent == NO_PARENT ? 0 : depths[parent] + 1;
+    uint32_t previousDepth = depths.empty() ? 0 : depths.back();
+    if (depth < previousDepth) {
+        throw std::invalid_argument("Transforms have to be added in breadth-first order");
+    }
+
+    // The count at the end is moved along with every node
+    if (!levelStarts.empty()) {
+        levelStarts.pop_back();
+    }
+    while (levelStarts.size() <= depth) {
+        levelStarts.push_back(node);
+    }
+    levelStarts.push_back(node + 1);
+
+    parents.push_back(parent);
+    depths.push_back(depth);
+    translationX.push_back(0.0f);
+    translationY.push_back(0.0f);
+    translationZ.push_back(0.0f);
+    rotationX.push_back(0.0f);
+    rotationY.push_back(0.0f);
+    rotationZ.push_back(0.0f);
+    rotationW.push_back(1.0f);
+    scales.push_back(1.0f);
+    localDirty.push_back(1);
+    worldMatrices.resize(worldMatrices.size() + 16);
+    worldVersions.push_back(0);
+
+    return node;
+}
+
+uint32_t TransformHierarchy::getNodeCount() const {
+    return static_cast<uint32_t>(parents.size());
+}
+
+void TransformHierarchy::setLocalTranslation(uint32_t node, float x, float y, float z) {
+    translationX[node] = x;
+    translationY[node] = y;
+    translationZ[node] = z;
+    localDirty[node] = 1;
+}
+
+void TransformHierarchy::setLocalRotation(uint32_t node, float x, float y, float z, float w) {
+    rotationX[node] = x;
+    rotationY[node] = y;
+    rotationZ[node] = z;
+    rotationW[node] = w;
+    localDirty[node] = 1;
+}
+
+void TransformHierarchy::setLocalScale(uint32_t node, float scale) {
+    scales[node] = scale;
+    localDirty[node] = 1;
+}
+
+void TransformHierarchy::update(ThreadPool &threadPool, const WorldOutput *output) {
+    auto startTime = Clock::now();
+
+    version++;
+    uint64_t updatedNodes = 0;
+
+    for (size_t level = 0; level + 1 < levelStarts.size(); level++) {
+        uint32_t rangeCount = levelStarts[level + 1] - levelStarts[level] < PARALLEL_THRESHOLD
+                              ? 1 : threadPool.getThreadCount() * 4;
+        rangeUpdatedCounts.assign(rangeCount, 0);
+
+        // The level above is complete, so a node is stale when its own transform changed or its parent was just
+        // recomputed; clean subtrees cost one flag and one version check per node
+        forEachRange(threadPool, levelStarts[level], levelStarts[level + 1],
+                     [&](uint32_t rangeIndex, uint32_t first, uint32_t last) {
+            uint32_t rangeUpdated = 0;
+
+            for (uint32_t node = first; node < last; node++) {
+                // Wraps around for nodes before the output, so one comparison covers both ends
+                bool outputNode = output && node - output->firstNode < output->count;
+                float *outputMatrix = outputNode ? output->destination + size_t(node - output->firstNode) * 16 : nullptr;
+
+                uint32_t parent = parents[node];
+                bool parentChanged = parent != NO_PARENT && worldVersions[parent] == version;
+                if (!localDirty[node] && !parentChanged) {
+                    // A clean node may still have changed in an update the output's slot missed
+                    if (outputNode && (output->sinceVersion == 0 || worldVersions[node] > output->sinceVersion)) {
+                        memcpy(outputMatrix, &worldMatrices[size_t(node) * 16], 16 * sizeof(float));
+                    }
+                    continue;
+                }
+
+                float x = rotationX[node], y = rotationY[node], z = rotationZ[node], w = rotationW[node];
+                float scale = scales[node];
+
+                LocalTransform local{
+                        {translationX[node], translationY[node], translationZ[node]},
+                        {{scale * (1.0f - 2.0f * (y * y + z * z)), scale * 2.0f * (x * y + w * z),
+                          scale * 2.0f * (x * z - w * y)},
+                         {scale * 2.0f * (x * y - w * z), scale * (1.0f - 2.0f * (x * x + z * z)),
+                          scale * 2.0f * (y * z + w * x)},
+                         {scale * 2.0f * (x * z + w * y), scale * 2.0f * (y * z - w * x),
+                          scale * (1.0f - 2.0f * (x * x + y * y))}}
+                };
+
+                float *world = &worldMatrices[size_t(node) * 16];
+                composeWorldMatrix(parent != NO_PARENT ? &worldMatrices[size_t(parent) * 16] : nullptr, local, world);
+                if (outputMatrix) {
+                    memcpy(outputMatrix, world, 16 * sizeof(float));
+                }
+
+                worldVersions[node] = version;
+                localDirty[node] = 0;
+                rangeUpdated++;
+            }
+
+            rangeUpdatedCounts[rangeIndex] = rangeUpdated;
+        });
+
+        for (uint32_t count: rangeUpdatedCounts) {
+            updatedNodes += count;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - startTime).count();
+    windowUpdateCount++;
+    windowUpdatedNodes += updatedNodes;
+    windowUpdateSeconds += seconds;
+    windowMaxUpdateSeconds = std::max(windowMaxUpdateSeconds, seconds);
+}
+
+uint64_t TransformHierarchy::getVersion() const {
+    return version;
+}
+
+uint64_t TransformHierarchy::getWorldVersion(uint32_t node) const {
+    return worldVersions[node];
+}
+
+const float *TransformHierarchy::getWorldMatrix(uint32_t node) const {
+    return &worldMatrices[size_t(node) * 16];
+}
+
+std::string TransformHierarchy::buildReport() {
+    double averageNodes = windowUpdateCount > 0 ? static_cast<double>(windowUpdatedNodes) / windowUpdateCount : 0.0;
+    double averageMilliseconds = windowUpdateCount > 0 ? 1000.0 * windowUpdateSeconds / windowUpdateCount : 0.0;
+
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "Transforms: %u nodes in %zu levels | %.0f recomputed per update | %.3f ms avg, %.3f ms max",
+                  getNodeCount(), levelStarts.empty() ? size_t(0) : levelStarts.size() - 1, averageNodes,
+                  averageMilliseconds, 1000.0 * windowMaxUpdateSeconds);
+
+    windowUpdateCount = 0;
+    windowUpdatedNodes = 0;
+    windowUpdateSeconds = 0.0;
+    windowMaxUpdateSeconds = 0.0;
+
+    return line;
+}
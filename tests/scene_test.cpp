@@ -0,0 +1,179 @@
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "scene.hpp"
+#include "thread_pool.hpp"
+
+// Loads text and binary scenes written to a temporary directory, checks that malformed ones are rejected and that
+// fetching reads every distinct mesh and texture once. Exits with 1 on the first failure
+namespace {
+    const char *CUBE_OBJ =
+            "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+            "vt 0 0\nvt 1 0\nvt 0 1\n"
+            "f 1/1 2/2 3/3\n";
+
+    void check(bool condition, const std::string &message) {
+        if (!condition) {
+            throw std::runtime_error(message);
+        }
+    }
+
+    void writeFile(const std::filesystem::path &path, const std::string &contents) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        if (!file) {
+            throw std::runtime_error("Failed to write " + path.string() + "!");
+        }
+    }
+
+    // 1x1 uncompressed 32-bit TGA
+    std::string makeImage(unsigned char red) {
+        std::string image(18, '\0');
+        image[2] = 2;
+        image[12] = 1;
+        image[14] = 1;
+        image[16] = 32;
+        image += std::string{0, 0, static_cast<char>(red), static_cast<char>(255)};
+        return image;
+    }
+
+    void expectLoadFailure(const std::filesystem::path &path, const std::string &contents,
+                           const std::string &description) {
+        writeFile(path, contents);
+        try {
+            SceneDescription::load(path.string());
+        } catch (const std::runtime_error &) {
+            return;
+        }
+        throw std::runtime_error("Loaded a scene with " + description);
+    }
+
+    bool sameInstance(const SceneDescription::Instance &a, const SceneDescription::Instance &b) {
+        return memcmp(&a, &b, sizeof(a)) == 0;
+    }
+
+    void testText(const std::filesystem::path &directory) {
+        SceneDescription scene = SceneDescription::load((directory / "scene.txt").string());
+
+        check(scene.meshPaths.size() == 3 && scene.texturePaths.size() == 2, "wrong asset counts");
+        check(scene.materials.size() == 2 && scene.materials[1].texture == 1, "wrong materials");
+        check(scene.instances.size() == 6, "expected 2 instances and a 2x2 grid");
+
+        const SceneDescription::Instance &rotated = scene.instances[1];
+        check(rotated.mesh == 1 && rotated.material == 1, "wrong instance references");
+        check(rotated.translation[0] == 1.0f && rotated.translation[1] == 2.0f && rotated.translation[2] == 3.0f,
+              "wrong instance translation");
+        check(std::abs(rotated.rotation[2] - std::sqrt(0.5f)) < 1e-5f && rotated.scale == 2.0f,
+              "wrong instance rotation or scale");
+        check(scene.instances[0].scale == 1.0f && scene.instances[0].rotation[3] == 1.0f,
+              "optional instance values don't default");
+        check(scene.instances[2].translation[0] == -0.5f && scene.instances[5].translation[1] == 0.5f,
+              "grid not centered");
+    }
+
+    void testBinary(const std::filesystem::path &directory) {
+        SceneDescription text = SceneDescription::load((directory / "scene.txt").string());
+        std::filesystem::path binaryPath = directory / "scene.bin";
+        text.saveBinary(binaryPath.string());
+
+        SceneDescription binary = SceneDescription::load(binaryPath.string());
+        check(binary.meshPaths == text.meshPaths && binary.texturePaths == text.texturePaths,
+              "binary paths differ from the text scene's");
+        check(binary.materials.size() == text.materials.size() && binary.instances.size() == text.instances.size(),
+              "binary counts differ from the text scene's");
+        for (size_t i = 0; i < text.instances.size(); i++) {
+            check(sameInstance(binary.instances[i], text.instances[i]), "binary instance differs");
+        }
+
+        std::ifstream file(binaryPath, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        // The first path's length, after the magic and the four counts
+        std::string hugeString = data;
+        uint32_t length = UINT32_MAX;
+        memcpy(hugeString.data() + 8 + 4 * 4, &length, sizeof(length));
+        expectLoadFailure(directory / "huge_string.bin", hugeString, "a path longer than the file");
+
+        expectLoadFailure(directory / "truncated.bin", data.substr(0, data.size() - 1), "a truncated instance");
+
+        // Binary scenes skip the parser, so the scale is only checked by the validation they share
+        std::string zeroScale = data;
+        float scale = 0.0f;
+        memcpy(zeroScale.data() + zeroScale.size() - sizeof(float), &scale, sizeof(scale));
+        expectLoadFailure(directory / "zero_scale.bin", zeroScale, "a zero scale");
+    }
+
+    void testMalformedText(const std::filesystem::path &directory) {
+        std::string header = "mesh cube cube.obj\ntexture red red.tga\nmaterial red red\n";
+        std::filesystem::path path = directory / "malformed.txt";
+
+        expectLoadFailure(path, header + "instance cube red 0 0 0 45 1 extra\n", "a trailing token");
+        expectLoadFailure(path, header + "instance cube red 0 0 0 abc\n", "an angle that isn't a number");
+        expectLoadFailure(path, header + "instance cube red 0 0 0 45 x\n", "a scale that isn't a number");
+        expectLoadFailure(path, header + "instance cube red 0 0 0 45 1.5x\n", "a scale followed by junk");
+        expectLoadFailure(path, header + "instance cube red 0 0 0 45 0\n", "a zero scale");
+        expectLoadFailure(path, header + "instance cube red 0 0 0 45 -1\n", "a negative scale");
+        expectLoadFailure(path, header + "instance cube red 0 0\n", "a missing coordinate");
+        expectLoadFailure(path, header + "instance cube blue 0 0 0\n", "an unknown material");
+        expectLoadFailure(path, header + "grid cube red 2 2 1 1\n", "a trailing grid token");
+        expectLoadFailure(path, header, "no instances");
+    }
+
+    void testFetch(const std::filesystem::path &directory, ThreadPool &threadPool) {
+        SceneDescription scene = SceneDescription::load((directory / "scene.txt").string());
+        SceneAssets assets = SceneAssets::fetch(scene, threadPool);
+
+        // cube.obj twice under different paths and once copied, red.tga and a different image
+        check(assets.meshModels.size() == 3 && assets.models.size() == 1, "duplicate meshes decoded again");
+        check(assets.meshModels[0] == assets.meshModels[1] && assets.meshModels[1] == assets.meshModels[2],
+              "duplicate meshes don't share a model");
+        check(assets.textureImages.size() == 2 && assets.images.size() == 2, "distinct textures were merged");
+        check(assets.images[assets.textureImages[0]].width == 1 && assets.images[assets.textureImages[0]].pixels,
+              "texture not decoded");
+        check(assets.models[0].attrib.vertices.size() == 9, "mesh not decoded");
+    }
+}
+
+int main() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "scene_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "models");
+
+    int status = 0;
+    try {
+        writeFile(directory / "cube.obj", CUBE_OBJ);
+        writeFile(directory / "models" / "copy.obj", CUBE_OBJ);
+        writeFile(directory / "red.tga", makeImage(255));
+        writeFile(directory / "dark.tga", makeImage(16));
+        writeFile(directory / "scene.txt",
+                  "# Two names for one file and a copy of it\n"
+                  "mesh cube cube.obj\n"
+                  "mesh same ./models/../cube.obj\n"
+                  "mesh copy models/copy.obj\n"
+                  "texture red red.tga\n"
+                  "texture dark dark.tga   # comment after a directive\n"
+                  "material red red\n"
+                  "material dark dark\n"
+                  "instance cube red 0 0 0\n"
+                  "instance same dark 1 2 3 90 2\n"
+                  "grid copy red 2 2 1\n");
+
+        ThreadPool threadPool(2);
+        testText(directory);
+        testBinary(directory);
+        testMalformedText(directory);
+        testFetch(directory, threadPool);
+    } catch (const std::exception &error) {
+        std::cerr << "Scene test failed: " << error.what() << std::endl;
+        status = 1;
+    }
+
+    std::filesystem::remove_all(directory);
+    return status;
+}